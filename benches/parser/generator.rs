@@ -0,0 +1,239 @@
+//! Synthetic schemas shaped like the large workspaces the server has to keep
+//! up with. Every workload is deterministic, so runs can be compared.
+
+use std::fmt::Write;
+use std::fs;
+use std::io;
+use std::path::{Path, PathBuf};
+
+/// Appends formatted text to a `String`.
+macro_rules! emit {
+    ($out:expr, $($arg:tt)*) => {
+        $out.write_fmt(format_args!($($arg)*))
+            .expect("writing to a String can't fail")
+    };
+}
+
+/// A set of schema files, one of which includes all of the others.
+pub struct Workload {
+    pub name: &'static str,
+    /// Paths relative to the workspace root, and their contents.
+    pub files: Vec<(PathBuf, String)>,
+    /// The file that includes every other file, and that edits are made to.
+    pub root: PathBuf,
+}
+
+impl Workload {
+    fn single(name: &'static str, content: String) -> Self {
+        let root = PathBuf::from(format!("{name}.fbs"));
+        Self {
+            name,
+            files: vec![(root.clone(), content)],
+            root,
+        }
+    }
+
+    #[must_use]
+    pub fn bytes(&self) -> usize {
+        self.files.iter().map(|(_, content)| content.len()).sum()
+    }
+
+    #[must_use]
+    pub fn root_content(&self) -> &str {
+        self.files
+            .iter()
+            .find(|(path, _)| *path == self.root)
+            .map_or("", |(_, content)| content)
+    }
+
+    /// Writes the files under `dir`.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if a file couldn't be written.
+    pub fn write(&self, dir: &Path) -> io::Result<()> {
+        for (path, content) in &self.files {
+            fs::write(dir.join(path), content)?;
+        }
+        Ok(())
+    }
+}
+
+/// Every workload, with sizes multiplied by `scale`.
+#[must_use]
+pub fn all(scale: usize) -> Vec<Workload> {
+    vec![
+        deep_include_dag(8 * scale, 4),
+        many_namespaces(200 * scale),
+        wide_tables(10 * scale, 400),
+        big_unions(2 * scale, 250),
+        doc_heavy(200 * scale),
+        large_generated(4 * scale * 1024 * 1024),
+    ]
+}
+
+/// `levels` levels of `width` files, each including two files of the level
+/// below and referring to their tables.
+fn deep_include_dag(levels: usize, width: usize) -> Workload {
+    let mut files = Vec::new();
+    for level in 0..levels {
+        for i in 0..width {
+            let mut out = String::new();
+            let below = [i, (i + 1) % width];
+            if level > 0 {
+                for j in below {
+                    emit!(out, "include \"level{}_{j}.fbs\";\n", level - 1);
+                }
+            }
+            emit!(out, "\nnamespace dag.l{level};\n\n");
+            emit!(
+                out,
+                "struct Point{i} {{ x: float; y: float; z: float; }}\n\n"
+            );
+            for k in 0..10 {
+                emit!(
+                    out,
+                    "table Leaf{i}_{k} {{ id: ulong; pos: Point{i}; tags: [string]; }}\n"
+                );
+            }
+            emit!(out, "\ntable T{i} {{\n");
+            if level > 0 {
+                for (n, j) in below.iter().enumerate() {
+                    emit!(out, "  below_{n}: dag.l{}.T{j};\n", level - 1);
+                }
+            }
+            for k in 0..10 {
+                emit!(out, "  leaf_{k}: Leaf{i}_{k};\n");
+            }
+            out.push_str("  name: string;\n}\n");
+            files.push((PathBuf::from(format!("level{level}_{i}.fbs")), out));
+        }
+    }
+
+    let mut out = String::new();
+    let top = levels.saturating_sub(1);
+    for i in 0..width {
+        emit!(out, "include \"level{top}_{i}.fbs\";\n");
+    }
+    out.push_str("\nnamespace dag;\n\ntable Root {\n");
+    for i in 0..width {
+        emit!(out, "  top_{i}: dag.l{top}.T{i};\n");
+    }
+    out.push_str("}\n\nroot_type Root;\n");
+    let root = PathBuf::from("root.fbs");
+    files.push((root.clone(), out));
+    Workload {
+        name: "deep_include_dag",
+        files,
+        root,
+    }
+}
+
+/// `count` namespaces in one file, each referring to the one before.
+fn many_namespaces(count: usize) -> Workload {
+    let mut out = String::new();
+    for k in 0..count {
+        emit!(out, "namespace ns{k}.inner;\n\n");
+        out.push_str("enum Color : ubyte { Red, Green, Blue }\n\n");
+        out.push_str("table Item {\n  color: Color = Green;\n  label: string;\n");
+        if k > 0 {
+            emit!(out, "  next: ns{}.inner.Item;\n", k - 1);
+        }
+        out.push_str("}\n\n");
+    }
+    Workload::single("many_namespaces", out)
+}
+
+/// `tables` tables of `fields` fields each, of every kind of type.
+fn wide_tables(tables: usize, fields: usize) -> Workload {
+    const TYPES: [&str; 8] = [
+        "int", "float", "bool", "string", "[int]", "[string]", "Mode", "Vec3",
+    ];
+    let mut out = String::from("namespace wide;\n\n");
+    out.push_str("enum Mode : short { Off, On, Auto }\n\n");
+    out.push_str("struct Vec3 { x: float; y: float; z: float; }\n\n");
+    for t in 0..tables {
+        emit!(out, "table Wide{t} {{\n");
+        for f in 0..fields {
+            let field_type = TYPES[f % TYPES.len()];
+            emit!(out, "  field_{f}: {field_type} (id: {f});\n");
+        }
+        out.push_str("}\n\n");
+    }
+    Workload::single("wide_tables", out)
+}
+
+/// `unions` unions of `variants` tables each, and a table that holds them.
+fn big_unions(unions: usize, variants: usize) -> Workload {
+    let mut out = String::from("namespace unions;\n\n");
+    for u in 0..unions {
+        for v in 0..variants {
+            emit!(out, "table Variant{u}_{v} {{ value: int; }}\n");
+        }
+        emit!(out, "\nunion Choice{u} {{\n");
+        for v in 0..variants {
+            emit!(out, "  Variant{u}_{v},\n");
+        }
+        out.push_str("}\n\n");
+    }
+    out.push_str("table Holder {\n");
+    for u in 0..unions {
+        emit!(out, "  choice_{u}: Choice{u};\n");
+    }
+    out.push_str("}\n\nroot_type Holder;\n");
+    Workload::single("big_unions", out)
+}
+
+/// `tables` tables whose every declaration has a long doc comment.
+fn doc_heavy(tables: usize) -> Workload {
+    let mut out = String::from("namespace docs;\n\n");
+    for t in 0..tables {
+        for line in 0..6 {
+            emit!(
+                out,
+                "/// Line {line} of the documentation of Documented{t}, "
+            );
+            emit!(out, "which explains at length what it is for.\n");
+        }
+        emit!(out, "table Documented{t} {{\n");
+        for f in 0..8 {
+            emit!(out, "  /// What field_{f} holds, and the units it is in.\n");
+            emit!(out, "  /// It is optional.\n");
+            emit!(out, "  field_{f}: int;\n");
+        }
+        out.push_str("}\n\n");
+    }
+    Workload::single("doc_heavy", out)
+}
+
+/// One file of at least `bytes` bytes, like the output of a schema generator.
+fn large_generated(bytes: usize) -> Workload {
+    const BLOCKS_PER_NAMESPACE: usize = 100;
+    let mut out = String::new();
+    let mut k = 0;
+    while out.len() < bytes {
+        if k % BLOCKS_PER_NAMESPACE == 0 {
+            emit!(out, "namespace gen.m{};\n\n", k / BLOCKS_PER_NAMESPACE);
+        }
+        emit!(out, "/// Flags of block {k}.\n");
+        emit!(out, "enum Flags{k} : uint (bit_flags) {{ A, B, C, D }}\n");
+        emit!(out, "struct Vec{k} {{ x: float; y: float; z: float; }}\n");
+        emit!(out, "table Node{k} {{\n");
+        emit!(
+            out,
+            "  id: ulong (key);\n  pos: Vec{k};\n  flags: Flags{k} = A;\n"
+        );
+        emit!(out, "  name: string;\n  children: [Node{k}];\n");
+        if k > 0 {
+            emit!(
+                out,
+                "  prev: gen.m{}.Node{};\n",
+                (k - 1) / BLOCKS_PER_NAMESPACE,
+                k - 1
+            );
+        }
+        out.push_str("}\n\n");
+        k += 1;
+    }
+    Workload::single("large_generated", out)
+}
@@ -0,0 +1,226 @@
+//! Benchmarks of the parser and the analysis built on it, over synthetic
+//! workspaces.
+//!
+//! ```sh
+//! cargo bench --bench parser -- [filter] [--iterations N] [--scale N] [--output results.json]
+//! ```
+//!
+//! Each benchmark is named `<measurement>/<workload>`, and only those
+//! containing `filter` are run. Results are written as JSON to `--output`, or
+//! to stdout, with a summary on stderr.
+
+mod generator;
+
+use flatbuffers_language_server::analysis::Analyzer;
+use flatbuffers_language_server::document_store::DocumentStore;
+use flatbuffers_language_server::ffi;
+use flatbuffers_language_server::parser::{FlatcFFIParser, Parser};
+use generator::Workload;
+use serde::Serialize;
+use std::ffi::CString;
+use std::fs;
+use std::hint::black_box;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::AtomicBool;
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+use tokio::runtime::Runtime;
+
+struct Options {
+    filter: Option<String>,
+    iterations: usize,
+    scale: usize,
+    output: Option<PathBuf>,
+}
+
+#[derive(Serialize)]
+struct Report {
+    server_version: &'static str,
+    scale: usize,
+    results: Vec<Measurement>,
+}
+
+#[derive(Serialize)]
+struct Measurement {
+    name: String,
+    files: usize,
+    bytes: usize,
+    iterations: usize,
+    min_ns: u64,
+    median_ns: u64,
+    mean_ns: u64,
+    p95_ns: u64,
+    max_ns: u64,
+}
+
+impl Measurement {
+    fn new(name: String, workload: &Workload, mut samples: Vec<Duration>) -> Self {
+        samples.sort_unstable();
+        let nanos = |duration: Duration| u64::try_from(duration.as_nanos()).unwrap_or(u64::MAX);
+        let total: Duration = samples.iter().sum();
+        let count = u32::try_from(samples.len()).unwrap_or(u32::MAX).max(1);
+        let at = |percent: usize| samples[(samples.len() * percent).div_ceil(100).max(1) - 1];
+        Self {
+            name,
+            files: workload.files.len(),
+            bytes: workload.bytes(),
+            iterations: samples.len(),
+            min_ns: nanos(samples[0]),
+            median_ns: nanos(samples[samples.len() / 2]),
+            mean_ns: nanos(total / count),
+            p95_ns: nanos(at(95)),
+            max_ns: nanos(samples[samples.len() - 1]),
+        }
+    }
+}
+
+fn main() {
+    let options = parse_args();
+    let runtime = Runtime::new().expect("failed to start the async runtime");
+    let mut results = Vec::new();
+
+    for workload in generator::all(options.scale) {
+        let dir = tempfile::tempdir().expect("failed to create a workspace directory");
+        let root_dir = fs::canonicalize(dir.path()).expect("failed to canonicalize workspace");
+        workload.write(&root_dir).expect("failed to write workload");
+        let paths: Vec<PathBuf> = workload
+            .files
+            .iter()
+            .map(|(path, _)| root_dir.join(path))
+            .collect();
+        let root = root_dir.join(&workload.root);
+        let root_content = workload.root_content();
+
+        let mut run = |measurement: &str, sample: &mut dyn FnMut() -> Duration| {
+            let name = format!("{measurement}/{}", workload.name);
+            if options
+                .filter
+                .as_ref()
+                .is_some_and(|filter| !name.contains(filter.as_str()))
+            {
+                return;
+            }
+            sample(); // warm up
+            let samples = (0..options.iterations).map(|_| sample()).collect();
+            let result = Measurement::new(name, &workload, samples);
+            eprintln!(
+                "{:<40} median {:>12?}  p95 {:>12?}",
+                result.name,
+                Duration::from_nanos(result.median_ns),
+                Duration::from_nanos(result.p95_ns)
+            );
+            results.push(result);
+        };
+
+        run("parse_schema", &mut || parse_schema(&root, root_content));
+
+        let parser = FlatcFFIParser::default();
+        run("ffi_export", &mut || {
+            let start = Instant::now();
+            black_box(parser.parse(&root, root_content, &[]));
+            start.elapsed()
+        });
+
+        let incremental = FlatcFFIParser::default().incremental();
+        let mut defaults = 0;
+        run("reparse_table", &mut || {
+            // Only a default changes, inside the braces of one table.
+            defaults += 1;
+            let edited =
+                format!("{root_content}\ntable BenchEdit {{ field: int = {defaults}; }}\n");
+            let start = Instant::now();
+            black_box(incremental.parse_with_overlay(
+                &root,
+                &edited,
+                &[],
+                &[],
+                &AtomicBool::new(false),
+            ));
+            start.elapsed()
+        });
+
+        run("index_cold", &mut || {
+            let analyzer = Analyzer::new(Arc::new(DocumentStore::new()));
+            let start = Instant::now();
+            black_box(runtime.block_on(analyzer.parse(paths.clone())));
+            start.elapsed()
+        });
+
+        let documents = Arc::new(DocumentStore::new());
+        let analyzer = Analyzer::new(documents.clone());
+        let mut edits = 0;
+        run("edit_to_diagnostics", &mut || {
+            // Each edit changes the file, so that it has to be parsed again.
+            edits += 1;
+            let edited = format!("{root_content}\ntable BenchEdit {{ field_{edits}: int; }}\n");
+            documents
+                .document_map
+                .insert(root.clone(), ropey::Rope::from_str(&edited));
+            if edits == 1 {
+                runtime.block_on(analyzer.parse(paths.clone()));
+            }
+            let start = Instant::now();
+            black_box(runtime.block_on(analyzer.parse_edit(root.clone())));
+            start.elapsed()
+        });
+    }
+
+    let report = Report {
+        server_version: env!("CARGO_PKG_VERSION"),
+        scale: options.scale,
+        results,
+    };
+    let json = serde_json::to_string_pretty(&report).expect("failed to serialize results");
+    match options.output {
+        Some(path) => fs::write(&path, json).expect("failed to write results"),
+        None => println!("{json}"),
+    }
+}
+
+/// Times flatc parsing `content` on its own, without exporting anything.
+fn parse_schema(path: &Path, content: &str) -> Duration {
+    let content = CString::new(content).expect("schema contains a nul byte");
+    let filename =
+        CString::new(path.to_str().unwrap_or_default()).expect("path contains a nul byte");
+    let mut include_paths = [std::ptr::null()];
+    let start = Instant::now();
+    let parser = unsafe {
+        ffi::parse_schema(
+            content.as_ptr(),
+            filename.as_ptr(),
+            include_paths.as_mut_ptr(),
+        )
+    };
+    let elapsed = start.elapsed();
+    unsafe { ffi::delete_parser(parser) };
+    elapsed
+}
+
+fn parse_args() -> Options {
+    let mut options = Options {
+        filter: None,
+        iterations: 10,
+        scale: 1,
+        output: None,
+    };
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--iterations" => options.iterations = number(args.next(), &arg),
+            "--scale" => options.scale = number(args.next(), &arg),
+            "--output" => options.output = args.next().map(PathBuf::from),
+            // Passed by `cargo bench`.
+            "--bench" => {}
+            _ if arg.starts_with("--") => eprintln!("ignoring unknown option {arg}"),
+            _ => options.filter = Some(arg),
+        }
+    }
+    options.iterations = options.iterations.max(1);
+    options
+}
+
+fn number(value: Option<String>, option: &str) -> usize {
+    value
+        .and_then(|value| value.parse().ok())
+        .unwrap_or_else(|| panic!("{option} takes a number"))
+}
@@ -7,15 +7,24 @@ fn main() {
         "src/cpp/wrapper.cpp",
     ];
 
-    cc::Build::new()
+    let mut build = cc::Build::new();
+    build
         .files(files)
         // Add our patched include first so it's preferred.
         .include("src/cpp/patched_flatbuffers")
         .include("third_party/flatbuffers/include")
         .include("src/cpp")
         .cpp(true)
-        .std("c++11")
-        .compile("flatbuffers");
+        .std("c++17");
+    // Counting allocations replaces the global operator new and delete.
+    if std::env::var_os("CARGO_FEATURE_PARSE_MEMORY_STATS").is_some() {
+        build.define("FLATBUFFERS_LS_MEMORY_STATS", None);
+    }
+    // Mapped sources fault if another process truncates them mid-parse.
+    if std::env::var_os("CARGO_FEATURE_MAP_SOURCES").is_some() {
+        build.define("FLATBUFFERS_LS_MAP_SOURCES", None);
+    }
+    build.compile("flatbuffers");
 
     println!("cargo:rerun-if-changed=src/cpp/wrapper.h");
     println!("cargo:rerun-if-changed=src/cpp/wrapper.cpp");
@@ -0,0 +1,265 @@
+use crate::analysis::reparse;
+use crate::analysis::workspace_index::WorkspaceIndex;
+use crate::parser::ParseResult;
+use crate::symbol_table::{Occurrence, RootTypeInfo, Symbol, SymbolTable};
+use serde::{Deserialize, Serialize};
+use std::collections::{HashMap, HashSet};
+use std::fs;
+use std::hash::{DefaultHasher, Hash, Hasher};
+use std::io;
+use std::path::{Path, PathBuf};
+use std::time::UNIX_EPOCH;
+use tower_lsp_server::lsp_types::Diagnostic;
+
+/// Bumped whenever the layout of the cache file changes.
+pub const INDEX_CACHE_VERSION: u32 = 4;
+
+/// Overrides where index caches are kept.
+pub const CACHE_DIR_ENV: &str = "FLATBUFFERS_LANGUAGE_SERVER_CACHE_DIR";
+
+/// Everything the index holds about one file, as of its last parse.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct CachedFile {
+    /// Modification time of the file when it was cached, in nanoseconds since
+    /// the Unix epoch.
+    pub mtime: u64,
+    /// See [`reparse::fingerprint`].
+    pub fingerprint: u64,
+    /// The symbols defined in the file, by fully-qualified name.
+    pub symbols: HashMap<String, Symbol>,
+    pub includes: Vec<PathBuf>,
+    pub root_type_info: Option<RootTypeInfo>,
+    pub user_defined_attributes: HashMap<String, String>,
+    pub occurrences: Vec<Occurrence>,
+    pub semantic_tokens: Vec<u32>,
+    pub diagnostics: Vec<Diagnostic>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct CacheFile {
+    version: u32,
+    server_version: String,
+    // Fingerprints are only comparable if they were hashed the same way.
+    hasher_check: u64,
+    files: HashMap<PathBuf, CachedFile>,
+}
+
+impl CachedFile {
+    /// What `index` holds about `path`, or `None` if it hasn't been parsed.
+    #[must_use]
+    pub fn from_index(index: &WorkspaceIndex, path: &Path, mtime: u64) -> Option<Self> {
+        let fingerprint = *index.fingerprints.get(path)?;
+        let symbols = index
+            .symbols
+            .per_file
+            .get(path)
+            .into_iter()
+            .flat_map(|keys| keys.iter())
+            .filter_map(|key| {
+                index
+                    .symbols
+                    .global
+                    .get(key)
+                    .map(|symbol| (key.clone(), Symbol::clone(symbol)))
+            })
+            .collect();
+        let user_defined_attributes = index
+            .symbols
+            .user_defined_attributes_per_file
+            .get(path)
+            .into_iter()
+            .flatten()
+            .filter_map(|name| {
+                index
+                    .symbols
+                    .user_defined_attributes
+                    .get(name)
+                    .map(|attribute| (name.clone(), attribute.doc.clone()))
+            })
+            .collect();
+        Some(Self {
+            mtime,
+            fingerprint,
+            symbols,
+            includes: index
+                .dependencies
+                .includes
+                .get(path)
+                .cloned()
+                .unwrap_or_default(),
+            root_type_info: index.root_types.root_types.get(path).cloned(),
+            user_defined_attributes,
+            occurrences: index
+                .occurrences
+                .per_file
+                .get(path)
+                .map(|occurrences| occurrences.to_vec())
+                .unwrap_or_default(),
+            semantic_tokens: index
+                .semantic_tokens
+                .get(path)
+                .map(|tokens| tokens.to_vec())
+                .unwrap_or_default(),
+            diagnostics: index
+                .diagnostics
+                .all()
+                .get(path)
+                .cloned()
+                .unwrap_or_default(),
+        })
+    }
+
+    /// The parse of `path` this was cached from, to merge into an index.
+    #[must_use]
+    pub fn into_parse_result(self, path: &Path) -> ParseResult {
+        let mut symbol_table = SymbolTable::new(path.to_path_buf());
+        for (key, symbol) in self.symbols {
+            symbol_table.insert(key, symbol);
+        }
+        ParseResult {
+            diagnostics: HashMap::from([(path.to_path_buf(), self.diagnostics)]),
+            symbol_table: Some(symbol_table),
+            includes: self.includes,
+            root_type_info: self.root_type_info,
+            user_defined_attributes: self.user_defined_attributes,
+            occurrences: self.occurrences,
+            semantic_tokens: self.semantic_tokens,
+            // Files with unresolved includes aren't cached.
+            unresolved_includes: Vec::new(),
+        }
+    }
+}
+
+/// The modification time of `path` as [`CachedFile::mtime`] records it.
+#[must_use]
+pub fn mtime(path: &Path) -> Option<u64> {
+    let modified = fs::metadata(path).ok()?.modified().ok()?;
+    let since_epoch = modified.duration_since(UNIX_EPOCH).ok()?;
+    u64::try_from(since_epoch.as_nanos()).ok()
+}
+
+/// Where index caches are kept: [`CACHE_DIR_ENV`] if set, and otherwise the
+/// user's cache directory.
+#[must_use]
+pub fn default_dir() -> Option<PathBuf> {
+    if let Some(dir) = std::env::var_os(CACHE_DIR_ENV) {
+        return Some(PathBuf::from(dir));
+    }
+    // Test servers would otherwise leave a cache behind for every temporary
+    // workspace.
+    if cfg!(feature = "test-harness") {
+        return None;
+    }
+    let base = if cfg!(windows) {
+        std::env::var_os("LOCALAPPDATA").map(PathBuf::from)
+    } else if cfg!(target_os = "macos") {
+        std::env::var_os("HOME").map(|home| PathBuf::from(home).join("Library/Caches"))
+    } else {
+        std::env::var_os("XDG_CACHE_HOME")
+            .map(PathBuf::from)
+            .or_else(|| std::env::var_os("HOME").map(|home| PathBuf::from(home).join(".cache")))
+    };
+    base.map(|base| base.join("flatbuffers-language-server"))
+}
+
+/// The cache file in `dir` for a workspace with `roots`.
+#[must_use]
+pub fn cache_path(dir: &Path, roots: &HashSet<PathBuf>) -> PathBuf {
+    let mut roots: Vec<&PathBuf> = roots.iter().collect();
+    roots.sort_unstable();
+    let mut hasher = DefaultHasher::new();
+    roots.hash(&mut hasher);
+    dir.join(format!("index-{:016x}.json", hasher.finish()))
+}
+
+/// The files cached at `path`, or none if there is no cache there that this
+/// version of the server wrote.
+#[must_use]
+pub fn load(path: &Path) -> HashMap<PathBuf, CachedFile> {
+    let Ok(bytes) = fs::read(path) else {
+        return HashMap::new();
+    };
+    match serde_json::from_slice::<CacheFile>(&bytes) {
+        Ok(cache)
+            if cache.version == INDEX_CACHE_VERSION
+                && cache.server_version == env!("CARGO_PKG_VERSION")
+                && cache.hasher_check == hasher_check() =>
+        {
+            cache.files
+        }
+        Ok(_) => HashMap::new(),
+        Err(e) => {
+            log::error!("failed to read index cache {}: {}", path.display(), e);
+            HashMap::new()
+        }
+    }
+}
+
+/// Writes `files` to the cache at `path`, replacing what was there.
+///
+/// # Errors
+///
+/// Returns an error if the cache file couldn't be written.
+pub fn save(path: &Path, files: HashMap<PathBuf, CachedFile>) -> io::Result<()> {
+    let cache = CacheFile {
+        version: INDEX_CACHE_VERSION,
+        server_version: env!("CARGO_PKG_VERSION").to_string(),
+        hasher_check: hasher_check(),
+        files,
+    };
+    let bytes = serde_json::to_vec(&cache)?;
+    if let Some(dir) = path.parent() {
+        fs::create_dir_all(dir)?;
+    }
+    // Write and rename, so that a server starting meanwhile never reads half
+    // a cache.
+    let partial = path.with_extension(format!("json.{}", std::process::id()));
+    fs::write(&partial, bytes)?;
+    fs::rename(&partial, path)
+}
+
+fn hasher_check() -> u64 {
+    reparse::content_hash("flatbuffers-language-server")
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_cache_path_ignores_root_order() {
+        let dir = Path::new("/cache");
+        let a = PathBuf::from("/a");
+        let b = PathBuf::from("/b");
+
+        let forward = cache_path(dir, &HashSet::from([a.clone(), b.clone()]));
+        let backward = cache_path(dir, &HashSet::from([b, a.clone()]));
+        assert_eq!(forward, backward);
+        assert_ne!(forward, cache_path(dir, &HashSet::from([a])));
+    }
+
+    #[test]
+    fn test_save_and_load() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("nested").join("index.json");
+        let file = CachedFile {
+            mtime: 1,
+            fingerprint: 2,
+            symbols: HashMap::new(),
+            includes: vec![PathBuf::from("/b.fbs")],
+            root_type_info: None,
+            user_defined_attributes: HashMap::from([("a".to_string(), "doc".to_string())]),
+            occurrences: vec![],
+            semantic_tokens: vec![0, 4, 3, 2, 0],
+            diagnostics: vec![],
+        };
+        let files = HashMap::from([(PathBuf::from("/a.fbs"), file)]);
+
+        assert!(load(&path).is_empty());
+        save(&path, files.clone()).unwrap();
+        assert_eq!(load(&path), files);
+
+        fs::write(&path, "{").unwrap();
+        assert!(load(&path).is_empty());
+    }
+}
@@ -1,49 +1,76 @@
 pub mod dependency_graph;
 pub mod diagnostic_store;
+pub mod index_cache;
+pub mod occurrence_index;
+pub mod reparse;
 pub mod root_type_store;
+pub mod search_index;
 pub mod snapshot;
 pub mod symbol_index;
 pub mod workspace_index;
 
+use crate::analysis::index_cache::CachedFile;
 pub use crate::analysis::snapshot::WorkspaceSnapshot;
 use crate::analysis::workspace_index::WorkspaceIndex;
 use crate::document_store::DocumentStore;
-use crate::parser::Parser;
+use crate::parser::{BatchSchema, FlatcFFIParser, IncludeCache, Parser};
 use crate::utils::paths::{is_flatbuffer_schema, uri_to_path_buf};
 use crate::workspace_layout::WorkspaceLayout;
+use dashmap::DashMap;
 use log::info;
 use std::collections::{HashMap, HashSet};
 use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::Arc;
-use tokio::sync::RwLock;
+use tokio::sync::{RwLock, RwLockMappedWriteGuard, RwLockWriteGuard};
 use tower_lsp_server::lsp_types::{Diagnostic, FileChangeType, FileEvent, Uri};
 use tower_lsp_server::UriExt;
 
 /// A semantic analyzer for a workspace.
 #[derive(Debug)]
 pub struct Analyzer {
-    index: RwLock<WorkspaceIndex>,
+    index: RwLock<Arc<WorkspaceIndex>>,
     documents: Arc<DocumentStore>,
+    parser: FlatcFFIParser,
     pub layout: RwLock<WorkspaceLayout>,
+    /// The cancel flag of the latest parse started by [`Self::parse_edit`] for
+    /// each file, while it runs.
+    edit_parses: DashMap<PathBuf, Arc<AtomicBool>>,
 }
 
 impl Analyzer {
     #[must_use]
     pub fn new(documents: Arc<DocumentStore>) -> Self {
         Self {
-            index: RwLock::new(WorkspaceIndex::new()),
+            index: RwLock::new(Arc::new(WorkspaceIndex::new())),
             documents,
+            parser: FlatcFFIParser::with_include_cache(Arc::new(IncludeCache::new())).incremental(),
             layout: RwLock::new(WorkspaceLayout::new()),
+            edit_parses: DashMap::new(),
         }
     }
 
-    pub async fn snapshot(&'_ self) -> WorkspaceSnapshot<'_> {
+    /// The index and documents as they are now. The index lock is only held
+    /// to clone its `Arc`, so a snapshot never holds up a parse merging its
+    /// results, and later merges don't change what the snapshot sees.
+    pub async fn snapshot(&self) -> WorkspaceSnapshot {
         WorkspaceSnapshot {
-            index: self.index.read().await,
-            documents: Arc::new(self.documents.document_map.clone()),
+            index: self.index.read().await.clone(),
+            documents: self.documents.document_map.snapshot(),
+            read_sources: DashMap::new(),
         }
     }
 
+    /// The index, to change. If a snapshot still holds the current one, the
+    /// writer gets a copy of it, which the snapshot doesn't see, and the
+    /// snapshot keeps the old one until it is dropped. The copy shares the
+    /// symbols and per-file results, see [`WorkspaceIndex`], but still copies
+    /// the maps that hold them, so writers should take this once per batch of
+    /// changes rather than once per file.
+    async fn index_mut(&self) -> RwLockMappedWriteGuard<'_, WorkspaceIndex> {
+        RwLockWriteGuard::map(self.index.write().await, Arc::make_mut)
+    }
+
     pub async fn handle_workspace_folder_changes(
         &self,
         added: Vec<Uri>,
@@ -92,7 +119,7 @@ impl Analyzer {
         let mut files_to_reparse;
 
         let mut layout = self.layout.write().await;
-        let mut index = self.index.write().await;
+        let mut index = self.index_mut().await;
         let to_remove = layout.known_matching_files(folder);
 
         files_to_reparse = HashSet::new();
@@ -114,71 +141,373 @@ impl Analyzer {
         }
     }
 
-    /// Parse a set of files and return the set of new diagnostics
-    /// to publish as a result.
-    pub async fn parse(
-        &self,
-        paths: impl IntoIterator<Item = PathBuf>,
-    ) -> Vec<(PathBuf, Vec<Diagnostic>)> {
-        let mut parsed_in_scan = HashSet::new();
-        let mut all_diagnostics = Vec::new();
-        for path in paths {
-            if !parsed_in_scan.contains(&path) {
-                let mut diags = self.parse_single(&path, &mut parsed_in_scan).await;
-                all_diagnostics.append(&mut diags);
+    /// Fill the index from the cache at `cache_path` with `files`, and the
+    /// files they include, wherever they haven't been modified since they were
+    /// cached.
+    ///
+    /// Restored files aren't read, so once the server is ready they should be
+    /// revalidated with [`Self::parse`], which skips those that are unchanged.
+    pub async fn restore_index(&self, cache_path: &Path, files: &[PathBuf]) -> IndexRestore {
+        let cache_path = cache_path.to_path_buf();
+        let fresh = tokio::task::spawn_blocking(move || {
+            let mut cached = index_cache::load(&cache_path);
+            cached.retain(|path, file| index_cache::mtime(path) == Some(file.mtime));
+            cached
+        })
+        .await;
+        let mut fresh = match fresh {
+            Ok(fresh) => fresh,
+            Err(e) => {
+                log::error!("index cache task failed: {e}");
+                HashMap::new()
+            }
+        };
+
+        let mut restore = IndexRestore::default();
+        let mut seen = HashSet::new();
+        let mut queue = files.to_vec();
+        let mut index = self.index_mut().await;
+        while let Some(path) = queue.pop() {
+            if !seen.insert(path.clone()) {
+                continue;
             }
+            let Some(file) = fresh.remove(&path) else {
+                restore.missing.push(path);
+                continue;
+            };
+            queue.extend(file.includes.iter().cloned());
+            let fingerprint = file.fingerprint;
+            index.update(&path, file.into_parse_result(&path));
+            index.fingerprints.insert(path.clone(), fingerprint);
+            restore.restored.push(path);
         }
-        all_diagnostics
+        restore
     }
 
-    async fn parse_single(
+    /// Write what the index holds about every file it has parsed to the cache
+    /// at `cache_path`.
+    pub async fn save_index(&self, cache_path: &Path) {
+        let paths: Vec<PathBuf> = self
+            .index
+            .read()
+            .await
+            .fingerprints
+            .keys()
+            .cloned()
+            .collect();
+        let mtimes = tokio::task::spawn_blocking(move || {
+            paths
+                .into_iter()
+                .filter_map(|path| index_cache::mtime(&path).map(|mtime| (path, mtime)))
+                .collect::<Vec<_>>()
+        })
+        .await
+        .unwrap_or_default();
+        let files: HashMap<PathBuf, CachedFile> = {
+            let index = self.index.read().await;
+            mtimes
+                .into_iter()
+                .filter_map(|(path, mtime)| {
+                    CachedFile::from_index(&index, &path, mtime).map(|file| (path, file))
+                })
+                .collect()
+        };
+
+        let count = files.len();
+        let cache_path = cache_path.to_path_buf();
+        let saved = tokio::task::spawn_blocking(move || {
+            index_cache::save(&cache_path, files).map(|()| cache_path)
+        })
+        .await;
+        match saved {
+            Ok(Ok(cache_path)) => info!("cached {count} files in {}", cache_path.display()),
+            Ok(Err(e)) => log::error!("failed to write index cache: {e}"),
+            Err(e) => log::error!("index cache task failed: {e}"),
+        }
+    }
+
+    /// Parse a set of files, along with the files that include them and the
+    /// files they include, and return the set of new diagnostics to publish as
+    /// a result.
+    ///
+    /// Files whose contents and includes' contents are the same as when they
+    /// were last parsed are skipped, since their results can't have changed.
+    /// The rest are parsed in levels, each file after the files it includes,
+    /// so that the include cache can serve every include that one of them
+    /// parsed. Each level is parsed as one batch off the async runtime, and the
+    /// index is only locked to merge in that level's results.
+    pub async fn parse(
         &self,
-        path: &Path,
-        parsed_files: &mut HashSet<PathBuf>,
+        paths: impl IntoIterator<Item = PathBuf>,
     ) -> Vec<(PathBuf, Vec<Diagnostic>)> {
-        let layout = self.layout.read().await;
-        let mut index = self.index.write().await;
-        let search_paths: Vec<_> = layout.search_paths.iter().map(PathBuf::from).collect();
+        self.parse_unless_cancelled(paths, Arc::new(AtomicBool::new(false)))
+            .await
+            .unwrap_or_default()
+    }
 
-        let mut files_to_parse = vec![path.to_path_buf()];
-        let mut newly_parsed_files = HashSet::new();
+    /// Parse `path` after an edit to it, like [`Self::parse`], and cancel the
+    /// parse for an earlier edit to it if that is still running, since its
+    /// results are already out of date. The cancelled parse returns no
+    /// diagnostics, and this one publishes whatever that one left unpublished.
+    pub async fn parse_edit(&self, path: PathBuf) -> Vec<(PathBuf, Vec<Diagnostic>)> {
+        let cancel = Arc::new(AtomicBool::new(false));
+        if let Some(superseded) = self.edit_parses.insert(path.clone(), cancel.clone()) {
+            superseded.store(true, Ordering::Relaxed);
+        }
+        let diagnostics = self
+            .parse_unless_cancelled(vec![path.clone()], cancel.clone())
+            .await;
+        self.edit_parses
+            .remove_if(&path, |_, latest| Arc::ptr_eq(latest, &cancel));
+        diagnostics.unwrap_or_default()
+    }
 
-        while let Some(path) = files_to_parse.pop() {
-            if !parsed_files.insert(path.clone()) {
-                continue;
+    /// [`Self::parse`], giving up with `None` as soon as `cancel` is set. The
+    /// results merged into the index by then stay there, unpublished.
+    ///
+    /// `cancel` is checked again under the index lock before each level is
+    /// merged, so a superseded parse never merges over the parse that
+    /// superseded it.
+    async fn parse_unless_cancelled(
+        &self,
+        paths: impl IntoIterator<Item = PathBuf>,
+        cancel: Arc<AtomicBool>,
+    ) -> Option<Vec<(PathBuf, Vec<Diagnostic>)>> {
+        let search_paths: Vec<PathBuf> = {
+            let layout = self.layout.read().await;
+            layout.search_paths.iter().map(PathBuf::from).collect()
+        };
+
+        let paths: Vec<PathBuf> = paths.into_iter().collect();
+        let mut pending = {
+            let index = self.index.read().await;
+            reparse::with_dependents(&index.dependencies, &paths)
+        };
+        let mut seen_in_scan = HashSet::new();
+        let mut hashes = HashMap::new();
+        while !pending.is_empty() {
+            if cancel.load(Ordering::Relaxed) {
+                return None;
             }
-            newly_parsed_files.insert(path.clone());
-
-            let content = if let Some(doc) = self.documents.document_map.get(&path) {
-                doc.value().to_string()
-            } else {
-                match tokio::fs::read_to_string(&path).await {
-                    Ok(text) => {
-                        self.documents
-                            .document_map
-                            .insert(path.clone(), ropey::Rope::from_str(&text));
-                        text
-                    }
+            let mut to_parse = Vec::new();
+            for path in std::mem::take(&mut pending) {
+                if !seen_in_scan.insert(path.clone()) {
+                    continue;
+                }
+                let Some(content) = self.read_document(&path).await else {
+                    continue;
+                };
+                hashes.insert(path.clone(), Some(reparse::content_hash(&content)));
+                if !self.is_up_to_date(&path, &search_paths, &mut hashes).await {
+                    to_parse.push((path, content));
+                }
+            }
+
+            let levels = {
+                let index = self.index.read().await;
+                reparse::parse_levels(&index.dependencies, to_parse)
+            };
+            for level in levels {
+                if cancel.load(Ordering::Relaxed) {
+                    return None;
+                }
+                let schemas: Vec<BatchSchema> = {
+                    let index = self.index.read().await;
+                    level
+                        .into_iter()
+                        .map(|(path, content)| {
+                            log::info!("parsing: {}", path.display());
+                            let has_includers = index
+                                .dependencies
+                                .included_by
+                                .get(&path)
+                                .is_some_and(|includers| !includers.is_empty());
+                            BatchSchema {
+                                path,
+                                content,
+                                has_includers,
+                            }
+                        })
+                        .collect()
+                };
+                let overlay = self.include_overlay(&schemas).await;
+
+                let parser = self.parser.clone();
+                let batch_search_paths = search_paths.clone();
+                let batch_cancel = cancel.clone();
+                let parsed = tokio::task::spawn_blocking(move || {
+                    let results =
+                        parser.parse_batch(&schemas, &batch_search_paths, &overlay, &batch_cancel);
+                    (schemas, results)
+                })
+                .await;
+                let (schemas, results) = match parsed {
+                    Ok((_, None)) => return None,
+                    Ok((schemas, Some(results))) => (schemas, results),
                     Err(e) => {
-                        log::error!("failed to read file {}: {}", path.display(), e);
+                        log::error!("parse task failed: {e}");
                         continue;
                     }
-                }
-            };
+                };
 
-            log::info!("parsing: {}", path.display());
-            let result = crate::parser::FlatcFFIParser.parse(&path, &content, &search_paths);
+                let mut merged = Vec::with_capacity(schemas.len());
+                for (schema, result) in schemas.into_iter().zip(results) {
+                    // Collecting its results panicked, which was logged.
+                    let Some(result) = result else {
+                        continue;
+                    };
+                    for included_path in &result.includes {
+                        if !seen_in_scan.contains(included_path) {
+                            pending.push(included_path.clone());
+                        }
+                    }
+                    // A file with an include that couldn't be found isn't
+                    // fingerprinted, so it is parsed again every time, since
+                    // the include may have been added since.
+                    let fingerprint = if result.unresolved_includes.is_empty() {
+                        Some(
+                            self.fingerprint(
+                                &schema.path,
+                                &result.includes,
+                                &search_paths,
+                                &mut hashes,
+                            )
+                            .await,
+                        )
+                    } else {
+                        None
+                    };
+                    merged.push((schema.path, result, fingerprint));
+                }
 
-            for included_path in &result.includes {
-                if !parsed_files.contains(included_path) {
-                    files_to_parse.push(included_path.clone());
+                // The whole level is merged under one lock, so that a snapshot
+                // taken in between costs at most one copy of the index.
+                let index = self.index.write().await;
+                // A newer parse may have merged its results while this one
+                // was parsing or waiting for the lock.
+                if cancel.load(Ordering::Relaxed) {
+                    return None;
+                }
+                let mut index = RwLockWriteGuard::map(index, Arc::make_mut);
+                for (path, result, fingerprint) in merged {
+                    index.update(&path, result);
+                    match fingerprint {
+                        Some(fingerprint) => index.fingerprints.insert(path, fingerprint),
+                        None => index.fingerprints.remove(&path),
+                    };
                 }
             }
+        }
+
+        let mut index = self.index_mut().await;
+        if cancel.load(Ordering::Relaxed) {
+            return None;
+        }
+        Some(index.diagnostics.mark_published().into_iter().collect())
+    }
+
+    /// Whether `path` was last parsed with the same contents, the same contents
+    /// of the files it included and the same search paths that it would be
+    /// parsed with now.
+    async fn is_up_to_date(
+        &self,
+        path: &Path,
+        search_paths: &[PathBuf],
+        hashes: &mut HashMap<PathBuf, Option<u64>>,
+    ) -> bool {
+        let (recorded, includes) = {
+            let index = self.index.read().await;
+            let Some(&recorded) = index.fingerprints.get(path) else {
+                return false;
+            };
+            let includes = index
+                .dependencies
+                .includes
+                .get(path)
+                .cloned()
+                .unwrap_or_default();
+            (recorded, includes)
+        };
+        self.fingerprint(path, &includes, search_paths, hashes)
+            .await
+            == recorded
+    }
+
+    /// The [`reparse::fingerprint`] of `path` and `includes` as they are now,
+    /// looked up in `search_paths`. `hashes` caches content hashes for the rest
+    /// of the scan.
+    async fn fingerprint(
+        &self,
+        path: &Path,
+        includes: &[PathBuf],
+        search_paths: &[PathBuf],
+        hashes: &mut HashMap<PathBuf, Option<u64>>,
+    ) -> u64 {
+        let content = self.content_hash(path, hashes).await;
+        let mut include_hashes = Vec::with_capacity(includes.len());
+        for included_path in includes {
+            let hash = self.content_hash(included_path, hashes).await;
+            include_hashes.push((included_path.as_path(), hash));
+        }
+        reparse::fingerprint(content.unwrap_or_default(), &include_hashes, search_paths)
+    }
 
-            index.update(&path, result);
+    async fn content_hash(
+        &self,
+        path: &Path,
+        hashes: &mut HashMap<PathBuf, Option<u64>>,
+    ) -> Option<u64> {
+        if let Some(&hash) = hashes.get(path) {
+            return hash;
+        }
+        let hash = self
+            .read_document(path)
+            .await
+            .map(|content| reparse::content_hash(&content));
+        hashes.insert(path.to_path_buf(), hash);
+        hash
+    }
+
+    /// The contents of `path`, from the document store if it is there, and
+    /// otherwise from disk, which then adds it to the store.
+    async fn read_document(&self, path: &Path) -> Option<String> {
+        if let Some(doc) = self.documents.document_map.get(path) {
+            return Some(doc.to_string());
+        }
+        match tokio::fs::read_to_string(path).await {
+            Ok(text) => {
+                self.documents
+                    .document_map
+                    .insert(path.to_path_buf(), ropey::Rope::from_str(&text));
+                Some(text)
+            }
+            Err(e) => {
+                log::error!("failed to read file {}: {}", path.display(), e);
+                None
+            }
         }
+    }
 
-        index.diagnostics.mark_published().into_iter().collect()
+    /// The known includes of `schemas` that the client has open, so that
+    /// unsaved edits to them are seen by their includers too. Every other
+    /// include is read from disk by flatc.
+    async fn include_overlay(&self, schemas: &[BatchSchema]) -> Vec<(PathBuf, String)> {
+        let index = self.index.read().await;
+        let included_paths: HashSet<&PathBuf> = schemas
+            .iter()
+            .filter_map(|schema| index.dependencies.includes.get(&schema.path))
+            .flatten()
+            .collect();
+        included_paths
+            .into_iter()
+            .filter(|included_path| self.documents.is_open(included_path))
+            .filter_map(|included_path| {
+                self.documents
+                    .document_map
+                    .get(included_path)
+                    .map(|doc| (included_path.clone(), doc.to_string()))
+            })
+            .collect()
     }
 
     pub async fn handle_file_changes(
@@ -197,7 +526,7 @@ impl Analyzer {
 
         {
             let mut layout = self.layout.write().await;
-            let mut index = self.index.write().await;
+            let mut index = self.index_mut().await;
 
             for event in changes {
                 // Canonicalize will fail for deleted files, so fall back to non-canonical.
@@ -212,6 +541,11 @@ impl Analyzer {
                     continue;
                 }
 
+                if matches!(event.typ, FileChangeType::CREATED | FileChangeType::DELETED) {
+                    // An include may now resolve to another file.
+                    self.parser.forget_include_resolutions();
+                }
+
                 match event.typ {
                     FileChangeType::CREATED => {
                         files_to_reparse.insert(path.clone());
@@ -221,6 +555,11 @@ impl Analyzer {
                         // NOTE: This doubles the work done on save,
                         // but allows us to capture file changes made
                         // outside of the client (e.g. git checkout).
+                        // The copy of a file the client doesn't have open is
+                        // out of date, so it is read from disk again.
+                        if !self.documents.is_open(&path) {
+                            self.documents.document_map.remove(&path);
+                        }
                         files_to_reparse.insert(path);
                     }
                     FileChangeType::DELETED => {
@@ -251,6 +590,15 @@ impl Analyzer {
     }
 }
 
+/// The result of [`Analyzer::restore_index`].
+#[derive(Debug, Default)]
+pub struct IndexRestore {
+    /// Files now in the index as they were cached.
+    pub restored: Vec<PathBuf>,
+    /// Files that couldn't be restored and still need parsing.
+    pub missing: Vec<PathBuf>,
+}
+
 /// The results of removing a folder.
 struct FolderRemoval {
     // The removed files.
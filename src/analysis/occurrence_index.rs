@@ -0,0 +1,113 @@
+use crate::symbol_table::Occurrence;
+use std::collections::{HashMap, HashSet};
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+
+/// An index of where each type is referred to by name, as the parser found
+/// them, so that finding references doesn't walk every symbol.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct OccurrenceIndex {
+    /// Map from a file path to the references in it, in the order they were parsed.
+    pub per_file: HashMap<PathBuf, Arc<[Occurrence]>>,
+    /// Map from a fully-qualified type name to the files that refer to it.
+    pub referencing_files: HashMap<String, HashSet<PathBuf>>,
+}
+
+impl OccurrenceIndex {
+    pub fn update(&mut self, path: &Path, occurrences: Vec<Occurrence>) {
+        self.remove(path);
+        for occurrence in &occurrences {
+            self.referencing_files
+                .entry(occurrence.target.clone())
+                .or_default()
+                .insert(path.to_path_buf());
+        }
+        self.per_file.insert(path.to_path_buf(), occurrences.into());
+    }
+
+    pub fn remove(&mut self, path: &Path) {
+        let Some(old_occurrences) = self.per_file.remove(path) else {
+            return;
+        };
+        for occurrence in &*old_occurrences {
+            if let Some(files) = self.referencing_files.get_mut(&occurrence.target) {
+                files.remove(path);
+                if files.is_empty() {
+                    self.referencing_files.remove(&occurrence.target);
+                }
+            }
+        }
+    }
+
+    /// Every reference to the type named `target`, with the file it is in.
+    pub fn references<'a>(
+        &'a self,
+        target: &'a str,
+    ) -> impl Iterator<Item = (&'a Path, &'a Occurrence)> + 'a {
+        self.referencing_files
+            .get(target)
+            .into_iter()
+            .flatten()
+            .flat_map(move |path| {
+                self.per_file
+                    .get(path)
+                    .into_iter()
+                    .flat_map(|occurrences| occurrences.iter())
+                    .filter(move |occurrence| occurrence.target == target)
+                    .map(move |occurrence| (path.as_path(), occurrence))
+            })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tower_lsp_server::lsp_types::{Position, Range};
+
+    fn occurrence(line: u32, target: &str) -> Occurrence {
+        Occurrence {
+            range: Range::new(Position::new(line, 0), Position::new(line, 3)),
+            target: target.to_string(),
+        }
+    }
+
+    fn lines(index: &OccurrenceIndex, target: &str) -> Vec<(PathBuf, u32)> {
+        let mut lines: Vec<_> = index
+            .references(target)
+            .map(|(path, occurrence)| (path.to_path_buf(), occurrence.range.start.line))
+            .collect();
+        lines.sort();
+        lines
+    }
+
+    #[test]
+    fn test_references() {
+        let a = Path::new("a.fbs");
+        let b = Path::new("b.fbs");
+        let mut index = OccurrenceIndex::default();
+        index.update(a, vec![occurrence(1, "A"), occurrence(2, "ns.B")]);
+        index.update(b, vec![occurrence(3, "ns.B")]);
+
+        assert_eq!(lines(&index, "A"), vec![(a.to_path_buf(), 1)]);
+        assert_eq!(
+            lines(&index, "ns.B"),
+            vec![(a.to_path_buf(), 2), (b.to_path_buf(), 3)]
+        );
+        assert!(lines(&index, "B").is_empty());
+    }
+
+    #[test]
+    fn test_update_and_remove() {
+        let a = Path::new("a.fbs");
+        let mut index = OccurrenceIndex::default();
+        index.update(a, vec![occurrence(1, "A")]);
+        index.update(a, vec![occurrence(5, "B")]);
+
+        assert!(lines(&index, "A").is_empty());
+        assert!(!index.referencing_files.contains_key("A"));
+        assert_eq!(lines(&index, "B"), vec![(a.to_path_buf(), 5)]);
+
+        index.remove(a);
+        assert_eq!(index, OccurrenceIndex::default());
+    }
+}
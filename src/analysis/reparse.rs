@@ -0,0 +1,260 @@
+use crate::analysis::dependency_graph::DependencyGraph;
+use std::collections::{HashMap, HashSet};
+use std::hash::{DefaultHasher, Hash, Hasher};
+use std::path::{Path, PathBuf};
+
+/// Hash of a file's contents, as read for a parse.
+#[must_use]
+pub fn content_hash(content: &str) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    content.hash(&mut hasher);
+    hasher.finish()
+}
+
+/// Hash of everything a parse of a file reads: its own contents, those of each
+/// file it includes, and the search paths its includes were looked up in.
+/// `None` stands for a file that couldn't be read.
+///
+/// Parsing a file again can only change its results if this changes, unless
+/// some of its includes couldn't be found, which no fingerprint covers.
+#[must_use]
+pub fn fingerprint(
+    content: u64,
+    includes: &[(&Path, Option<u64>)],
+    search_paths: &[PathBuf],
+) -> u64 {
+    let mut includes = includes.to_vec();
+    includes.sort_unstable();
+    let mut search_paths: Vec<&PathBuf> = search_paths.iter().collect();
+    search_paths.sort_unstable();
+    let mut hasher = DefaultHasher::new();
+    content.hash(&mut hasher);
+    includes.hash(&mut hasher);
+    search_paths.hash(&mut hasher);
+    hasher.finish()
+}
+
+/// `paths` and every file that includes any of them, without duplicates.
+#[must_use]
+pub fn with_dependents(graph: &DependencyGraph, paths: &[PathBuf]) -> Vec<PathBuf> {
+    let mut seen = HashSet::new();
+    let mut files = Vec::new();
+    let mut queue: Vec<&PathBuf> = paths.iter().collect();
+    while let Some(path) = queue.pop() {
+        if !seen.insert(path) {
+            continue;
+        }
+        files.push(path.clone());
+        if let Some(included_by) = graph.included_by.get(path) {
+            queue.extend(included_by);
+        }
+    }
+    files
+}
+
+/// Splits `files` into levels to parse one after another, so that every file
+/// comes after the files it includes. Files within a level don't include each
+/// other and can be parsed at once.
+///
+/// Files of an include cycle are ordered arbitrarily.
+#[must_use]
+pub fn parse_levels<T>(
+    graph: &DependencyGraph,
+    files: Vec<(PathBuf, T)>,
+) -> Vec<Vec<(PathBuf, T)>> {
+    let positions: HashMap<&PathBuf, usize> = files
+        .iter()
+        .enumerate()
+        .map(|(i, (path, _))| (path, i))
+        .collect();
+    let includes: Vec<Vec<usize>> = files
+        .iter()
+        .map(|(path, _)| {
+            graph
+                .includes
+                .get(path)
+                .into_iter()
+                .flatten()
+                .filter_map(|included| positions.get(included).copied())
+                .collect()
+        })
+        .collect();
+    drop(positions);
+
+    let mut levels = vec![None; files.len()];
+    let mut visiting = vec![false; files.len()];
+    for i in 0..files.len() {
+        level_of(i, &includes, &mut levels, &mut visiting);
+    }
+
+    let mut result: Vec<Vec<(PathBuf, T)>> = Vec::new();
+    for (file, level) in files.into_iter().zip(levels) {
+        let level = level.unwrap_or_default();
+        if result.len() <= level {
+            result.resize_with(level + 1, Vec::new);
+        }
+        result[level].push(file);
+    }
+    result
+}
+
+/// One more than the highest level of the files `i` includes, or 0 if it
+/// includes none of them.
+fn level_of(
+    i: usize,
+    includes: &[Vec<usize>],
+    levels: &mut [Option<usize>],
+    visiting: &mut [bool],
+) -> usize {
+    if let Some(level) = levels[i] {
+        return level;
+    }
+    if visiting[i] {
+        // Include cycle.
+        return 0;
+    }
+    visiting[i] = true;
+    let level = includes[i]
+        .iter()
+        .map(|&included| level_of(included, includes, levels, visiting) + 1)
+        .max()
+        .unwrap_or(0);
+    visiting[i] = false;
+    levels[i] = Some(level);
+    level
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn graph(edges: &[(&str, &[&str])]) -> DependencyGraph {
+        let mut graph = DependencyGraph::default();
+        for (path, includes) in edges {
+            graph.update(
+                Path::new(path),
+                includes.iter().map(PathBuf::from).collect(),
+            );
+        }
+        graph
+    }
+
+    fn names<T>(levels: &[Vec<(PathBuf, T)>]) -> Vec<Vec<String>> {
+        levels
+            .iter()
+            .map(|level| {
+                let mut names: Vec<String> = level
+                    .iter()
+                    .map(|(path, _)| path.display().to_string())
+                    .collect();
+                names.sort();
+                names
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_with_dependents() {
+        // a includes b, which includes c. d is unrelated.
+        let graph = graph(&[
+            ("a.fbs", &["b.fbs", "c.fbs"]),
+            ("b.fbs", &["c.fbs"]),
+            ("d.fbs", &[]),
+        ]);
+
+        let mut files = with_dependents(&graph, &[PathBuf::from("c.fbs")]);
+        files.sort();
+        assert_eq!(
+            files,
+            vec![
+                PathBuf::from("a.fbs"),
+                PathBuf::from("b.fbs"),
+                PathBuf::from("c.fbs")
+            ]
+        );
+        assert_eq!(
+            with_dependents(&graph, &[PathBuf::from("a.fbs"), PathBuf::from("a.fbs")]),
+            vec![PathBuf::from("a.fbs")]
+        );
+    }
+
+    #[test]
+    fn test_parse_levels() {
+        let graph = graph(&[
+            ("a.fbs", &["b.fbs", "c.fbs"]),
+            ("b.fbs", &["c.fbs"]),
+            ("d.fbs", &["c.fbs"]),
+        ]);
+        let files = ["a.fbs", "b.fbs", "c.fbs", "d.fbs"]
+            .iter()
+            .map(|path| (PathBuf::from(path), ()))
+            .collect();
+
+        assert_eq!(
+            names(&parse_levels(&graph, files)),
+            vec![vec!["c.fbs"], vec!["b.fbs", "d.fbs"], vec!["a.fbs"]]
+        );
+    }
+
+    #[test]
+    fn test_parse_levels_skips_files_not_being_parsed() {
+        let graph = graph(&[("a.fbs", &["b.fbs", "c.fbs"]), ("b.fbs", &["c.fbs"])]);
+        let files = ["a.fbs", "c.fbs"]
+            .iter()
+            .map(|path| (PathBuf::from(path), ()))
+            .collect();
+
+        assert_eq!(
+            names(&parse_levels(&graph, files)),
+            vec![vec!["c.fbs"], vec!["a.fbs"]]
+        );
+    }
+
+    #[test]
+    fn test_parse_levels_with_cycle() {
+        let graph = graph(&[("a.fbs", &["b.fbs"]), ("b.fbs", &["a.fbs"])]);
+        let files = ["a.fbs", "b.fbs"]
+            .iter()
+            .map(|path| (PathBuf::from(path), ()))
+            .collect();
+
+        let levels = parse_levels(&graph, files);
+        assert_eq!(levels.iter().map(Vec::len).sum::<usize>(), 2);
+    }
+
+    #[test]
+    fn test_fingerprint() {
+        let b = Path::new("b.fbs");
+        let c = Path::new("c.fbs");
+        let search_paths = [PathBuf::from("x"), PathBuf::from("y")];
+        let base = fingerprint(1, &[(b, Some(2)), (c, Some(3))], &search_paths);
+
+        assert_eq!(
+            base,
+            fingerprint(1, &[(c, Some(3)), (b, Some(2))], &search_paths)
+        );
+        assert_ne!(
+            base,
+            fingerprint(4, &[(b, Some(2)), (c, Some(3))], &search_paths)
+        );
+        assert_ne!(
+            base,
+            fingerprint(1, &[(b, Some(2)), (c, Some(5))], &search_paths)
+        );
+        assert_ne!(
+            base,
+            fingerprint(1, &[(b, Some(2)), (c, None)], &search_paths)
+        );
+        assert_ne!(base, fingerprint(1, &[(b, Some(2))], &search_paths));
+
+        let reordered = [PathBuf::from("y"), PathBuf::from("x")];
+        assert_eq!(
+            base,
+            fingerprint(1, &[(b, Some(2)), (c, Some(3))], &reordered)
+        );
+        assert_ne!(
+            base,
+            fingerprint(1, &[(b, Some(2)), (c, Some(3))], &search_paths[..1])
+        );
+    }
+}
@@ -0,0 +1,421 @@
+use crate::symbol_table::SymbolInfo;
+use std::collections::{BTreeMap, HashMap};
+use std::ops::Bound;
+use std::sync::Arc;
+
+/// Up to three bytes of a lowercased name, padded with zeros, which names
+/// never contain.
+type Gram = [u8; 3];
+
+/// An index of the names of the symbols of [`SymbolIndex::global`], kept up to
+/// date with it, so that a search only looks at the symbols that can match
+/// instead of at every symbol.
+///
+/// [`SymbolIndex::global`]: crate::analysis::symbol_index::SymbolIndex::global
+#[derive(Debug, Clone, Default)]
+pub struct SearchIndex {
+    /// The id of each symbol, by its key in `global`.
+    ids: HashMap<String, u32>,
+    /// The symbol of each id, or `None` if the id is free. Shared, so that a
+    /// copy of the index doesn't copy every name.
+    symbols: Vec<Option<Arc<IndexedSymbol>>>,
+    free: Vec<u32>,
+    /// The ids of the symbols whose lowercased name contains each gram, sorted.
+    grams: HashMap<Gram, Vec<u32>>,
+    /// The ids of the symbols with each name, sorted.
+    names: BTreeMap<String, Vec<u32>>,
+    namespaces: NamespaceNode,
+}
+
+#[derive(Debug, Clone)]
+struct IndexedSymbol {
+    key: String,
+    name: String,
+    lowercase_name: String,
+    namespace: Vec<String>,
+}
+
+/// A namespace, and the namespaces in it.
+#[derive(Debug, Clone, Default)]
+struct NamespaceNode {
+    children: BTreeMap<String, NamespaceNode>,
+    /// The ids of the symbols directly in this namespace, sorted.
+    symbols: Vec<u32>,
+}
+
+// Ids depend on the order the symbols were indexed in, and everything else
+// follows from which symbols are indexed.
+impl PartialEq for SearchIndex {
+    fn eq(&self, other: &Self) -> bool {
+        self.ids.len() == other.ids.len() && self.ids.keys().all(|key| other.ids.contains_key(key))
+    }
+}
+
+impl SearchIndex {
+    /// Index the symbol with `info` as `key`, in place of what was indexed as
+    /// `key` before.
+    pub fn insert(&mut self, key: &str, info: &SymbolInfo) {
+        self.remove(key);
+        let id = self.free.pop().unwrap_or_else(|| {
+            self.symbols.push(None);
+            u32::try_from(self.symbols.len() - 1).unwrap_or(u32::MAX)
+        });
+        let lowercase_name = info.name.to_ascii_lowercase();
+        for gram in distinct_grams(lowercase_name.as_bytes()) {
+            insert_sorted(self.grams.entry(gram).or_default(), id);
+        }
+        insert_sorted(self.names.entry(info.name.clone()).or_default(), id);
+        self.namespaces.insert(&info.namespace, id);
+        self.ids.insert(key.to_string(), id);
+        self.symbols[id as usize] = Some(Arc::new(IndexedSymbol {
+            key: key.to_string(),
+            name: info.name.clone(),
+            lowercase_name,
+            namespace: info.namespace.clone(),
+        }));
+    }
+
+    pub fn remove(&mut self, key: &str) {
+        let Some(id) = self.ids.remove(key) else {
+            return;
+        };
+        let Some(symbol) = self.symbols[id as usize].take() else {
+            return;
+        };
+        for gram in distinct_grams(symbol.lowercase_name.as_bytes()) {
+            if let Some(ids) = self.grams.get_mut(&gram) {
+                if remove_sorted(ids, id) {
+                    self.grams.remove(&gram);
+                }
+            }
+        }
+        if let Some(ids) = self.names.get_mut(&symbol.name) {
+            if remove_sorted(ids, id) {
+                self.names.remove(&symbol.name);
+            }
+        }
+        self.namespaces.remove(&symbol.namespace, id);
+        self.free.push(id);
+    }
+
+    /// The keys of the symbols whose name contains `text`, ignoring case.
+    #[must_use]
+    pub fn containing(&self, text: &str) -> Vec<&str> {
+        let text = text.to_lowercase();
+        let bytes = text.as_bytes();
+        if bytes.is_empty() {
+            return self.ids.keys().map(String::as_str).collect();
+        }
+        // Names that have a gram of up to three bytes are exactly those listed for it.
+        if bytes.len() <= 3 {
+            return self.keys(self.grams.get(&gram(bytes)).into_iter().flatten().copied());
+        }
+        let candidates = self.with_grams(bytes.windows(3).map(gram));
+        self.keys(candidates.into_iter().filter(|&id| {
+            self.symbol(id)
+                .is_some_and(|symbol| symbol.lowercase_name.contains(text.as_str()))
+        }))
+    }
+
+    /// The keys of the symbols whose name has every one of `bytes`, which
+    /// should be lowercase.
+    #[must_use]
+    pub fn with_bytes(&self, bytes: &[u8]) -> Vec<&str> {
+        let ids = self.with_grams(bytes.iter().map(|&byte| gram(&[byte])));
+        self.keys(ids)
+    }
+
+    /// The keys of every symbol, ordered by name.
+    pub fn by_name(&self) -> impl Iterator<Item = &str> {
+        self.names
+            .values()
+            .flatten()
+            .filter_map(|&id| self.symbol(id))
+            .map(|symbol| symbol.key.as_str())
+    }
+
+    /// How many symbols are named `name`.
+    #[must_use]
+    pub fn count_named(&self, name: &str) -> usize {
+        self.names.get(name).map_or(0, Vec::len)
+    }
+
+    /// Every namespace that a symbol is directly in, dotted.
+    #[must_use]
+    pub fn namespaces(&self) -> Vec<String> {
+        let mut namespaces = Vec::new();
+        self.namespaces.visit(&mut String::new(), &mut |name, ids| {
+            if !name.is_empty() && !ids.is_empty() {
+                namespaces.push(name.to_string());
+            }
+        });
+        namespaces
+    }
+
+    /// The keys of the symbols whose dotted namespace starts with `prefix`.
+    #[must_use]
+    pub fn in_namespaces_starting_with(&self, prefix: &str) -> Vec<&str> {
+        let mut ids = Vec::new();
+        let mut collect = |_: &str, symbols: &[u32]| ids.extend_from_slice(symbols);
+        if prefix.is_empty() {
+            self.namespaces.visit(&mut String::new(), &mut collect);
+            return self.keys(ids);
+        }
+        let mut parts = prefix.split('.');
+        let last = parts.next_back().unwrap_or_default();
+        let mut node = &self.namespaces;
+        let mut name = String::new();
+        for part in parts {
+            let Some(child) = node.children.get(part) else {
+                return Vec::new();
+            };
+            node = child;
+            push_part(&mut name, part);
+        }
+        for (part, child) in node.children_starting_with(last) {
+            let mut name = name.clone();
+            push_part(&mut name, part);
+            child.visit(&mut name, &mut collect);
+        }
+        self.keys(ids)
+    }
+
+    /// The keys of the symbols with a part of their namespace that starts with
+    /// `prefix`.
+    #[must_use]
+    pub fn in_namespaces_with_part_starting_with(&self, prefix: &str) -> Vec<&str> {
+        let mut ids = Vec::new();
+        self.namespaces.visit_parts_starting_with(prefix, &mut ids);
+        self.keys(ids)
+    }
+
+    fn symbol(&self, id: u32) -> Option<&IndexedSymbol> {
+        self.symbols.get(id as usize)?.as_deref()
+    }
+
+    fn keys(&self, ids: impl IntoIterator<Item = u32>) -> Vec<&str> {
+        ids.into_iter()
+            .filter_map(|id| self.symbol(id))
+            .map(|symbol| symbol.key.as_str())
+            .collect()
+    }
+
+    /// The ids of the symbols whose lowercased name contains every one of
+    /// `grams`, found from the shortest list of ids.
+    fn with_grams(&self, grams: impl Iterator<Item = Gram>) -> Vec<u32> {
+        let mut lists = Vec::new();
+        for gram in grams {
+            let Some(ids) = self.grams.get(&gram) else {
+                return Vec::new();
+            };
+            lists.push(ids.as_slice());
+        }
+        lists.sort_unstable_by_key(|ids| ids.len());
+        let Some((shortest, rest)) = lists.split_first() else {
+            return self.ids.values().copied().collect();
+        };
+        shortest
+            .iter()
+            .copied()
+            .filter(|id| rest.iter().all(|ids| ids.binary_search(id).is_ok()))
+            .collect()
+    }
+}
+
+impl NamespaceNode {
+    fn insert(&mut self, namespace: &[String], id: u32) {
+        let node = namespace.iter().fold(self, |node, part| {
+            node.children.entry(part.clone()).or_default()
+        });
+        insert_sorted(&mut node.symbols, id);
+    }
+
+    /// Returns whether the namespace is now empty.
+    fn remove(&mut self, namespace: &[String], id: u32) -> bool {
+        match namespace.split_first() {
+            None => {
+                remove_sorted(&mut self.symbols, id);
+            }
+            Some((part, rest)) => {
+                if let Some(child) = self.children.get_mut(part) {
+                    if child.remove(rest, id) {
+                        self.children.remove(part);
+                    }
+                }
+            }
+        }
+        self.symbols.is_empty() && self.children.is_empty()
+    }
+
+    fn children_starting_with<'a>(
+        &'a self,
+        prefix: &'a str,
+    ) -> impl Iterator<Item = (&'a String, &'a NamespaceNode)> {
+        self.children
+            .range::<str, _>((Bound::Included(prefix), Bound::Unbounded))
+            .take_while(move |(part, _)| part.starts_with(prefix))
+    }
+
+    /// Calls `f` with the dotted name and the symbols of this namespace and of
+    /// every namespace in it. `name` is this namespace's.
+    fn visit(&self, name: &mut String, f: &mut impl FnMut(&str, &[u32])) {
+        f(name, &self.symbols);
+        for (part, child) in &self.children {
+            let len = name.len();
+            push_part(name, part);
+            child.visit(name, f);
+            name.truncate(len);
+        }
+    }
+
+    /// Adds the symbols of every namespace in this one that has a part
+    /// starting with `prefix` to `ids`.
+    fn visit_parts_starting_with(&self, prefix: &str, ids: &mut Vec<u32>) {
+        for (part, child) in &self.children {
+            if part.starts_with(prefix) {
+                child.visit(&mut String::new(), &mut |_, symbols| {
+                    ids.extend_from_slice(symbols);
+                });
+            } else {
+                child.visit_parts_starting_with(prefix, ids);
+            }
+        }
+    }
+}
+
+fn push_part(name: &mut String, part: &str) {
+    if !name.is_empty() {
+        name.push('.');
+    }
+    name.push_str(part);
+}
+
+fn gram(bytes: &[u8]) -> Gram {
+    let mut gram = [0; 3];
+    gram[..bytes.len()].copy_from_slice(bytes);
+    gram
+}
+
+/// Every substring of `text` of one to three bytes, once each.
+fn distinct_grams(text: &[u8]) -> Vec<Gram> {
+    let mut grams: Vec<Gram> = (1..=3)
+        .flat_map(|len| text.windows(len).map(gram))
+        .collect();
+    grams.sort_unstable();
+    grams.dedup();
+    grams
+}
+
+fn insert_sorted(ids: &mut Vec<u32>, id: u32) {
+    if let Err(index) = ids.binary_search(&id) {
+        ids.insert(index, id);
+    }
+}
+
+/// Returns whether `ids` is now empty.
+fn remove_sorted(ids: &mut Vec<u32>, id: u32) -> bool {
+    if let Ok(index) = ids.binary_search(&id) {
+        ids.remove(index);
+    }
+    ids.is_empty()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::symbol_table::Location;
+    use std::path::PathBuf;
+    use tower_lsp_server::lsp_types::Range;
+
+    fn info(qualified_name: &str) -> SymbolInfo {
+        let mut namespace: Vec<String> = qualified_name.split('.').map(String::from).collect();
+        let name = namespace.pop().unwrap_or_default();
+        SymbolInfo {
+            name,
+            namespace,
+            location: Location {
+                path: PathBuf::from("a.fbs"),
+                range: Range::default(),
+            },
+            documentation: None,
+            builtin: false,
+        }
+    }
+
+    fn index(qualified_names: &[&str]) -> SearchIndex {
+        let mut index = SearchIndex::default();
+        for name in qualified_names {
+            index.insert(name, &info(name));
+        }
+        index
+    }
+
+    fn sorted(mut keys: Vec<&str>) -> Vec<&str> {
+        keys.sort_unstable();
+        keys
+    }
+
+    #[test]
+    fn test_containing() {
+        let index = index(&["Monster", "game.Weapon", "game.items.Sword", "Mon"]);
+        assert_eq!(sorted(index.containing("mon")), ["Mon", "Monster"]);
+        assert_eq!(sorted(index.containing("STER")), ["Monster"]);
+        assert_eq!(
+            sorted(index.containing("o")),
+            ["Mon", "Monster", "game.Weapon", "game.items.Sword"]
+        );
+        assert_eq!(index.containing("").len(), 4);
+        assert!(index.containing("weapons").is_empty());
+        assert_eq!(sorted(index.with_bytes(b"wd")), ["game.items.Sword"]);
+    }
+
+    #[test]
+    fn test_insert_and_remove() {
+        let mut index = index(&["a.Monster", "b.Monster", "Weapon"]);
+        assert_eq!(index.count_named("Monster"), 2);
+        assert_eq!(index.by_name().collect::<Vec<_>>().last(), Some(&"Weapon"));
+
+        index.remove("a.Monster");
+        index.insert("Weapon", &info("Weapon"));
+        assert_eq!(index.count_named("Monster"), 1);
+        assert_eq!(sorted(index.containing("on")), ["Weapon", "b.Monster"]);
+        assert_eq!(index.namespaces(), ["b"]);
+
+        index.remove("b.Monster");
+        index.remove("Weapon");
+        assert_eq!(index, SearchIndex::default());
+        assert!(index.grams.is_empty());
+        assert!(index.namespaces.children.is_empty());
+    }
+
+    #[test]
+    fn test_namespaces() {
+        let index = index(&["com.foo.A", "com.foo.bar.B", "com.fizz.C", "cool.D", "E"]);
+        assert_eq!(
+            index.namespaces(),
+            ["com.fizz", "com.foo", "com.foo.bar", "cool"]
+        );
+        assert_eq!(index.in_namespaces_starting_with("").len(), 5);
+        assert_eq!(
+            sorted(index.in_namespaces_starting_with("co")),
+            ["com.fizz.C", "com.foo.A", "com.foo.bar.B", "cool.D"]
+        );
+        assert_eq!(
+            sorted(index.in_namespaces_starting_with("com.fo")),
+            ["com.foo.A", "com.foo.bar.B"]
+        );
+        assert_eq!(
+            index.in_namespaces_starting_with("com.foo."),
+            ["com.foo.bar.B"]
+        );
+        assert!(index.in_namespaces_starting_with("com.x").is_empty());
+        assert_eq!(
+            sorted(index.in_namespaces_with_part_starting_with("f")),
+            ["com.fizz.C", "com.foo.A", "com.foo.bar.B"]
+        );
+        assert_eq!(
+            index.in_namespaces_with_part_starting_with("ba"),
+            ["com.foo.bar.B"]
+        );
+    }
+}
@@ -1,23 +1,28 @@
 use crate::analysis::workspace_index::WorkspaceIndex;
 use crate::ext::range::RangeExt;
-use crate::symbol_table::{self, Field, RpcService, Symbol, SymbolKind, Union};
+use crate::symbol_table::{self, Documentation, Field, RpcService, Symbol, SymbolKind, Union};
 use crate::utils::paths::uri_to_path_buf;
 use dashmap::DashMap;
 use ropey::Rope;
+use std::collections::HashMap;
+use std::fs;
 use std::ops::Deref;
-use std::path::PathBuf;
+use std::path::{Path, PathBuf};
 use std::sync::Arc;
-use tokio::sync::RwLockReadGuard;
 use tower_lsp_server::lsp_types::{Position, Range, Uri};
 
 // --- Snapshot Definition ---
 
-pub struct WorkspaceSnapshot<'a> {
-    pub index: RwLockReadGuard<'a, WorkspaceIndex>,
-    pub documents: Arc<DashMap<PathBuf, Rope>>,
+/// The index and documents as of one moment, which stay as they were however
+/// long a request holds on to them.
+pub struct WorkspaceSnapshot {
+    pub index: Arc<WorkspaceIndex>,
+    pub documents: Arc<HashMap<PathBuf, Rope>>,
+    /// Files that aren't in `documents`, as read from disk during this request.
+    pub(crate) read_sources: DashMap<PathBuf, Option<Rope>>,
 }
 
-impl Deref for WorkspaceSnapshot<'_> {
+impl Deref for WorkspaceSnapshot {
     type Target = WorkspaceIndex;
 
     fn deref(&self) -> &Self::Target {
@@ -38,12 +43,8 @@ pub struct ResolvedSymbol<'a> {
     pub ref_name: String,
 }
 
-impl<'a> WorkspaceSnapshot<'a> {
-    pub fn resolve_symbol_at(
-        &'a self,
-        uri: &Uri,
-        position: Position,
-    ) -> Option<ResolvedSymbol<'a>> {
+impl WorkspaceSnapshot {
+    pub fn resolve_symbol_at(&self, uri: &Uri, position: Position) -> Option<ResolvedSymbol<'_>> {
         // Check if the cursor is on a root_type declaration
         let Ok(path) = uri_to_path_buf(uri) else {
             return None;
@@ -66,11 +67,7 @@ impl<'a> WorkspaceSnapshot<'a> {
             }
         }
 
-        let symbol_at_cursor = self
-            .symbols
-            .global
-            .values()
-            .find_map(|symbol| symbol.find_symbol(&path, position))?;
+        let symbol_at_cursor = self.symbols.symbol_at(&path, position)?;
 
         // Handle the symbol itself.
         let range = symbol_at_cursor.info.location.range;
@@ -107,39 +104,45 @@ impl<'a> WorkspaceSnapshot<'a> {
 
     #[must_use]
     pub fn find_enclosing_table(&self, path: &PathBuf, position: Position) -> Option<&Symbol> {
-        let mut symbols_before_cursor: Vec<_> = self
-            .symbols
-            .global
-            .values()
-            .filter(|symbol| {
-                if &symbol.info.location.path != path {
-                    return false;
-                }
-                if symbol.info.location.range.start < position {
-                    return true;
-                }
-                false
-            })
-            .collect();
+        let declaration = self.symbols.spans.get(path)?.declaration_before(position)?;
+        let symbol: &Symbol = self.symbols.global.get(&declaration.key)?;
+        matches!(symbol.kind, SymbolKind::Table(_)).then_some(symbol)
+    }
 
-        symbols_before_cursor.sort_by_key(|s| s.info.location.range.start);
+    /// The contents of `path`, from the document store if it is there, and
+    /// otherwise from disk.
+    pub fn source(&self, path: &Path) -> Option<Rope> {
+        if let Some(doc) = self.documents.get(path) {
+            return Some(doc.clone());
+        }
+        self.read_sources
+            .entry(path.to_path_buf())
+            .or_insert_with(|| {
+                fs::read_to_string(path)
+                    .ok()
+                    .map(|text| Rope::from_str(&text))
+            })
+            .clone()
+    }
 
-        if let Some(last_symbol) = symbols_before_cursor.last() {
-            if let SymbolKind::Table(_) = &last_symbol.kind {
-                return Some(last_symbol);
+    /// The text of `symbol`'s documentation, read from the file that defines it
+    /// if need be.
+    pub fn documentation(&self, symbol: &Symbol) -> Option<String> {
+        match symbol.info.documentation.as_ref()? {
+            doc @ Documentation::Text(_) => doc.text(None),
+            doc @ Documentation::Comment(_) => {
+                doc.text(self.source(&symbol.info.location.path).as_ref())
             }
         }
-
-        None
     }
 }
 
-impl<'a> WorkspaceSnapshot<'a> {
+impl WorkspaceSnapshot {
     fn resolve_symbol_in_union(
-        &'a self,
+        &self,
         union: &Union,
         position: Position,
-    ) -> Option<ResolvedSymbol<'a>> {
+    ) -> Option<ResolvedSymbol<'_>> {
         for variant in &union.variants {
             if !variant.location.range.contains(position) {
                 continue;
@@ -166,10 +169,10 @@ impl<'a> WorkspaceSnapshot<'a> {
     }
 
     fn resolve_symbol_in_field(
-        &'a self,
+        &self,
         field: &Field,
         position: Position,
-    ) -> Option<ResolvedSymbol<'a>> {
+    ) -> Option<ResolvedSymbol<'_>> {
         if field.type_range.contains(position) {
             // Check if the cursor is on one of the namespace parts
             for part in &field.parsed_type.namespace {
@@ -201,10 +204,10 @@ impl<'a> WorkspaceSnapshot<'a> {
     }
 
     fn resolve_symbol_in_rpc_service(
-        &'a self,
+        &self,
         service: &RpcService,
         position: Position,
-    ) -> Option<ResolvedSymbol<'a>> {
+    ) -> Option<ResolvedSymbol<'_>> {
         for method in &service.methods {
             let Some(matching_type) = vec![&method.request_type, &method.response_type]
                 .into_iter()
@@ -425,6 +428,27 @@ mod tests {
         assert!(matches!(symbol.target.kind, SymbolKind::Table(_)));
     }
 
+    #[tokio::test]
+    async fn test_snapshot_is_unaffected_by_later_parses() {
+        let (analyzer, path, _dir) = setup_snapshot("table MyTable {}\n").await;
+        let snapshot = analyzer.snapshot().await;
+
+        // A held snapshot doesn't hold up the parse.
+        analyzer
+            .documents
+            .document_map
+            .insert(path.clone(), "table Renamed {}\n".into());
+        analyzer.parse(vec![path.clone()]).await;
+
+        assert!(snapshot.symbols.global.contains_key("MyTable"));
+        assert!(!snapshot.symbols.global.contains_key("Renamed"));
+        assert_eq!(snapshot.documents[&path].to_string(), "table MyTable {}\n");
+
+        let latest = analyzer.snapshot().await;
+        assert!(latest.symbols.global.contains_key("Renamed"));
+        assert!(!latest.symbols.global.contains_key("MyTable"));
+    }
+
     #[tokio::test]
     async fn test_find_enclosing_table_inside() {
         let schema = "table MyTable {\n  my_field: int;\n}\n";
@@ -1,8 +1,12 @@
-use crate::symbol_table::{Location, Symbol, SymbolInfo, SymbolKind, SymbolTable};
+use crate::analysis::search_index::SearchIndex;
+use crate::ext::range::RangeExt;
+use crate::symbol_table::{
+    Documentation, Location, SpanPart, Symbol, SymbolInfo, SymbolKind, SymbolTable,
+};
 use std::collections::{HashMap, HashSet};
 use std::path::{Path, PathBuf};
 use std::sync::Arc;
-use tower_lsp_server::lsp_types::Range;
+use tower_lsp_server::lsp_types::{Position, Range};
 
 #[derive(Debug, Clone, PartialEq)]
 pub struct Attribute {
@@ -11,13 +15,82 @@ pub struct Attribute {
     pub restricted_to_types: Option<Vec<String>>,
 }
 
+/// A range of a file where the cursor is on a symbol of [`SymbolIndex::global`].
+#[derive(Debug, Clone, PartialEq)]
+pub struct SymbolSpan {
+    pub range: Range,
+    /// The key of the symbol in [`SymbolIndex::global`].
+    pub key: String,
+    pub part: SpanPart,
+}
+
+/// The [`SymbolSpan`]s of one file, sorted by where they start.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct FileSpans {
+    spans: Vec<SymbolSpan>,
+    /// The furthest end of `spans[..=i]`, so that a lookup can stop going back
+    /// once no earlier span reaches the cursor.
+    max_end: Vec<Position>,
+}
+
+impl FileSpans {
+    /// The spans that contain `position`, latest start first.
+    pub fn containing(&self, position: Position) -> impl Iterator<Item = &SymbolSpan> {
+        let end = self
+            .spans
+            .partition_point(|span| span.range.start <= position);
+        (0..end)
+            .rev()
+            .take_while(move |&i| self.max_end[i] > position)
+            .map(|i| &self.spans[i])
+            .filter(move |span| span.range.contains(position))
+    }
+
+    /// The declaration that starts last before `position`.
+    #[must_use]
+    pub fn declaration_before(&self, position: Position) -> Option<&SymbolSpan> {
+        let end = self
+            .spans
+            .partition_point(|span| span.range.start < position);
+        self.spans[..end]
+            .iter()
+            .rev()
+            .find(|span| span.part == SpanPart::Declaration)
+    }
+
+    fn is_empty(&self) -> bool {
+        self.spans.is_empty()
+    }
+
+    fn update(&mut self, stale: Option<&HashSet<String>>, fresh: Vec<SymbolSpan>) {
+        if let Some(stale) = stale {
+            self.spans.retain(|span| !stale.contains(&span.key));
+        }
+        self.spans.extend(fresh);
+        self.spans.sort_by_key(|span| span.range.start);
+        self.max_end.clear();
+        let mut max_end = Position::default();
+        for span in &self.spans {
+            max_end = max_end.max(span.range.end);
+            self.max_end.push(max_end);
+        }
+    }
+}
+
 /// An index of known workspace symbols.
+///
+/// Copying it, as a merge does while a snapshot holds it, copies pointers to
+/// the symbols and to each file's keys and spans rather than the things
+/// themselves, which are replaced rather than changed.
 #[derive(Debug, Clone, Default, PartialEq)]
 pub struct SymbolIndex {
     /// Map from a fully-qualified name to its definition.
-    pub global: HashMap<String, Symbol>,
+    pub global: HashMap<String, Arc<Symbol>>,
     /// Map from a file path to the list of symbol keys defined in it.
-    pub per_file: HashMap<PathBuf, Vec<String>>,
+    pub per_file: HashMap<PathBuf, Arc<[String]>>,
+    /// Map from a file path to where the cursor is on each symbol of `global`
+    /// defined in it, including those of files that are only ever included.
+    pub spans: HashMap<PathBuf, Arc<FileSpans>>,
     /// Pre-populated, immutable map of built-in symbols.
     pub builtins: Arc<HashMap<String, Symbol>>,
     /// Pre-populated, immutable map of keywords.
@@ -28,6 +101,8 @@ pub struct SymbolIndex {
     pub user_defined_attributes: HashMap<String, Attribute>,
     /// Map from a file path to the list of user-defined attributes declared in it.
     pub user_defined_attributes_per_file: HashMap<PathBuf, Vec<String>>,
+    /// The names and namespaces of the symbols of `global`, to search.
+    pub search: SearchIndex,
 }
 
 impl SymbolIndex {
@@ -45,20 +120,18 @@ impl SymbolIndex {
         Self {
             global: HashMap::new(),
             per_file: HashMap::new(),
+            spans: HashMap::new(),
             builtins: Arc::new(builtins),
             keywords: Arc::new(keywords),
             builtin_attributes: Arc::new(builtin_attributes),
             user_defined_attributes: HashMap::new(),
             user_defined_attributes_per_file: HashMap::new(),
+            search: SearchIndex::default(),
         }
     }
 
     pub fn update_symbols(&mut self, path: &Path, st: SymbolTable) {
-        if let Some(old_symbol_keys) = self.per_file.remove(path) {
-            for key in old_symbol_keys {
-                self.global.remove(&key);
-            }
-        }
+        let mut stale = self.remove_symbols(path);
 
         let symbol_map = st.into_inner();
         let new_symbol_keys: Vec<String> = symbol_map
@@ -68,10 +141,80 @@ impl SymbolIndex {
             .cloned()
             .collect();
 
+        let mut fresh: HashMap<PathBuf, Vec<SymbolSpan>> = HashMap::new();
         for (key, symbol) in symbol_map {
-            self.global.insert(key, symbol);
+            fresh
+                .entry(symbol.info.location.path.clone())
+                .or_default()
+                .extend(
+                    symbol
+                        .cursor_spans()
+                        .into_iter()
+                        .map(|(range, part)| SymbolSpan {
+                            range,
+                            key: key.clone(),
+                            part,
+                        }),
+                );
+            self.search.insert(&key, &symbol.info);
+            if let Some(old_symbol) = self.global.insert(key.clone(), Arc::new(symbol)) {
+                stale
+                    .entry(old_symbol.info.location.path.clone())
+                    .or_default()
+                    .insert(key);
+            }
+        }
+        self.per_file
+            .insert(path.to_path_buf(), new_symbol_keys.into());
+        self.update_spans(&stale, fresh);
+    }
+
+    /// Removes the symbols defined in `path` from `global`, and returns their
+    /// keys by the file they were defined in.
+    fn remove_symbols(&mut self, path: &Path) -> HashMap<PathBuf, HashSet<String>> {
+        let mut removed: HashMap<PathBuf, HashSet<String>> = HashMap::new();
+        let Some(keys) = self.per_file.remove(path) else {
+            return removed;
+        };
+        for key in keys.iter() {
+            if let Some(symbol) = self.global.remove(key) {
+                self.search.remove(key);
+                removed
+                    .entry(symbol.info.location.path.clone())
+                    .or_default()
+                    .insert(key.clone());
+            }
+        }
+        removed
+    }
+
+    fn update_spans(
+        &mut self,
+        stale: &HashMap<PathBuf, HashSet<String>>,
+        mut fresh: HashMap<PathBuf, Vec<SymbolSpan>>,
+    ) {
+        let paths: HashSet<&PathBuf> = stale.keys().chain(fresh.keys()).collect();
+        for path in paths {
+            let spans = Arc::make_mut(self.spans.entry(path.clone()).or_default());
+            spans.update(stale.get(path), fresh.remove(path).unwrap_or_default());
+            if spans.is_empty() {
+                self.spans.remove(path);
+            }
+        }
+    }
+
+    /// The symbol that the cursor is on at `position` in `path`: a top-level
+    /// symbol, or the field whose type the cursor is on.
+    #[must_use]
+    pub fn symbol_at(&self, path: &Path, position: Position) -> Option<&Symbol> {
+        let span = self.spans.get(path)?.containing(position).next()?;
+        let symbol: &Symbol = self.global.get(&span.key)?;
+        match (span.part, &symbol.kind) {
+            (SpanPart::FieldType(i), SymbolKind::Table(t)) => t.fields.get(i),
+            (SpanPart::FieldType(i), SymbolKind::Struct(s)) => s.fields.get(i),
+            (SpanPart::FieldType(_), _) => None,
+            _ => Some(symbol),
         }
-        self.per_file.insert(path.to_path_buf(), new_symbol_keys);
     }
 
     pub fn update_attributes(&mut self, path: &Path, attributes: HashMap<String, String>) {
@@ -101,11 +244,8 @@ impl SymbolIndex {
     }
 
     pub fn remove(&mut self, path: &Path) {
-        if let Some(old_symbol_keys) = self.per_file.remove(path) {
-            for key in old_symbol_keys {
-                self.global.remove(&key);
-            }
-        }
+        let stale = self.remove_symbols(path);
+        self.update_spans(&stale, HashMap::new());
         if let Some(old_attr_keys) = self.user_defined_attributes_per_file.remove(path) {
             for key in old_attr_keys {
                 self.user_defined_attributes.remove(&key);
@@ -115,18 +255,41 @@ impl SymbolIndex {
 
     #[must_use]
     pub fn namespaces(&self) -> HashSet<String> {
-        self.global
-            .values()
-            .map(|s| &s.info.namespace)
-            .filter(|ns| !ns.is_empty())
-            .map(|ns| ns.join("."))
-            .collect()
+        self.search.namespaces().into_iter().collect()
+    }
+
+    /// Whether more than one symbol is named `name`, so that it has to be
+    /// qualified.
+    #[must_use]
+    pub fn is_ambiguous(&self, name: &str) -> bool {
+        self.search.count_named(name) > 1
+    }
+
+    /// The symbols that can complete `partial_text` as a type: those in a
+    /// namespace that starts with what is before its last `.`, or if it has
+    /// none, those whose name contains it or whose namespace has a part that
+    /// starts with it.
+    pub fn type_candidates(&self, partial_text: &str) -> impl Iterator<Item = &Symbol> {
+        let keys = if let Some((namespace, _)) = partial_text.rsplit_once('.') {
+            self.search.in_namespaces_starting_with(namespace)
+        } else {
+            let mut keys = self.search.containing(partial_text);
+            keys.extend(
+                self.search
+                    .in_namespaces_with_part_starting_with(partial_text),
+            );
+            keys.sort_unstable();
+            keys.dedup();
+            keys
+        };
+        keys.into_iter()
+            .filter_map(|key| self.global.get(key).map(Arc::as_ref))
     }
 
     /// Returns a map from unqualified name to symbols that share that name.
     #[must_use]
-    pub fn collisions(&self) -> HashMap<String, Vec<Symbol>> {
-        let mut by_name: HashMap<String, Vec<Symbol>> = HashMap::new();
+    pub fn collisions(&self) -> HashMap<String, Vec<Arc<Symbol>>> {
+        let mut by_name: HashMap<String, Vec<Arc<Symbol>>> = HashMap::new();
         for sym in self.global.values() {
             by_name
                 .entry(sym.info.name.clone())
@@ -177,7 +340,7 @@ fn populate_builtins(symbols: &mut HashMap<String, Symbol>) {
                     path: PathBuf::new(),
                     range: Range::default(),
                 },
-                documentation: Some(doc.to_string()),
+                documentation: Some(Documentation::Text(doc.to_string())),
                 builtin: true,
             },
             kind: SymbolKind::Scalar,
@@ -385,7 +548,8 @@ mod tests {
     use std::string::ToString;
 
     use super::*;
-    use crate::symbol_table::{Location, Symbol, SymbolInfo, SymbolKind, Table};
+    use crate::symbol_table::{Field, Location, Symbol, SymbolInfo, SymbolKind, Table};
+    use crate::utils::parsed_type::parse_type;
     use tower_lsp_server::lsp_types::{Position, Range};
 
     fn make_symbol(name: &str, path: &Path) -> Symbol {
@@ -429,6 +593,77 @@ mod tests {
         assert!(index.per_file.get(&path_a).unwrap().is_empty());
     }
 
+    fn range(line: u32, start: u32, end: u32) -> Range {
+        Range::new(Position::new(line, start), Position::new(line, end))
+    }
+
+    /// `table <name> { f: <field_type>; }` on `line`.
+    fn make_table(name: &str, path: &Path, line: u32, field_type: &str) -> Symbol {
+        let mut table = make_symbol(name, path);
+        table.info.location.range = range(line, 6, 6 + 3);
+        let type_range = range(line, 14, 14 + 3);
+        let mut field = make_symbol("f", path);
+        field.kind = SymbolKind::Field(Field {
+            type_name: field_type.to_string(),
+            type_display_name: field_type.to_string(),
+            type_range,
+            parsed_type: parse_type(field_type, type_range).unwrap(),
+            deprecated: false,
+            id: None,
+        });
+        table.kind = SymbolKind::Table(Table {
+            fields: vec![field],
+        });
+        table
+    }
+
+    fn at(index: &SymbolIndex, path: &Path, line: u32, col: u32) -> Option<String> {
+        index
+            .symbol_at(path, Position::new(line, col))
+            .map(|symbol| symbol.info.name.clone())
+    }
+
+    #[test]
+    fn test_symbol_at() {
+        let mut index = SymbolIndex::new();
+        let path_a = PathBuf::from("a.fbs");
+        let path_b = PathBuf::from("b.fbs");
+
+        let mut st = SymbolTable::new(path_a.clone());
+        st.insert("Abc".to_string(), make_table("Abc", &path_a, 0, "Def"));
+        st.insert("Def".to_string(), make_table("Def", &path_a, 1, "int"));
+        st.insert("Ghi".to_string(), make_table("Ghi", &path_b, 0, "Abc"));
+        index.update_symbols(&path_a, st);
+
+        assert_eq!(at(&index, &path_a, 0, 7), Some("Abc".to_string()));
+        assert_eq!(at(&index, &path_a, 0, 15), Some("f".to_string()));
+        assert_eq!(at(&index, &path_a, 1, 6), Some("Def".to_string()));
+        assert_eq!(at(&index, &path_a, 1, 9), None);
+        // Symbols of included files are found in the file that defines them.
+        assert_eq!(at(&index, &path_b, 0, 6), Some("Ghi".to_string()));
+
+        let spans = &index.spans[&path_a];
+        let before = |line, col| {
+            spans
+                .declaration_before(Position::new(line, col))
+                .map(|span| span.key.clone())
+        };
+        assert_eq!(before(0, 6), None);
+        assert_eq!(before(0, 20), Some("Abc".to_string()));
+        assert_eq!(before(2, 0), Some("Def".to_string()));
+
+        // Replacing a parse drops the spans of symbols that went away.
+        let mut st = SymbolTable::new(path_a.clone());
+        st.insert("Def".to_string(), make_table("Def", &path_a, 1, "int"));
+        index.update_symbols(&path_a, st);
+        assert_eq!(at(&index, &path_a, 0, 7), None);
+        assert_eq!(at(&index, &path_a, 1, 6), Some("Def".to_string()));
+        assert_eq!(at(&index, &path_b, 0, 6), Some("Ghi".to_string()));
+
+        index.remove(&path_a);
+        assert!(!index.spans.contains_key(&path_a));
+    }
+
     #[test]
     fn test_update_attributes() {
         let mut index = SymbolIndex::new();
@@ -532,6 +767,46 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_type_candidates() {
+        fn set(names: &[&str]) -> HashSet<String> {
+            names.iter().map(ToString::to_string).collect()
+        }
+
+        let mut index = SymbolIndex::new();
+        let path_a = PathBuf::from("a.fbs");
+
+        let mut st = SymbolTable::new(path_a.clone());
+        for sym in [
+            make_symbol("com.foo.Widget", &path_a),
+            make_symbol("com.bar.Widget", &path_a),
+            make_symbol("com.foo.Gadget", &path_a),
+            make_symbol("Free", &path_a),
+        ] {
+            st.insert(sym.info.qualified_name(), sym);
+        }
+        index.update_symbols(&path_a, st);
+
+        let candidates = |partial_text| {
+            index
+                .type_candidates(partial_text)
+                .map(|symbol| symbol.info.qualified_name())
+                .collect::<HashSet<String>>()
+        };
+        assert_eq!(
+            candidates("dge"),
+            set(&["com.foo.Widget", "com.bar.Widget", "com.foo.Gadget"])
+        );
+        assert_eq!(candidates("fo"), set(&["com.foo.Widget", "com.foo.Gadget"]));
+        assert_eq!(
+            candidates("com.f"),
+            set(&["com.foo.Widget", "com.foo.Gadget"])
+        );
+        assert_eq!(candidates("").len(), 4);
+        assert!(index.is_ambiguous("Widget"));
+        assert!(!index.is_ambiguous("Gadget"));
+    }
+
     #[test]
     fn test_collisions() {
         let mut index = SymbolIndex::new();
@@ -1,26 +1,43 @@
 use crate::analysis::diagnostic_store::DiagnosticStore;
+use crate::analysis::occurrence_index::OccurrenceIndex;
 use crate::analysis::root_type_store::RootTypeStore;
 use crate::analysis::symbol_index::SymbolIndex;
 use crate::{analysis::dependency_graph::DependencyGraph, parser::ParseResult};
+use std::collections::HashMap;
 use std::path::{Path, PathBuf};
+use std::sync::Arc;
 
 /// An index of workspace semantic information.
+///
+/// The analyzer shares it with snapshots and copies it to change it while one
+/// is held, so what is costly to copy is kept behind an `Arc`: the symbols as a
+/// whole, which are only copied when a parse changes them and then share each
+/// symbol and each file's spans, and the per-file results, which are replaced
+/// rather than changed.
 #[derive(Debug, Clone, Default)]
 pub struct WorkspaceIndex {
-    pub symbols: SymbolIndex,
+    pub symbols: Arc<SymbolIndex>,
     pub dependencies: DependencyGraph,
     pub diagnostics: DiagnosticStore,
     pub root_types: RootTypeStore,
+    pub occurrences: OccurrenceIndex,
+    /// The semantic tokens of each file, see [`ParseResult::semantic_tokens`].
+    pub semantic_tokens: HashMap<PathBuf, Arc<[u32]>>,
+    /// What each file's last parse read, see [`crate::analysis::reparse::fingerprint`].
+    pub fingerprints: HashMap<PathBuf, u64>,
 }
 
 impl WorkspaceIndex {
     #[must_use]
     pub fn new() -> Self {
         Self {
-            symbols: SymbolIndex::new(),
+            symbols: Arc::new(SymbolIndex::new()),
             dependencies: DependencyGraph::default(),
             diagnostics: DiagnosticStore::default(),
             root_types: RootTypeStore::default(),
+            occurrences: OccurrenceIndex::default(),
+            semantic_tokens: HashMap::new(),
+            fingerprints: HashMap::new(),
         }
     }
 
@@ -34,9 +51,12 @@ impl WorkspaceIndex {
                 None => self.root_types.root_types.remove(path),
             };
 
-            self.symbols.update_symbols(path, st);
-            self.symbols
-                .update_attributes(path, result.user_defined_attributes);
+            let symbols = Arc::make_mut(&mut self.symbols);
+            symbols.update_symbols(path, st);
+            symbols.update_attributes(path, result.user_defined_attributes);
+            self.occurrences.update(path, result.occurrences);
+            self.semantic_tokens
+                .insert(path.to_path_buf(), result.semantic_tokens.into());
         }
 
         self.dependencies.update(path, result.includes.clone());
@@ -49,9 +69,12 @@ impl WorkspaceIndex {
     }
 
     pub fn remove(&mut self, path: &PathBuf) -> Vec<PathBuf> {
-        self.symbols.remove(path);
+        Arc::make_mut(&mut self.symbols).remove(path);
         self.root_types.root_types.remove(path);
+        self.occurrences.remove(path);
+        self.semantic_tokens.remove(path);
         self.diagnostics.remove(path);
+        self.fingerprints.remove(path);
 
         // Return the affected files.
         self.dependencies.remove(path)
@@ -18,10 +18,13 @@
 #define FLATBUFFERS_IDL_H_
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
 #include <stack>
+#include <string_view>
 #include <vector>
 
 #include "flatbuffers/base.h"
@@ -187,6 +190,7 @@ inline const char* StringOf(const BaseType t) {
 
 struct StructDef;
 struct EnumDef;
+struct DefinitionRemap;
 class Parser;
 
 /// @struct SourcePosition
@@ -248,7 +252,9 @@ struct Type {
                           // or for an integral type derived from an enum.
   uint16_t fixed_length;  // only set if t == BASE_TYPE_ARRAY
   SourceRange decl_range; // source range that this declaration spans
-  std::string decl_text;  // text of this declaration
+  // Text of this declaration, viewing the source retained by the Parser (see
+  // Parser::RetainSource).
+  std::string_view decl_text;
 };
 
 // Represents a parsed scalar value, it's type, and field offset.
@@ -259,21 +265,59 @@ struct Value {
   Type type;
   std::string constant;
   voffset_t offset;
+  SourceRange decl_range;  // of the constant's text, for attribute values
+};
+
+// Hashes a qualified name one component at a time, so that a name can be
+// looked up by its components without concatenating them first. Hashing
+// "a", then a separator, then "b" gives the same value as hashing "a.b".
+struct QualifiedNameHash {
+  QualifiedNameHash() : value(FnvTraits<uint64_t>::kOffsetBasis) {}
+
+  QualifiedNameHash &Add(const std::string &part) {
+    for (size_t i = 0; i < part.size(); i++) Add(part[i]);
+    return *this;
+  }
+
+  QualifiedNameHash &Add(char c) {
+    value ^= static_cast<unsigned char>(c);
+    value *= FnvTraits<uint64_t>::kFnvPrime;
+    return *this;
+  }
+
+  uint64_t value;
 };
 
 // Helper class that retains the original order of a set of identifiers and
 // also provides quick lookup.
 template<typename T> class SymbolTable {
  public:
+  SymbolTable() : index_count_(0) {}
+
   ~SymbolTable() {
     for (auto it = vec.begin(); it != vec.end(); ++it) { delete *it; }
   }
 
+  // A copy shares the elements of the original; see Release().
+  SymbolTable(const SymbolTable &other)
+      : dict(other.dict), vec(other.vec), index_count_(0) {
+    if (dict.size() >= kIndexThreshold) Reindex();
+  }
+
+  SymbolTable &operator=(const SymbolTable &other) {
+    dict = other.dict;
+    vec = other.vec;
+    index_.clear();
+    index_count_ = 0;
+    if (dict.size() >= kIndexThreshold) Reindex();
+    return *this;
+  }
+
   bool Add(const std::string &name, T *e) {
     vec.emplace_back(e);
-    auto it = dict.find(name);
-    if (it != dict.end()) return true;
-    dict[name] = e;
+    auto inserted = dict.insert(std::make_pair(name, e));
+    if (!inserted.second) return true;
+    Index(inserted.first->first, e);
     return false;
   }
 
@@ -281,21 +325,176 @@ template<typename T> class SymbolTable {
     auto it = dict.find(oldname);
     if (it != dict.end()) {
       auto obj = it->second;
+      Unindex(it->first);
       dict.erase(it);
-      dict[newname] = obj;
+      auto &entry = *dict.insert(std::make_pair(newname, obj)).first;
+      entry.second = obj;
+      Index(entry.first, obj);
     } else {
       FLATBUFFERS_ASSERT(false);
     }
   }
 
-  T *Lookup(const std::string &name) const {
+  // Removes name without deleting its element, which stays in vec.
+  void Erase(const std::string &name) {
     auto it = dict.find(name);
-    return it == dict.end() ? nullptr : it->second;
+    if (it == dict.end()) return;
+    Unindex(it->first);
+    dict.erase(it);
+  }
+
+  // Deletes every element, keeping the memory of vec and the index.
+  void Clear() {
+    for (auto it = vec.begin(); it != vec.end(); ++it) { delete *it; }
+    dict.clear();
+    vec.clear();
+    for (auto it = index_.begin(); it != index_.end(); ++it) it->key = nullptr;
+    index_count_ = 0;
+  }
+
+  // Forgets every element without deleting it, for tables that borrowed them.
+  void Release() {
+    dict.clear();
+    vec.clear();
+    index_.clear();
+    index_count_ = 0;
+  }
+
+  T *Lookup(const std::string &name) const {
+    if (index_.empty()) {
+      auto it = dict.find(name);
+      return it == dict.end() ? nullptr : it->second;
+    }
+    const uint64_t hash = QualifiedNameHash().Add(name).value;
+    const size_t mask = index_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const auto &slot = index_[i];
+      if (!slot.key) return nullptr;
+      if (slot.hash == hash && *slot.key == name) return slot.value;
+    }
+  }
+
+  // Looks up the name qualified by the first count components of a
+  // namespace, e.g. "a.b.name", without building that string.
+  T *Lookup(const std::vector<std::string> &components, size_t count,
+            const std::string &name) const {
+    if (index_.empty()) {
+      std::string qualified_name;
+      for (size_t i = 0; i < count; i++) {
+        qualified_name += components[i];
+        qualified_name += '.';
+      }
+      qualified_name += name;
+      return Lookup(qualified_name);
+    }
+    QualifiedNameHash hasher;
+    for (size_t i = 0; i < count; i++) hasher.Add(components[i]).Add('.');
+    const uint64_t hash = hasher.Add(name).value;
+    const size_t mask = index_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const auto &slot = index_[i];
+      if (!slot.key) return nullptr;
+      if (slot.hash == hash && KeyMatches(*slot.key, components, count, name))
+        return slot.value;
+    }
   }
 
  public:
   std::map<std::string, T *> dict;  // quick lookup
   std::vector<T *> vec;             // Used to iterate in order of insertion
+
+ private:
+  // Small tables are looked up in dict; bigger ones get an open-addressing
+  // index over the keys of dict, kept at most half full.
+  static const size_t kIndexThreshold = 16;
+
+  struct IndexSlot {
+    uint64_t hash;
+    const std::string *key;  // into dict, null if the slot is empty
+    T *value;
+  };
+
+  static bool KeyMatches(const std::string &key,
+                         const std::vector<std::string> &components,
+                         size_t count, const std::string &name) {
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++) {
+      const auto &component = components[i];
+      if (key.compare(pos, component.size(), component) != 0) return false;
+      pos += component.size();
+      if (pos == key.size() || key[pos] != '.') return false;
+      pos++;
+    }
+    return key.size() - pos == name.size() &&
+           key.compare(pos, name.size(), name) == 0;
+  }
+
+  void Index(const std::string &key, T *value) {
+    if (index_.empty()) {
+      if (dict.size() >= kIndexThreshold) Reindex();
+      return;
+    }
+    const uint64_t hash = QualifiedNameHash().Add(key).value;
+    const size_t mask = index_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      auto &slot = index_[i];
+      if (!slot.key) {
+        if ((index_count_ + 1) * 2 > index_.size()) {
+          Reindex();
+        } else {
+          slot.hash = hash;
+          slot.key = &key;
+          slot.value = value;
+          index_count_++;
+        }
+        return;
+      }
+      if (slot.key == &key) {
+        slot.value = value;
+        return;
+      }
+    }
+  }
+
+  void Unindex(const std::string &key) {
+    if (index_.empty()) return;
+    const size_t mask = index_.size() - 1;
+    size_t i = QualifiedNameHash().Add(key).value & mask;
+    while (index_[i].key != &key) {
+      if (!index_[i].key) return;
+      i = (i + 1) & mask;
+    }
+    // Shift later slots of the probe sequence back into the hole.
+    for (size_t j = (i + 1) & mask; index_[j].key; j = (j + 1) & mask) {
+      const size_t home = index_[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        index_[i] = index_[j];
+        i = j;
+      }
+    }
+    index_[i].key = nullptr;
+    index_count_--;
+  }
+
+  void Reindex() {
+    size_t capacity = 64;
+    while (capacity < dict.size() * 4) capacity *= 2;
+    IndexSlot empty = { 0, nullptr, nullptr };
+    index_.assign(capacity, empty);
+    index_count_ = 0;
+    for (auto it = dict.begin(); it != dict.end(); ++it) {
+      const uint64_t hash = QualifiedNameHash().Add(it->first).value;
+      size_t i = hash & (capacity - 1);
+      while (index_[i].key) i = (i + 1) & (capacity - 1);
+      index_[i].hash = hash;
+      index_[i].key = &it->first;
+      index_[i].value = it->second;
+      index_count_++;
+    }
+  }
+
+  std::vector<IndexSlot> index_;
+  size_t index_count_;
 };
 
 // A name space, as set in the schema.
@@ -330,7 +529,8 @@ struct Definition {
         serialized_location(0),
         index(-1),
         refcount(1),
-        declaration_file(nullptr) {}
+        declaration_file(nullptr),
+        qualified_name_namespace(nullptr) {}
 
   flatbuffers::Offset<
       flatbuffers::Vector<flatbuffers::Offset<reflection::KeyValue>>>
@@ -339,11 +539,20 @@ struct Definition {
   bool DeserializeAttributes(Parser &parser,
                              const Vector<Offset<reflection::KeyValue>> *attrs);
 
+  // Copies the state shared by all definitions from src, translating any
+  // definition pointers through remap.
+  void CopyDefinitionFrom(const Definition &src, const DefinitionRemap &remap);
+
+  // The name qualified by defined_namespace. Computed the first time it is
+  // asked for, and again if the definition has moved to another namespace.
+  const std::string &GetQualifiedName() const;
+
   std::string name;
   std::string file;
   int decl_line;
   int decl_col;
   std::vector<std::string> doc_comment;
+  SourceRange doc_range;  // of the lines of doc_comment, if it isn't empty
   SymbolTable<Value> attributes;
   bool generated;  // did we already output code for this definition?
   Namespace *defined_namespace;  // Where it was defined.
@@ -353,6 +562,10 @@ struct Definition {
   int index;  // Inside the vector it is stored.
   int refcount;
   const std::string *declaration_file;
+
+  // Cache for GetQualifiedName().
+  mutable std::string qualified_name;
+  mutable const Namespace *qualified_name_namespace;
 };
 
 struct FieldDef : public Definition {
@@ -431,7 +644,9 @@ struct StructDef : public Definition {
         sortbysize(true),
         has_key(false),
         minalign(1),
-        bytesize(0) {}
+        bytesize(0),
+        body_offset(0),
+        body_end(0) {}
 
   void PadLastField(size_t min_align) {
     auto padding = PaddingBytes(bytesize, min_align);
@@ -444,6 +659,9 @@ struct StructDef : public Definition {
 
   bool Deserialize(Parser &parser, const reflection::Object *object);
 
+  // Copies src and its fields, translating definition pointers through remap.
+  void CopyFrom(const StructDef &src, const DefinitionRemap &remap);
+
   SymbolTable<FieldDef> fields;
 
   bool fixed;       // If it's struct, not a table.
@@ -454,7 +672,18 @@ struct StructDef : public Definition {
   size_t bytesize;  // Size if fixed.
 
   flatbuffers::unique_ptr<std::string> original_location;
+  // Where a predeclared struct was first referenced, if original_location is
+  // set.
+  std::string original_file;
+  SourceRange original_range;
   std::vector<voffset_t> reserved_ids;
+
+  // The braces around the fields, from '{' to just past '}', as a range and
+  // as byte offsets into file. body_end is 0 unless the fields were parsed
+  // up to the closing brace; see Parser::ReparseTable.
+  SourceRange body_range;
+  size_t body_offset;
+  size_t body_end;
 };
 
 struct EnumDef;
@@ -480,12 +709,13 @@ struct EnumVal {
 
   std::string name;
   std::vector<std::string> doc_comment;
+  SourceRange doc_range;  // of the lines of doc_comment, if it isn't empty
   Type union_type;
   SymbolTable<Value> attributes;
   int decl_line;
   int decl_col;
   SourceRange decl_range; // source range that this declaration spans
-  std::string decl_text;  // text of this declaration
+  std::string_view decl_text;  // text of this declaration, see Type
 
  private:
   friend EnumDef;
@@ -506,6 +736,9 @@ struct EnumDef : public Definition {
 
   bool Deserialize(Parser &parser, const reflection::Enum *values);
 
+  // Copies src and its values, translating definition pointers through remap.
+  void CopyFrom(const EnumDef &src, const DefinitionRemap &remap);
+
   template<typename T> void ChangeEnumValue(EnumVal *ev, T new_val);
   void SortByValue();
   void RemoveDuplicates();
@@ -635,7 +868,46 @@ inline bool EqualByName(const Type &a, const Type &b) {
 struct RootTypeLoc {
     std::string filename_;
     SourceRange decl_range; // source range of the type name, including namespace components
-    std::string decl_text; // text of the type name, including namespace components
+    std::string_view decl_text; // text of the type name, including namespace components
+};
+
+// A reference to a struct, table, enum or union by name: the type of a field,
+// a union variant, an rpc request or response, the root type of a
+// nested_flatbuffer attribute, or the root_type.
+struct TypeOccurrence {
+  const std::string *file;   // pooled by the parser, see GetPooledString()
+  SourceRange range;         // of the last component of the name
+  const Definition *target;  // a StructDef or EnumDef of the same parser
+};
+
+// An identifier, string or number in the source of the schema being parsed,
+// with what the parser found it to be. Recorded while lexing if
+// IDLOptions::collect_semantic_tokens is set, and classified by whatever
+// parses it.
+struct SemanticToken {
+  enum Kind {
+    kUnclassified,  // an identifier nothing claimed, e.g. true in a default
+    kKeyword,
+    kNamespace,
+    kType,  // a scalar or string, or what target is if it is set
+    kEnumMember,
+    kField,
+    kAttribute,
+    kService,
+    kMethod,
+    kString,
+    kNumber,
+  };
+  // Flags for modifiers.
+  enum Modifier { kDeclaration = 1, kDeprecated = 2, kBuiltin = 4 };
+
+  SourcePosition start;
+  int32_t length = 0;  // in bytes, tokens are never split across lines
+  Kind kind = kUnclassified;
+  unsigned modifiers = 0;
+  // The StructDef or EnumDef a kType token names or declares, if any. Only
+  // used as a key, since a predeclared struct it named may be gone.
+  const Definition *target = nullptr;
 };
 
 struct RPCCall : public Definition {
@@ -646,7 +918,7 @@ struct RPCCall : public Definition {
 
   StructDef *request, *response;
   SourceRange request_decl_range, response_decl_range; // source range of the type name, including namespace components
-  std::string request_decl_text, response_decl_text; // text of the type name, including namespace components
+  std::string_view request_decl_text, response_decl_text; // text of the type name, including namespace components
 };
 
 struct ServiceDef : public Definition {
@@ -654,6 +926,9 @@ struct ServiceDef : public Definition {
                                         const Parser &parser) const;
   bool Deserialize(Parser &parser, const reflection::Service *service);
 
+  // Copies src and its calls, translating definition pointers through remap.
+  void CopyFrom(const ServiceDef &src, const DefinitionRemap &remap);
+
   SymbolTable<RPCCall> calls;
 };
 
@@ -675,6 +950,224 @@ inline bool operator<(const IncludedFile &a, const IncludedFile &b) {
   return a.filename < b.filename;
 }
 
+// Maps definitions owned by one Parser (or DefinitionSnapshot) to their
+// counterparts in another, so definitions can be copied between the two.
+struct DefinitionRemap {
+  std::map<const StructDef *, StructDef *> structs;
+  std::map<const EnumDef *, EnumDef *> enums;
+  std::map<const Namespace *, Namespace *> namespaces;
+
+  StructDef *Map(const StructDef *struct_def) const;
+  EnumDef *Map(const EnumDef *enum_def) const;
+  Namespace *Map(const Namespace *ns) const;
+  Type Map(const Type &type) const;
+};
+
+// The contents of a source file, null-terminated, kept alive for as long as
+// anything shares them. They are either a string in memory or a mapping of the
+// file, for large files read from disk (see LoadSourceText).
+typedef std::shared_ptr<const char> SourceText;
+
+// Takes ownership of contents as a SourceText.
+SourceText MakeSourceText(std::string contents);
+
+// Reads filename from disk. Files large enough for it to pay off are mapped
+// copy-on-write rather than copied, so they must not be truncated while the
+// SourceText is alive. Returns false if the file can't be read.
+bool LoadSourceText(const std::string &filename, SourceText *contents);
+
+// Sets *hash to HashFile() of filename and its contents on disk. Whenever the
+// file is read for this, *contents (if not null) is set to what was read. The
+// hash is remembered by the file's device, inode, size and modification time,
+// so an unchanged file needn't be read again to hash it. Returns false if the
+// file can't be read.
+bool HashSourceFile(const std::string &filename, uint64_t *hash,
+                    SourceText *contents);
+
+// Sets *canonical to the absolute path of filename with every symbolic link
+// and "." or ".." component resolved, or on Windows to filename as it is.
+// Returns false, without setting it, if filename isn't on disk.
+bool CanonicalSourcePath(const std::string &filename, std::string *canonical);
+
+// The definitions a schema file and everything it includes contributed to a
+// Parser, copied out so that later Parsers can import them instead of lexing
+// and parsing those files again. See Parser::Snapshot and Parser::Import.
+struct DefinitionSnapshot {
+  struct File {
+    std::string filename;
+    std::string schema_name;
+    uint64_t hash;  // HashFile() of the name and contents that were parsed.
+  };
+
+  DefinitionSnapshot() {}
+  ~DefinitionSnapshot() {
+    for (auto it = namespaces.begin(); it != namespaces.end(); ++it) {
+      delete *it;
+    }
+  }
+
+  std::vector<File> files;
+
+  // Definitions from `files`, keyed by fully qualified name.
+  SymbolTable<StructDef> structs;
+  SymbolTable<EnumDef> enums;
+  SymbolTable<ServiceDef> services;
+
+  // Stand-ins for definitions outside of `files` that the definitions above
+  // refer to. These are resolved by name when imported.
+  SymbolTable<StructDef> external_structs;
+  SymbolTable<EnumDef> external_enums;
+
+  std::vector<Namespace *> namespaces;
+  std::map<std::string, std::set<IncludedFile>> files_included_per_file;
+  std::map<std::string, std::string> user_attribute_files;
+  std::map<std::string, std::vector<std::string>> user_attribute_docs;
+
+  // User-defined attributes used by the definitions above but declared
+  // outside of `files`.
+  std::set<std::string> external_attributes;
+
+  // Sources of `files`, which the decl_text of the definitions above view.
+  std::map<std::string, SourceText> sources;
+
+  // Copying is not allowed
+  DefinitionSnapshot(const DefinitionSnapshot &) = delete;
+  DefinitionSnapshot &operator=(const DefinitionSnapshot &) = delete;
+};
+
+// Lets the definitions parsed from an include file be reused by later
+// Parsers. DoParse asks the hook before parsing an include file it has not
+// seen yet, and tells it about every include file it did parse.
+class IncludeCacheHook {
+ public:
+  virtual ~IncludeCacheHook() {}
+
+  // Import the definitions of filename, whose name and contents hash to
+  // hash, into parser. Returns false if the file has to be parsed instead.
+  virtual bool Lookup(Parser &parser, const std::string &filename,
+                      uint64_t hash) = 0;
+
+  // filename and everything it includes have been parsed into parser.
+  virtual void Store(const Parser &parser, const std::string &filename,
+                     uint64_t hash) = 0;
+
+  // Sets *filepath to the file that an include of name from a file in
+  // directory was last resolved to, if the hook remembers it, so that the
+  // include paths aren't searched again.
+  virtual bool LookupInclude(const std::string &directory,
+                             const std::string &name, std::string *filepath) {
+    (void)directory;
+    (void)name;
+    (void)filepath;
+    return false;
+  }
+
+  // An include of name from a file in directory was resolved to filepath.
+  virtual void StoreInclude(const std::string &directory,
+                            const std::string &name,
+                            const std::string &filepath) {
+    (void)directory;
+    (void)name;
+    (void)filepath;
+  }
+};
+
+// Files whose contents take the place of the ones on disk, such as unsaved
+// editor buffers. The Parser checks it before the disk when resolving and
+// loading files.
+class FileOverlay {
+ public:
+  virtual ~FileOverlay() {}
+
+  virtual bool Exists(const std::string &filename) const = 0;
+
+  // Sets contents and returns true if filename is part of the overlay.
+  virtual bool Load(const std::string &filename,
+                    std::string *contents) const = 0;
+};
+
+// A warning or error reported while parsing. The Parser keeps these as data;
+// error_ text is only formatted from them by ErrorText().
+struct ParserDiagnostic {
+  enum Severity { kError, kWarning };
+
+  // The diagnostics worth telling apart, with what each puts in args.
+  enum Kind {
+    kGeneric,              // no args
+    kDuplicateDefinition,  // name, previous file, previous line, previous col
+    kExpectingToken,       // expected token, found token
+    kUndefinedType,        // type name
+    kNonSnakeCase,         // field name
+    kCancelled,            // no args
+    kUnresolvedInclude,    // include name
+  };
+
+  Severity severity;
+  Kind kind;
+  size_t file;  // index into Parser::diagnostic_files_
+  // Where the parser was: line is 1-based, col is the cursor in that line.
+  int line;
+  int64_t col;
+  // The span of what the diagnostic is about, if known. Empty otherwise.
+  SourceRange range;
+  std::string message;
+  std::vector<std::string> args;
+};
+
+// What a parse spent its time on. The times are in nanoseconds, and only
+// measured if IDLOptions::collect_parse_stats is set.
+struct ParseStats {
+  ParseStats()
+      : start_parse_file_ns(0),
+        include_resolve_ns(0),
+        declarations_ns(0),
+        check_clash_ns(0),
+        checks_ns(0),
+        tokens(0),
+        includes_parsed(0),
+        include_cache_hits(0),
+        include_cache_misses(0) {}
+
+  uint64_t start_parse_file_ns;  // StartParseFile, for every file
+  uint64_t include_resolve_ns;   // locating and loading include files
+  uint64_t declarations_ns;      // top-level declarations, including CheckClash
+  uint64_t check_clash_ns;       // CheckClash
+  uint64_t checks_ns;            // the checks once every file is parsed
+  uint64_t tokens;
+  uint64_t includes_parsed;
+  uint64_t include_cache_hits;
+  uint64_t include_cache_misses;
+};
+
+// Adds the time from construction until Stop(), or destruction, to *total.
+// Does nothing if total is null.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(uint64_t *total) : total_(total) {
+    if (total_) start_ = std::chrono::steady_clock::now();
+  }
+  ~PhaseTimer() { Stop(); }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  void Stop() {
+    if (!total_) return;
+    *total_ += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count());
+    total_ = nullptr;
+  }
+
+ private:
+  uint64_t *total_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Generate a unique hash for a file based on its name and contents (if any).
+uint64_t HashFile(const char *source_filename, const char *source);
+
 // Container of options that may apply to any of the source/text generators.
 struct IDLOptions {
   // field case style options for C++
@@ -824,6 +1317,25 @@ struct IDLOptions {
   // make the flatbuffer more compact.
   bool set_empty_vectors_to_null;
 
+  // If set, a declaration that fails to parse is reported and skipped, and
+  // parsing carries on with the next one, so that one parse reports more than
+  // the first error. Parse() still fails.
+  bool recover_from_errors;
+
+  // If set, the Parser times its phases in stats_.
+  bool collect_parse_stats;
+
+  // If set, the Parser records the semantic_tokens_ of the root schema.
+  bool collect_semantic_tokens;
+
+  // If set, the Parser skips the bookkeeping only code generation and
+  // binary schemas need, for a language server that exports definitions
+  // and never generates code: definitions aren't marked as generated, the
+  // builder is left alone between files, and definitions keep only the
+  // range of their doc comment and fields not the file of their struct.
+  // Binary schemas of such a parse are incomplete.
+  bool lsp_mode;
+
   /*********************************** gRPC ***********************************/
   std::string grpc_filename_suffix;
   bool grpc_use_system_headers;
@@ -908,6 +1420,10 @@ struct IDLOptions {
         lang_to_generate(0),
         set_empty_strings_to_null(true),
         set_empty_vectors_to_null(true),
+        recover_from_errors(false),
+        collect_parse_stats(false),
+        collect_semantic_tokens(false),
+        lsp_mode(false),
         grpc_filename_suffix(".fb"),
         grpc_use_system_headers(true),
         grpc_callback_api(false),
@@ -962,6 +1478,16 @@ struct ParserState {
       return SourcePosition{static_cast<int32_t>(prev_cursor_line_), static_cast<int32_t>(PrevCursorPosition())};
   }
 
+  // Extends doc_comment_range_ over a comment on the current line, from start
+  // to the cursor. Called before the comment is added to doc_comment_.
+  void AddDocCommentRange(const char *start) {
+    if (doc_comment_.empty()) {
+      doc_comment_range_.start = SourcePosition{
+          static_cast<int32_t>(line_), static_cast<int32_t>(start - line_start_)};
+    }
+    doc_comment_range_.end = CurrentSourcePosition();
+  }
+
   const char *prev_cursor_;
   const char *cursor_;
   const char *prev_cursor_line_start_; // line_start of prev_cursor (not prior value of line_start_)
@@ -979,6 +1505,7 @@ struct ParserState {
   bool attr_is_trivial_ascii_string_;
   std::string attribute_;
   std::vector<std::string> doc_comment_;
+  SourceRange doc_comment_range_;  // spanned by the lines of doc_comment_
 };
 
 // A way to make error propagation less error prone by requiring values to be
@@ -1035,11 +1562,17 @@ class Parser : public ParserState {
         flex_builder_(256, flexbuffers::BUILDER_FLAG_SHARE_ALL),
         root_struct_def_(nullptr),
         root_type_loc_(nullptr),
+        include_cache_(nullptr),
+        file_overlay_(nullptr),
+        cancel_(nullptr),
         opts(options),
         uses_flexbuffers_(false),
         has_warning_(false),
+        cancelled_(false),
         advanced_features_(0),
+        bytes_scanned_(0),
         source_(nullptr),
+        semantic_tokens_source_(nullptr),
         anonymous_counter_(0),
         parse_depth_counter_(0) {
     if (opts.force_defaults) { builder_.ForceDefaults(true); }
@@ -1047,6 +1580,30 @@ class Parser : public ParserState {
     empty_namespace_ = new Namespace();
     namespaces_.push_back(empty_namespace_);
     current_namespace_ = empty_namespace_;
+    AddBuiltinAttributes();
+  }
+
+  // Copying is not allowed
+  Parser(const Parser &) = delete;
+  Parser &operator=(const Parser &) = delete;
+
+  Parser(Parser &&) = default;
+  Parser &operator=(Parser &&) = default;
+
+  ~Parser() {
+    for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it) {
+      delete *it;
+    }
+    delete root_type_loc_;
+  }
+
+  // Forgets everything parsed so far, leaving the parser as if newly
+  // constructed with the same options, but keeps the memory allocated for it
+  // so that the next parse doesn't have to allocate it again.
+  void Reset();
+
+ private:
+  void AddBuiltinAttributes() {
     known_attributes_["deprecated"] = true;
     known_attributes_["required"] = true;
     known_attributes_["key"] = true;
@@ -1081,19 +1638,7 @@ class Parser : public ParserState {
     known_attributes_["vector64"] = true;
   }
 
-  // Copying is not allowed
-  Parser(const Parser &) = delete;
-  Parser &operator=(const Parser &) = delete;
-
-  Parser(Parser &&) = default;
-  Parser &operator=(Parser &&) = default;
-
-  ~Parser() {
-    for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it) {
-      delete *it;
-    }
-    delete root_type_loc_;
-  }
+ public:
 
   // Parse the string containing either schema or JSON data, which will
   // populate the SymbolTable's or the FlatBufferBuilder above.
@@ -1109,6 +1654,11 @@ class Parser : public ParserState {
   bool Parse(const char *_source, const char **include_paths = nullptr,
              const char *source_filename = nullptr);
 
+  // Parses like Parse, but keeps source itself rather than a copy of it, for
+  // callers that had to copy it out of a buffer that isn't null-terminated.
+  bool ParseSource(SourceText source, const char **include_paths = nullptr,
+                   const char *source_filename = nullptr);
+
   bool ParseJson(const char *json, const char *json_filename = nullptr);
 
   // Returns the number of characters were consumed when parsing a JSON string.
@@ -1154,6 +1704,10 @@ class Parser : public ParserState {
 
   FLATBUFFERS_CHECKED_ERROR Error(const std::string &msg);
   FLATBUFFERS_CHECKED_ERROR Error(const std::string &msg, int error_line, int error_cursor);
+  FLATBUFFERS_CHECKED_ERROR Error(const std::string &msg,
+                                  ParserDiagnostic::Kind kind,
+                                  const std::vector<std::string> &args,
+                                  int error_line = -1, int error_cursor = -1);
 
   // @brief Verify that any of 'opts.lang_to_generate' supports Optional scalars
   // in a schema.
@@ -1165,13 +1719,71 @@ class Parser : public ParserState {
   // others includes.
   std::vector<IncludedFile> GetIncludedFiles() const;
 
+  // Copies the definitions of filename and everything it includes into
+  // snapshot. Returns false if they depend on types that are not defined yet.
+  bool Snapshot(const std::string &filename,
+                DefinitionSnapshot *snapshot) const;
+
+  // Adds the definitions in snapshot as if its files had been included.
+  // Files that were already parsed keep their own definitions. Returns false,
+  // without changing anything, if the snapshot conflicts with definitions
+  // that already exist or refers to definitions that do not.
+  bool Import(const DefinitionSnapshot &snapshot);
+
+  // Parses source, the length bytes (not necessarily null-terminated) of an
+  // edit of the file this parser last parsed, by parsing again only the
+  // fields of the table whose braces enclose everything that changed, when
+  // that gives the same result as parsing all of it. Sets
+  // *parsed to whether the schema has no errors. Returns false if it can't,
+  // after which the parser has to be Reset before it is used again.
+  bool ReparseTable(const char *source, size_t length, bool *parsed);
+
+  // Formats diagnostics_ into error_, one line per diagnostic, and returns it.
+  const std::string &ErrorText();
+
+  // FileExists and LoadFile, checking file_overlay_ first.
+  bool SourceFileExists(const std::string &filename) const;
+  bool LoadSourceFile(const std::string &filename,
+                      std::string *contents) const;
+
+  // LoadSourceText and HashSourceFile, checking file_overlay_ first. On
+  // failure, HashSource still sets *hash to that of filename alone.
+  bool LoadSource(const std::string &filename, SourceText *contents) const;
+  bool HashSource(const std::string &filename, uint64_t *hash,
+                  SourceText *contents) const;
+
  private:
   class ParseDepthGuard;
 
-  void Message(const std::string &msg);
+  // Keeps source alive for as long as this parser, since decl_text views it,
+  // and returns its contents to be parsed.
+  const char *RetainSource(const std::string &filename, SourceText source);
+
+  void Message(ParserDiagnostic::Severity severity,
+               ParserDiagnostic::Kind kind, const std::string &msg,
+               const std::vector<std::string> &args);
   void Warning(const std::string &msg);
+  void Warning(const std::string &msg, ParserDiagnostic::Kind kind,
+               const std::vector<std::string> &args);
+  size_t DiagnosticFile(const std::string &filename);
   FLATBUFFERS_CHECKED_ERROR ParseHexNum(int nibbles, uint64_t *val);
   FLATBUFFERS_CHECKED_ERROR Next();
+  FLATBUFFERS_CHECKED_ERROR NextToken();
+  // Gives def the doc comment before its declaration, or only its range with
+  // opts.lsp_mode set, where the text is read from the source when shown.
+  void SetDocComment(Definition *def, const std::vector<std::string> &doc,
+                     const SourceRange &range);
+  // Records the token from start to the cursor in semantic_tokens_, if it is
+  // in the source being recorded.
+  void RecordToken(const char *start, SemanticToken::Kind kind);
+  // The index in semantic_tokens_ of the token that ends at end, if it is
+  // one of the last two recorded, which are the current and previous token.
+  // Otherwise semantic_tokens_.size().
+  size_t RecordedToken(const SourcePosition &end) const;
+  // Classifies the token that ends at end, if it was recorded.
+  void ClassifyToken(const SourcePosition &end, SemanticToken::Kind kind,
+                     unsigned modifiers = 0,
+                     const Definition *target = nullptr);
   FLATBUFFERS_CHECKED_ERROR SkipByteOrderMark();
   bool Is(int t) const;
   bool IsIdent(const char *id) const;
@@ -1181,6 +1793,10 @@ class Parser : public ParserState {
   FLATBUFFERS_CHECKED_ERROR ParseNamespacing(std::string *id,
                                              std::string *last);
   FLATBUFFERS_CHECKED_ERROR ParseTypeIdent(Type &type);
+  // Records a reference to target by a name whose last component is last and
+  // ends at end.
+  void AddOccurrence(const std::string &last, const SourcePosition &end,
+                     const Definition *target);
   FLATBUFFERS_CHECKED_ERROR ParseType(Type &type);
   FLATBUFFERS_CHECKED_ERROR AddField(StructDef &struct_def,
                                      const std::string &name, const Type &type,
@@ -1234,6 +1850,7 @@ class Parser : public ParserState {
                                       int decl_line, int decl_col,
                                       EnumDef **dest);
   FLATBUFFERS_CHECKED_ERROR ParseDecl(const char *filename);
+  FLATBUFFERS_CHECKED_ERROR ParseFields(StructDef &struct_def);
   FLATBUFFERS_CHECKED_ERROR ParseService(const char *filename);
   FLATBUFFERS_CHECKED_ERROR ParseProtoFields(StructDef *struct_def,
                                              bool isextend, bool inside_oneof);
@@ -1249,16 +1866,24 @@ class Parser : public ParserState {
   FLATBUFFERS_CHECKED_ERROR ParseFlexBufferValue(flexbuffers::Builder *builder);
   FLATBUFFERS_CHECKED_ERROR StartParseFile(const char *source,
                                            const char *source_filename);
-  FLATBUFFERS_CHECKED_ERROR ParseRoot(const char *_source,
+  FLATBUFFERS_CHECKED_ERROR ParseRoot(SourceText _source,
                                       const char **include_paths,
                                       const char *source_filename);
+  // The checks that need every definition of a schema.
+  FLATBUFFERS_CHECKED_ERROR CheckDefinitions();
   FLATBUFFERS_CHECKED_ERROR CheckPrivateLeak();
   FLATBUFFERS_CHECKED_ERROR CheckPrivatelyLeakedFields(
       const Definition &def, const Definition &value_type);
   FLATBUFFERS_CHECKED_ERROR DoParse(const char *_source,
                                     const char **include_paths,
                                     const char *source_filename,
-                                    const char *include_filename);
+                                    const char *include_filename,
+                                    uint64_t source_hash);
+  FLATBUFFERS_CHECKED_ERROR ParseTopLevelDecl(const char *source_filename);
+  void SkipToNextDecl(const char *decl_start);
+  // Deletes the predeclared structs that no definition refers to.
+  void RemoveUnreferencedPredecls();
+  uint64_t *PhaseTotal(uint64_t *total) const;
   FLATBUFFERS_CHECKED_ERROR DoParseJson();
   FLATBUFFERS_CHECKED_ERROR CheckClash(std::vector<FieldDef *> &fields,
                                        StructDef *struct_def,
@@ -1275,6 +1900,7 @@ class Parser : public ParserState {
   Namespace *UniqueNamespace(Namespace *ns);
 
   FLATBUFFERS_CHECKED_ERROR RecurseError();
+  FLATBUFFERS_CHECKED_ERROR CheckCancelled();
   template<typename F> CheckedError Recurse(F f);
 
   const std::string &GetPooledString(const std::string &s) const;
@@ -1287,7 +1913,12 @@ class Parser : public ParserState {
   std::vector<Namespace *> namespaces_;
   Namespace *current_namespace_;
   Namespace *empty_namespace_;
-  std::string error_;  // User readable error_ if Parse() == false
+  std::string error_;  // Filled in by ErrorText()
+
+  // Warnings and errors of the last parse, in the order they were reported.
+  std::vector<ParserDiagnostic> diagnostics_;
+  // Absolute paths of the files diagnostics_ refer to.
+  std::vector<std::string> diagnostic_files_;
 
   FlatBufferBuilder builder_;  // any data contained in the file
   flexbuffers::Builder flex_builder_;
@@ -1298,25 +1929,61 @@ class Parser : public ParserState {
   std::string file_extension_;
 
   std::map<uint64_t, std::string> included_files_;
+  std::map<std::string, uint64_t> included_file_hashes_;
   std::map<std::string, std::set<IncludedFile>> files_included_per_file_;
   std::vector<std::string> native_included_files_;
 
+  // Every reference to a type found by this parse, in the order they were
+  // parsed. Files whose definitions came from include_cache_ have none.
+  std::vector<TypeOccurrence> occurrences_;
+
+  // The tokens of the schema passed to Parse, in source order, if
+  // opts.collect_semantic_tokens is set. Those of included files aren't.
+  std::vector<SemanticToken> semantic_tokens_;
+
+  // Consulted before parsing include files, if set. Not owned.
+  IncludeCacheHook *include_cache_;
+
+  // Consulted before the disk when resolving and loading files, if set. Not
+  // owned.
+  const FileOverlay *file_overlay_;
+
+  // Checked before each declaration and include file, if set. Once it is true
+  // the parse stops with a kCancelled error. Not owned.
+  const std::atomic<bool> *cancel_;
+
   std::map<std::string, bool> known_attributes_;
+  std::map<std::string, std::string> user_attribute_files_;
   std::map<std::string, std::vector<std::string>> user_attribute_docs_;
 
   IDLOptions opts;
   bool uses_flexbuffers_;
   bool has_warning_;
 
+  // Whether the last parse stopped because *cancel_ became true.
+  bool cancelled_;
+
   uint64_t advanced_features_;
 
+  // Total number of source bytes consumed by Next() across all files.
+  uint64_t bytes_scanned_;
+
+  ParseStats stats_;
+
   std::string file_being_parsed_;
 
  private:
   const char *source_;
+  // The source semantic_tokens_ are recorded from, or null.
+  const char *semantic_tokens_source_;
 
   std::vector<std::pair<Value, FieldDef *>> field_stack_;
 
+  // Every source the definitions' decl_text may view, including those of
+  // imported snapshots, and the latest of them for each file.
+  std::vector<SourceText> retained_sources_;
+  std::map<std::string, SourceText> sources_;
+
   // TODO(cneo): Refactor parser to use string_cache more often to save
   // on memory usage.
   mutable std::set<std::string> string_cache_;
@@ -16,7 +16,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <ctime>
 #include <list>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -26,6 +28,50 @@
 #include "flatbuffers/reflection_generated.h"
 #include "flatbuffers/util.h"
 
+// clang-format off
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define FLATBUFFERS_LEXER_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+  #include <arm_neon.h>
+  #define FLATBUFFERS_LEXER_NEON
+#endif
+#if defined(FLATBUFFERS_LEXER_SSE2) || defined(FLATBUFFERS_LEXER_NEON)
+  #define FLATBUFFERS_LEXER_VECTOR
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
+// The lexer's vector scans load whole aligned blocks, which may extend past
+// the end of the source, though never into the next page.
+#if defined(__GNUC__) || defined(__clang__)
+  #if defined(__SANITIZE_ADDRESS__)
+    #define FLATBUFFERS_LEXER_NO_SANITIZE __attribute__((no_sanitize_address))
+  #elif defined(__has_feature)
+    #if __has_feature(address_sanitizer)
+      #define FLATBUFFERS_LEXER_NO_SANITIZE \
+        __attribute__((no_sanitize_address))
+    #endif
+  #endif
+#endif
+#ifndef FLATBUFFERS_LEXER_NO_SANITIZE
+  #define FLATBUFFERS_LEXER_NO_SANITIZE
+#endif
+
+// The hashes of files on disk are remembered by their inode where POSIX has
+// them. Large sources are also mapped rather than read when
+// FLATBUFFERS_LS_MAP_SOURCES is defined; it is off by default because a mapped
+// file truncated by another process faults (SIGBUS) while it is being read.
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define FLATBUFFERS_MAPPED_SOURCES
+#endif
+// clang-format on
+
 namespace flatbuffers {
 
 // Reflects the version at the compiling time of binary(lib/dll/so).
@@ -144,19 +190,10 @@ static T *LookupTableByName(const SymbolTable<T> &table,
   if (table.dict.empty()) return nullptr;
   if (components.size() < skip_top) return nullptr;
   const auto N = components.size() - skip_top;
-  std::string full_name;
-  for (size_t i = 0; i < N; i++) {
-    full_name += components[i];
-    full_name += '.';
-  }
   for (size_t i = N; i > 0; i--) {
-    full_name += name;
-    auto obj = table.Lookup(full_name);
+    auto obj = table.Lookup(components, i, name);
     if (obj) return obj;
-    auto len = full_name.size() - components[i - 1].size() - 1 - name.size();
-    full_name.resize(len);
   }
-  FLATBUFFERS_ASSERT(full_name.empty());
   return table.Lookup(name);  // lookup in global namespace
 }
 
@@ -200,6 +237,133 @@ static std::string TokenToString(int t) {
 
 static bool IsIdentifierStart(char c) { return is_alpha(c) || (c == '_'); }
 
+// The source text between start and end, which must outlive the view.
+static std::string_view DeclText(const char *start, const char *end) {
+  return std::string_view(start, static_cast<size_t>(end - start));
+}
+
+// Runs of blanks, comment text and identifier characters are skipped 16 bytes
+// at a time where vector instructions are available. Blocks are loaded
+// aligned so that they never cross into a page past the '\0' that ends the
+// source, and every scan stops at that '\0'.
+#ifdef FLATBUFFERS_LEXER_VECTOR
+// clang-format off
+#ifdef FLATBUFFERS_LEXER_SSE2
+typedef __m128i LexBlock;
+// A mask has one bit per byte of a block.
+static const int kLexMaskBits = 1;
+static const uint64_t kLexMaskAll = 0xffff;
+
+FLATBUFFERS_LEXER_NO_SANITIZE static LexBlock LexLoad(const char *p) {
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+}
+static LexBlock LexEq(LexBlock b, char c) {
+  return _mm_cmpeq_epi8(b, _mm_set1_epi8(c));
+}
+// Bytes in [lo, hi].
+static LexBlock LexInRange(LexBlock b, char lo, char hi) {
+  const auto offset = _mm_sub_epi8(b, _mm_set1_epi8(lo));
+  const auto span = _mm_set1_epi8(static_cast<char>(hi - lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+}
+static LexBlock LexOr(LexBlock a, LexBlock b) { return _mm_or_si128(a, b); }
+static uint64_t LexMask(LexBlock b) {
+  return static_cast<uint64_t>(_mm_movemask_epi8(b));
+}
+#else
+typedef uint8x16_t LexBlock;
+// A mask has four bits per byte of a block.
+static const int kLexMaskBits = 4;
+static const uint64_t kLexMaskAll = ~static_cast<uint64_t>(0);
+
+FLATBUFFERS_LEXER_NO_SANITIZE static LexBlock LexLoad(const char *p) {
+  return vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+}
+static LexBlock LexEq(LexBlock b, char c) {
+  return vceqq_u8(b, vdupq_n_u8(static_cast<uint8_t>(c)));
+}
+// Bytes in [lo, hi].
+static LexBlock LexInRange(LexBlock b, char lo, char hi) {
+  const auto offset = vsubq_u8(b, vdupq_n_u8(static_cast<uint8_t>(lo)));
+  return vcleq_u8(offset, vdupq_n_u8(static_cast<uint8_t>(hi - lo)));
+}
+static LexBlock LexOr(LexBlock a, LexBlock b) { return vorrq_u8(a, b); }
+static uint64_t LexMask(LexBlock b) {
+  const auto nibbles = vshrn_n_u16(vreinterpretq_u16_u8(b), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#endif
+
+static int LexCountTrailingZeros(uint64_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+// clang-format on
+
+// Returns the first byte at or after p that ends the scan. stops gives the
+// mask of the bytes in a block that do.
+template<typename F> static const char *LexScan(const char *p, F stops) {
+  const auto offset = reinterpret_cast<uintptr_t>(p) & 15;
+  const char *block = p - offset;
+  uint64_t mask = stops(LexLoad(block)) & kLexMaskAll &
+                  (kLexMaskAll << (offset * kLexMaskBits));
+  while (!mask) {
+    block += 16;
+    mask = stops(LexLoad(block)) & kLexMaskAll;
+  }
+  return block + LexCountTrailingZeros(mask) / kLexMaskBits;
+}
+#endif
+
+// Skips spaces, tabs and carriage returns. Newlines are left to the caller,
+// which has to count them.
+static const char *SkipBlanks(const char *p) {
+  if (*p != ' ' && *p != '\t' && *p != '\r') return p;
+#ifdef FLATBUFFERS_LEXER_VECTOR
+  return LexScan(p, [](LexBlock b) {
+    const auto blanks = LexOr(LexEq(b, ' '), LexEq(b, '\t'));
+    return ~LexMask(LexOr(blanks, LexEq(b, '\r')));
+  });
+#else
+  while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+  return p;
+#endif
+}
+
+// Skips to the newline, carriage return or '\0' that ends a comment line.
+static const char *SkipToLineEnd(const char *p) {
+#ifdef FLATBUFFERS_LEXER_VECTOR
+  return LexScan(p, [](LexBlock b) {
+    return LexMask(
+        LexOr(LexOr(LexEq(b, '\n'), LexEq(b, '\r')), LexEq(b, '\0')));
+  });
+#else
+  while (*p && *p != '\n' && *p != '\r') p++;
+  return p;
+#endif
+}
+
+// Skips the rest of an identifier.
+static const char *SkipIdentifier(const char *p) {
+  if (!IsIdentifierStart(*p) && !is_digit(*p)) return p;
+#ifdef FLATBUFFERS_LEXER_VECTOR
+  return LexScan(p, [](LexBlock b) {
+    const auto letters =
+        LexOr(LexInRange(b, 'a', 'z'), LexInRange(b, 'A', 'Z'));
+    const auto others = LexOr(LexInRange(b, '0', '9'), LexEq(b, '_'));
+    return ~LexMask(LexOr(letters, others));
+  });
+#else
+  while (IsIdentifierStart(*p) || is_digit(*p)) p++;
+  return p;
+#endif
+}
+
 static bool CompareSerializedScalars(const uint8_t *a, const uint8_t *b,
                                      const FieldDef &key) {
   switch (key.value.type.base_type) {
@@ -315,6 +479,28 @@ static bool compareFieldDefs(const FieldDef *a, const FieldDef *b) {
   return a_id < b_id;
 }
 
+// Whether a comes before b in a file.
+static bool IsBefore(const SourcePosition &a, const SourcePosition &b) {
+  return a.line < b.line || (a.line == b.line && a.col < b.col);
+}
+
+// Whether pos is in range, counting its end.
+static bool IsWithin(const SourcePosition &pos, const SourceRange &range) {
+  return !IsBefore(pos, range.start) && !IsBefore(range.end, pos);
+}
+
+static SourcePosition DiagnosticPosition(const ParserDiagnostic &diagnostic) {
+  return SourcePosition(diagnostic.line, static_cast<int32_t>(diagnostic.col));
+}
+
+// Whether def is declared after struct_def in the file of struct_def.
+static bool IsDeclaredAfter(const Definition &def,
+                            const StructDef &struct_def) {
+  return def.file == struct_def.file &&
+         IsBefore(SourcePosition(struct_def.decl_line, struct_def.decl_col),
+                  SourcePosition(def.decl_line, def.decl_col));
+}
+
 static Namespace *GetNamespace(
     const std::string &qualified_name, std::vector<Namespace *> &namespaces,
     std::map<std::string, Namespace *> &namespaces_index) {
@@ -341,8 +527,22 @@ static Namespace *GetNamespace(
   return ns;
 }
 
+template<typename T> static bool compareName(const T *a, const T *b) {
+  return a->defined_namespace->GetFullyQualifiedName(a->name) <
+         b->defined_namespace->GetFullyQualifiedName(b->name);
+}
+
+template<typename T> static void AssignIndices(const std::vector<T *> &defvec) {
+  // Pre-sort these vectors, such that we can set the correct indices for them.
+  auto vec = defvec;
+  std::sort(vec.begin(), vec.end(), compareName<T>);
+  for (int i = 0; i < static_cast<int>(vec.size()); i++) vec[i]->index = i;
+}
+
+}  // namespace
+
 // Generate a unique hash for a file based on its name and contents (if any).
-static uint64_t HashFile(const char *source_filename, const char *source) {
+uint64_t HashFile(const char *source_filename, const char *source) {
   uint64_t hash = 0;
 
   if (source_filename)
@@ -353,41 +553,219 @@ static uint64_t HashFile(const char *source_filename, const char *source) {
   return hash;
 }
 
-template<typename T> static bool compareName(const T *a, const T *b) {
-  return a->defined_namespace->GetFullyQualifiedName(a->name) <
-         b->defined_namespace->GetFullyQualifiedName(b->name);
+SourceText MakeSourceText(std::string contents) {
+  auto owner = std::make_shared<const std::string>(std::move(contents));
+  return SourceText(owner, owner->c_str());
 }
 
-template<typename T> static void AssignIndices(const std::vector<T *> &defvec) {
-  // Pre-sort these vectors, such that we can set the correct indices for them.
-  auto vec = defvec;
-  std::sort(vec.begin(), vec.end(), compareName<T>);
-  for (int i = 0; i < static_cast<int>(vec.size()); i++) vec[i]->index = i;
-}
+#ifdef FLATBUFFERS_MAPPED_SOURCES
+namespace {
 
-}  // namespace
+// Files modified this recently (in seconds) could be modified again without
+// their modification time changing, so their hashes aren't remembered.
+static const time_t kSettledSourceAge = 2;
 
-void Parser::Message(const std::string &msg) {
-  if (!error_.empty()) error_ += "\n";  // log all warnings and errors
-  error_ += file_being_parsed_.length() ? AbsolutePath(file_being_parsed_) : "";
-  // clang-format off
+// How many file hashes are remembered before they are all forgotten.
+static const size_t kMaxHashedSources = 4096;
+
+#ifdef FLATBUFFERS_LS_MAP_SOURCES
+// Smaller files are cheaper to read than to map.
+static const off_t kMinMappedSourceSize = 64 * 1024;
+
+// A file mapped copy-on-write, followed by zeroed memory so that its contents
+// are null-terminated even if they fill their last page.
+class MappedSource {
+ public:
+  MappedSource(void *base, size_t size) : base_(base), size_(size) {}
+  ~MappedSource() { munmap(base_, size_); }
+
+  MappedSource(const MappedSource &) = delete;
+  MappedSource &operator=(const MappedSource &) = delete;
+
+  const char *data() const { return static_cast<const char *>(base_); }
+
+  static std::shared_ptr<MappedSource> Map(int fd, size_t length) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    // Reserve zeroed pages up to past the end of the file, then map the file
+    // over the start of them.
+    const size_t size = (length / page + 1) * page;
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+    if (base == MAP_FAILED) return nullptr;
+    if (mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+        MAP_FAILED) {
+      munmap(base, size);
+      return nullptr;
+    }
+    return std::make_shared<MappedSource>(base, size);
+  }
 
-  int line = error_line_ >= 0 ? error_line_ : line_;
-  int64_t cursor = error_cursor_ >= 0 ? error_cursor_ : CursorPosition();
-  #ifdef _WIN32  // MSVC alike
-    error_ +=
-        "(" + NumToString(line) + ", " + NumToString(cursor) + ")";
-  #else  // gcc alike
-    if (file_being_parsed_.length()) error_ += ":";
-    error_ += NumToString(line) + ": " + NumToString(cursor);
+ private:
+  void *base_;
+  size_t size_;
+};
+#endif
+
+// What HashSourceFile last hashed a file's contents to, and when.
+struct HashedSource {
+  off_t size;
+  struct timespec mtime;
+  uint64_t hash;  // of the contents alone, 0 if empty
+};
+
+typedef std::pair<dev_t, ino_t> SourceKey;
+
+// Remembered hashes, and the key each path was last hashed under so that the
+// entry of a file replaced by a rename (as editors save) can be dropped.
+static std::mutex hashed_sources_mutex;
+static std::map<SourceKey, HashedSource> hashed_sources;
+static std::map<std::string, SourceKey> hashed_source_keys;
+
+static struct timespec ModificationTime(const struct stat &st) {
+  // clang-format off
+  #ifdef __APPLE__
+    return st.st_mtimespec;
+  #else
+    return st.st_mtim;
   #endif
   // clang-format on
-  error_ += ": " + msg;
+}
+
+}  // namespace
+#endif
+
+bool LoadSourceText(const std::string &filename, SourceText *contents) {
+#if defined(FLATBUFFERS_MAPPED_SOURCES) && defined(FLATBUFFERS_LS_MAP_SOURCES)
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    std::shared_ptr<MappedSource> mapped;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size >= kMinMappedSourceSize) {
+      mapped = MappedSource::Map(fd, static_cast<size_t>(st.st_size));
+    }
+    close(fd);
+    if (mapped) {
+      *contents = SourceText(mapped, mapped->data());
+      return true;
+    }
+  }
+#endif
+  std::string text;
+  if (!LoadFile(filename.c_str(), true, &text)) return false;
+  *contents = MakeSourceText(std::move(text));
+  return true;
+}
+
+bool CanonicalSourcePath(const std::string &filename, std::string *canonical) {
+#ifdef _WIN32
+  if (!FileExists(filename.c_str())) return false;
+  *canonical = filename;
+#else
+  char *resolved = realpath(filename.c_str(), nullptr);
+  if (!resolved) return false;
+  *canonical = resolved;
+  free(resolved);
+#endif
+  return true;
+}
+
+bool HashSourceFile(const std::string &filename, uint64_t *hash,
+                    SourceText *contents) {
+  const uint64_t name_hash = HashFile(filename.c_str(), nullptr);
+#ifdef FLATBUFFERS_MAPPED_SOURCES
+  struct stat st;
+  const bool stated = stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+  const SourceKey key =
+      stated ? std::make_pair(st.st_dev, st.st_ino) : SourceKey();
+  if (stated) {
+    std::lock_guard<std::mutex> lock(hashed_sources_mutex);
+    auto it = hashed_sources.find(key);
+    if (it != hashed_sources.end() && it->second.size == st.st_size &&
+        it->second.mtime.tv_sec == ModificationTime(st).tv_sec &&
+        it->second.mtime.tv_nsec == ModificationTime(st).tv_nsec) {
+      *hash = name_hash ^ it->second.hash;
+      return true;
+    }
+  }
+#endif
+  SourceText text;
+  if (!LoadSourceText(filename, &text)) return false;
+  const uint64_t contents_hash = *text ? HashFnv1a<uint64_t>(text.get()) : 0;
+  *hash = name_hash ^ contents_hash;
+#ifdef FLATBUFFERS_MAPPED_SOURCES
+  if (stated &&
+      time(nullptr) - ModificationTime(st).tv_sec >= kSettledSourceAge) {
+    std::lock_guard<std::mutex> lock(hashed_sources_mutex);
+    auto previous = hashed_source_keys.find(filename);
+    if (previous != hashed_source_keys.end()) {
+      if (previous->second != key) hashed_sources.erase(previous->second);
+    } else if (hashed_source_keys.size() >= kMaxHashedSources) {
+      hashed_sources.clear();
+      hashed_source_keys.clear();
+    }
+    hashed_source_keys[filename] = key;
+    hashed_sources[key] = HashedSource{ st.st_size, ModificationTime(st),
+                                        contents_hash };
+  }
+#endif
+  if (contents) *contents = std::move(text);
+  return true;
+}
+
+size_t Parser::DiagnosticFile(const std::string &filename) {
+  const std::string path = filename.length() ? AbsolutePath(filename) : "";
+  for (size_t i = 0; i < diagnostic_files_.size(); i++) {
+    if (diagnostic_files_[i] == path) return i;
+  }
+  diagnostic_files_.push_back(path);
+  return diagnostic_files_.size() - 1;
+}
+
+void Parser::Message(ParserDiagnostic::Severity severity,
+                     ParserDiagnostic::Kind kind, const std::string &msg,
+                     const std::vector<std::string> &args) {
+  ParserDiagnostic diagnostic;
+  diagnostic.severity = severity;
+  diagnostic.kind = kind;
+  diagnostic.file = DiagnosticFile(file_being_parsed_);
+  diagnostic.line = error_line_ >= 0 ? error_line_ : line_;
+  diagnostic.col = error_cursor_ >= 0 ? error_cursor_ : CursorPosition();
+  diagnostic.message = msg;
+  diagnostic.args = args;
+  diagnostics_.push_back(diagnostic);
+}
+
+const std::string &Parser::ErrorText() {
+  error_.clear();
+  for (auto it = diagnostics_.begin(); it != diagnostics_.end(); ++it) {
+    const auto &file = diagnostic_files_[it->file];
+    if (!error_.empty()) error_ += "\n";
+    error_ += file;
+    // clang-format off
+    #ifdef _WIN32  // MSVC alike
+      error_ +=
+          "(" + NumToString(it->line) + ", " + NumToString(it->col) + ")";
+    #else  // gcc alike
+      if (file.length()) error_ += ":";
+      error_ += NumToString(it->line) + ": " + NumToString(it->col);
+    #endif
+    // clang-format on
+    error_ += it->severity == ParserDiagnostic::kError ? ": error: "
+                                                       : ": warning: ";
+    error_ += it->message;
+  }
+  return error_;
 }
 
 void Parser::Warning(const std::string &msg) {
+  Warning(msg, ParserDiagnostic::kGeneric, std::vector<std::string>());
+}
+
+void Parser::Warning(const std::string &msg, ParserDiagnostic::Kind kind,
+                     const std::vector<std::string> &args) {
   if (!opts.no_warnings) {
-    Message("warning: " + msg);
+    Message(ParserDiagnostic::kWarning, kind, msg, args);
     has_warning_ = true;  // for opts.warnings_as_errors
   }
 }
@@ -397,9 +775,16 @@ CheckedError Parser::Error(const std::string &msg) {
 }
 
 CheckedError Parser::Error(const std::string &msg, int error_line, int error_cursor) {
+  return Error(msg, ParserDiagnostic::kGeneric, std::vector<std::string>(),
+               error_line, error_cursor);
+}
+
+CheckedError Parser::Error(const std::string &msg, ParserDiagnostic::Kind kind,
+                           const std::vector<std::string> &args,
+                           int error_line, int error_cursor) {
   error_line_ = error_line;
   error_cursor_ = error_cursor;
-  Message("error: " + msg);
+  Message(ParserDiagnostic::kError, kind, msg, args);
   return CheckedError(true);
 }
 
@@ -408,6 +793,13 @@ CheckedError Parser::RecurseError() {
                " reached");
 }
 
+CheckedError Parser::CheckCancelled() {
+  if (!cancel_ || !cancel_->load(std::memory_order_relaxed)) return NoError();
+  cancelled_ = true;
+  return Error("parse cancelled", ParserDiagnostic::kCancelled,
+               std::vector<std::string>(), -1, -1);
+}
+
 const std::string &Parser::GetPooledString(const std::string &s) const {
   return *(string_cache_.insert(s).first);
 }
@@ -454,6 +846,16 @@ std::string Namespace::GetFullyQualifiedName(const std::string &name,
   return stream_str;
 }
 
+const std::string &Definition::GetQualifiedName() const {
+  if (qualified_name.empty() || qualified_name_namespace != defined_namespace) {
+    qualified_name = defined_namespace
+                         ? defined_namespace->GetFullyQualifiedName(name)
+                         : name;
+    qualified_name_namespace = defined_namespace;
+  }
+  return qualified_name;
+}
+
 std::string Parser::TokenToStringId(int t) const {
   return t == kTokenIdentifier ? attribute_ : TokenToString(t);
 }
@@ -484,7 +886,57 @@ CheckedError Parser::SkipByteOrderMark() {
 }
 
 CheckedError Parser::Next() {
+  auto err = NextToken();
+  bytes_scanned_ += static_cast<uint64_t>(cursor_ - prev_cursor_);
+  stats_.tokens++;
+  return err;
+}
+
+uint64_t *Parser::PhaseTotal(uint64_t *total) const {
+  return opts.collect_parse_stats ? total : nullptr;
+}
+
+void Parser::SetDocComment(Definition *def, const std::vector<std::string> &doc,
+                           const SourceRange &range) {
+  if (!opts.lsp_mode) def->doc_comment = doc;
+  def->doc_range = range;
+}
+
+void Parser::RecordToken(const char *start, SemanticToken::Kind kind) {
+  if (source_ != semantic_tokens_source_) return;
+  SemanticToken token;
+  token.start =
+      SourcePosition(line_, static_cast<int32_t>(start - line_start_));
+  token.length = static_cast<int32_t>(cursor_ - start);
+  token.kind = kind;
+  semantic_tokens_.push_back(token);
+}
+
+size_t Parser::RecordedToken(const SourcePosition &end) const {
+  if (source_ != semantic_tokens_source_) return semantic_tokens_.size();
+  const size_t size = semantic_tokens_.size();
+  for (size_t i = size; i > (size > 2 ? size - 2 : 0); i--) {
+    const auto &token = semantic_tokens_[i - 1];
+    if (token.start.line == end.line &&
+        token.start.col + token.length == end.col)
+      return i - 1;
+  }
+  return semantic_tokens_.size();
+}
+
+void Parser::ClassifyToken(const SourcePosition &end, SemanticToken::Kind kind,
+                           unsigned modifiers, const Definition *target) {
+  const size_t index = RecordedToken(end);
+  if (index == semantic_tokens_.size()) return;
+  auto &token = semantic_tokens_[index];
+  token.kind = kind;
+  token.modifiers |= modifiers;
+  token.target = target;
+}
+
+CheckedError Parser::NextToken() {
   doc_comment_.clear();
+  doc_comment_range_ = SourceRange();
   prev_cursor_ = cursor_;
   prev_cursor_line_ = line_;
   prev_cursor_line_start_ = line_start_;
@@ -501,7 +953,7 @@ CheckedError Parser::Next() {
         return NoError();
       case ' ':
       case '\r':
-      case '\t': break;
+      case '\t': cursor_ = SkipBlanks(cursor_); break;
       case '\n':
         MarkNewLine();
         seen_newline = true;
@@ -522,6 +974,14 @@ CheckedError Parser::Next() {
       case '\'': {
         int unicode_high_surrogate = -1;
 
+        // Most string constants are printable ASCII without escapes, which
+        // can be appended in one go.
+        const char *run = cursor_;
+        while (*cursor_ != c && *cursor_ != '\\' &&
+               check_ascii_range(*cursor_, ' ', '~'))
+          cursor_++;
+        attribute_.append(run, cursor_);
+
         while (*cursor_ != c) {
           if (*cursor_ < ' ' && static_cast<signed char>(*cursor_) >= 0)
             return Error("illegal character in string constant");
@@ -630,21 +1090,24 @@ CheckedError Parser::Next() {
           return Error("illegal UTF-8 sequence");
         }
         token_ = kTokenStringConstant;
+        RecordToken(run - 1, SemanticToken::kString);
         return NoError();
       }
       case '/':
         if (*cursor_ == '/') {
           const char *start = ++cursor_;
-          while (*cursor_ && *cursor_ != '\n' && *cursor_ != '\r') cursor_++;
+          cursor_ = SkipToLineEnd(cursor_);
           if (*start == '/') {  // documentation comment
             if (!seen_newline)
               return Error(
                   "a documentation comment should be on a line on its own");
+            AddDocCommentRange(start - 2);
             doc_comment_.push_back(std::string(start + 1, cursor_));
           } else {
             // This is a "//" comment. Treat it as documentation if it's on a
             // line of its own. Otherwise, it's just a regular comment.
             if (seen_newline) {
+              AddDocCommentRange(start - 2);
               doc_comment_.push_back(std::string(start, cursor_));
             }
           }
@@ -665,9 +1128,10 @@ CheckedError Parser::Next() {
         if (IsIdentifierStart(c)) {
           // Collect all chars of an identifier:
           const char *start = cursor_ - 1;
-          while (IsIdentifierStart(*cursor_) || is_digit(*cursor_)) cursor_++;
+          cursor_ = SkipIdentifier(cursor_);
           attribute_.append(start, cursor_);
           token_ = kTokenIdentifier;
+          RecordToken(start, SemanticToken::kUnclassified);
           return NoError();
         }
 
@@ -679,6 +1143,7 @@ CheckedError Parser::Next() {
             attribute_.assign(cursor_ - 1, cursor_ + 3);
             token_ = kTokenFloatConstant;
             cursor_ += 3;
+            RecordToken(cursor_ - 4, SemanticToken::kNumber);
             return NoError();
           }
 
@@ -733,6 +1198,7 @@ CheckedError Parser::Next() {
           if ((dot_lvl >= 0) && (cursor_ > start_digits)) {
             attribute_.append(start, cursor_);
             token_ = dot_lvl ? kTokenIntegerConstant : kTokenFloatConstant;
+            RecordToken(start, SemanticToken::kNumber);
             return NoError();
           } else {
             return Error("invalid number: " + std::string(start, cursor_));
@@ -757,8 +1223,10 @@ bool Parser::IsIdent(const char *id) const {
 // Expect a given token to be next, consume it, or error if not present.
 CheckedError Parser::Expect(int t) {
   if (t != token_) {
-    return Error("expecting: " + TokenToString(t) +
-                 " instead got: " + TokenToStringId(token_));
+    const std::string expected = TokenToString(t);
+    const std::string found = TokenToStringId(token_);
+    return Error("expecting: " + expected + " instead got: " + found,
+                 ParserDiagnostic::kExpectingToken, { expected, found });
   }
   NEXT();
   return NoError();
@@ -766,6 +1234,7 @@ CheckedError Parser::Expect(int t) {
 
 CheckedError Parser::ParseNamespacing(std::string *id, std::string *last) {
   while (Is('.')) {
+    ClassifyToken(PrevSourcePosition(), SemanticToken::kNamespace);
     NEXT();
     *id += ".";
     *id += attribute_;
@@ -798,28 +1267,45 @@ CheckedError Parser::ParseTypeIdent(Type &type) {
   const char *start_cursor = cursor_ - attribute_.length();
 
   std::string id = attribute_;
+  std::string last = attribute_;
   EXPECT(kTokenIdentifier);
-  ECHECK(ParseNamespacing(&id, nullptr));
+  ECHECK(ParseNamespacing(&id, &last));
   auto enum_def = LookupEnum(id);
   if (enum_def) {
     type = enum_def->underlying_type;
     if (enum_def->is_union) type.base_type = BASE_TYPE_UNION;
+    AddOccurrence(last, PrevSourcePosition(), enum_def);
   } else {
     type.base_type = BASE_TYPE_STRUCT;
     type.struct_def = LookupCreateStruct(id);
+    AddOccurrence(last, PrevSourcePosition(), type.struct_def);
   }
 
   type.decl_range = {start_pos, PrevSourcePosition()};
-  type.decl_text = std::string(start_cursor, prev_cursor_);
+  type.decl_text = DeclText(start_cursor, prev_cursor_);
 
   return NoError();
 }
 
+void Parser::AddOccurrence(const std::string &last, const SourcePosition &end,
+                           const Definition *target) {
+  if (!target) return;
+  TypeOccurrence occurrence;
+  occurrence.file = &GetPooledString(file_being_parsed_);
+  occurrence.range.start = SourcePosition(
+      end.line, end.col - static_cast<int32_t>(last.length()));
+  occurrence.range.end = end;
+  occurrence.target = target;
+  occurrences_.push_back(occurrence);
+  ClassifyToken(end, SemanticToken::kType, 0, target);
+}
+
 // Parse any IDL type.
 CheckedError Parser::ParseType(Type &type) {
   if (token_ == kTokenIdentifier) {
     SourcePosition start_pos = CurrentSourcePosition(-attribute_.length());
     const char *start_cursor = cursor_ - attribute_.length();
+    bool builtin = true;
     if (IsIdent("bool")) {
       type.base_type = BASE_TYPE_BOOL;
       NEXT();
@@ -858,9 +1344,14 @@ CheckedError Parser::ParseType(Type &type) {
       NEXT();
     } else {
       ECHECK(ParseTypeIdent(type));
+      builtin = false;
+    }
+    if (builtin) {
+      ClassifyToken(PrevSourcePosition(), SemanticToken::kType,
+                    SemanticToken::kBuiltin);
     }
     type.decl_range = {start_pos, PrevSourcePosition()};
-    type.decl_text = std::string(start_cursor, prev_cursor_);
+    type.decl_text = DeclText(start_cursor, prev_cursor_);
   } else if (token_ == '[') {
     SourcePosition start_pos = CurrentSourcePosition(-1);
     const char *start_cursor = cursor_ - 1;
@@ -894,7 +1385,7 @@ CheckedError Parser::ParseType(Type &type) {
     }
     type.element = subtype.base_type;
     type.decl_range = {start_pos, CurrentSourcePosition()};
-    type.decl_text = std::string(start_cursor, cursor_);
+    type.decl_text = DeclText(start_cursor, cursor_);
     EXPECT(']');
   } else {
     return Error("illegal type syntax");
@@ -908,7 +1399,7 @@ CheckedError Parser::AddField(StructDef &struct_def, const std::string &name,
   field.value.offset =
       FieldIndexToOffset(static_cast<voffset_t>(struct_def.fields.vec.size()));
   field.name = name;
-  field.file = struct_def.file;
+  if (!opts.lsp_mode) field.file = struct_def.file;
   field.value.type = type;
   if (struct_def.fixed) {  // statically compute the field offset
     auto size = InlineSize(type);
@@ -922,9 +1413,12 @@ CheckedError Parser::AddField(StructDef &struct_def, const std::string &name,
   }
   if (struct_def.fields.Add(name, &field)) {
     auto prev_def = struct_def.fields.Lookup(name);
-    auto prev_loc = prev_def != nullptr ?
-        " previously defined at " + prev_def->file+":"+NumToString(prev_def->decl_line)+":"+NumToString(prev_def->decl_col) : "";
-    return Error("field already exists: " + name + prev_loc);
+    if (prev_def == nullptr) return Error("field already exists: " + name);
+    auto prev_loc = " previously defined at " + struct_def.file+":"+NumToString(prev_def->decl_line)+":"+NumToString(prev_def->decl_col);
+    return Error("field already exists: " + name + prev_loc,
+                 ParserDiagnostic::kDuplicateDefinition,
+                 { name, struct_def.file, NumToString(prev_def->decl_line),
+                   NumToString(prev_def->decl_col) });
   }
   *dest = &field;
   return NoError();
@@ -940,10 +1434,15 @@ CheckedError Parser::ParseField(StructDef &struct_def) {
     return Error("field name can not be the same as table/struct name");
 
   if (!IsLowerSnakeCase(name)) {
-    Warning("field names should be lowercase snake_case, got: " + name);
+    Warning("field names should be lowercase snake_case, got: " + name,
+            ParserDiagnostic::kNonSnakeCase, { name });
   }
 
   std::vector<std::string> dc = doc_comment_;
+  const SourceRange dc_range = doc_comment_range_;
+  const size_t name_token = RecordedToken(CurrentSourcePosition());
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kField,
+                SemanticToken::kDeclaration);
   EXPECT(kTokenIdentifier);
   EXPECT(':');
   Type type;
@@ -1022,6 +1521,8 @@ CheckedError Parser::ParseField(StructDef &struct_def) {
 
   if (token_ == '=') {
     NEXT();
+    if (type.enum_def && Is(kTokenIdentifier))
+      ClassifyToken(CurrentSourcePosition(), SemanticToken::kEnumMember);
     ECHECK(ParseSingleValue(&field->name, field->value, true));
     if (IsStruct(type) || (struct_def.fixed && field->value.constant != "0"))
       return Error(
@@ -1058,9 +1559,11 @@ CheckedError Parser::ParseField(StructDef &struct_def) {
     }
   }
 
-  field->doc_comment = dc;
+  SetDocComment(field, dc, dc_range);
   ECHECK(ParseMetaData(&field->attributes));
   field->deprecated = field->attributes.Lookup("deprecated") != nullptr;
+  if (field->deprecated && name_token < semantic_tokens_.size())
+    semantic_tokens_[name_token].modifiers |= SemanticToken::kDeprecated;
   auto hash_name = field->attributes.Lookup("hash");
   if (hash_name) {
     switch ((IsVector(type)) ? type.element : type.base_type) {
@@ -1101,7 +1604,7 @@ CheckedError Parser::ParseField(StructDef &struct_def) {
     // parsed after the type.
     const BaseType element_base_type = type.element;
     const SourceRange decl_range = type.decl_range;
-    const std::string decl_text = type.decl_text;
+    const std::string_view decl_text = type.decl_text;
     type = Type(BASE_TYPE_VECTOR64, type.struct_def, type.enum_def);
     type.element = element_base_type;
     type.decl_range = decl_range;
@@ -1287,6 +1790,9 @@ CheckedError Parser::ParseField(StructDef &struct_def) {
     // This will cause an error if the root type of the nested flatbuffer
     // wasn't defined elsewhere.
     field->nested_flatbuffer = LookupCreateStruct(nested->constant);
+    const auto &root_name = nested->constant;
+    AddOccurrence(root_name.substr(root_name.find_last_of('.') + 1),
+                  nested->decl_range.end, field->nested_flatbuffer);
   }
 
   if (field->attributes.Lookup("flexbuffer")) {
@@ -1938,10 +2444,9 @@ CheckedError Parser::ParseNestedFlatbuffer(Value &val, FieldDef *field,
 
     // Clean nested_parser to avoid deleting the elements in
     // the SymbolTables on destruction
-    nested_parser.enums_.dict.clear();
-    nested_parser.enums_.vec.clear();
+    nested_parser.enums_.Release();
 
-    if (!ok) { ECHECK(Error(nested_parser.error_)); }
+    if (!ok) { ECHECK(Error(nested_parser.ErrorText())); }
     // Force alignment for nested flatbuffer
     builder_.ForceVectorAlignment(
         nested_parser.builder_.GetSize(), sizeof(uint8_t),
@@ -1966,11 +2471,18 @@ CheckedError Parser::ParseMetaData(SymbolTable<Value> *attributes) {
         // TODO(flatbuffers-language-server): This doesn't need to stop parsing.
         return Error("user define attributes must be declared before use: " +
                      name);
+      ClassifyToken(CurrentSourcePosition(), SemanticToken::kAttribute);
       NEXT();
       auto e = new Value();
       if (attributes->Add(name, e)) Warning("attribute already found: " + name);
       if (Is(':')) {
         NEXT();
+        // The text inside the quotes of a string, which is assumed not to have
+        // any escapes.
+        const int64_t quote = Is(kTokenStringConstant) ? 1 : 0;
+        e->decl_range.start = CurrentSourcePosition(
+            -static_cast<int64_t>(attribute_.length()) - quote);
+        e->decl_range.end = CurrentSourcePosition(-quote);
         ECHECK(ParseSingleValue(&name, *e, true));
       }
       if (Is(')')) {
@@ -2282,7 +2794,6 @@ CheckedError Parser::ParseSingleValue(const std::string *name, Value &e,
 
 StructDef *Parser::LookupCreateStruct(const std::string &name,
                                       bool create_if_new, bool definition) {
-  std::string qualified_name = current_namespace_->GetFullyQualifiedName(name);
   // See if it exists pre-declared by an unqualified use.
   auto struct_def = LookupStruct(name);
   if (struct_def && struct_def->predecl) {
@@ -2290,12 +2801,14 @@ StructDef *Parser::LookupCreateStruct(const std::string &name,
       // Make sure it has the current namespace, and is registered under its
       // qualified name.
       struct_def->defined_namespace = current_namespace_;
-      structs_.Move(name, qualified_name);
+      structs_.Move(name, current_namespace_->GetFullyQualifiedName(name));
     }
     return struct_def;
   }
   // See if it exists pre-declared by an qualified use.
-  struct_def = LookupStruct(qualified_name);
+  const auto &components = current_namespace_->components;
+  struct_def = structs_.Lookup(components, components.size(), name);
+  if (struct_def) struct_def->refcount++;
   if (struct_def && struct_def->predecl) {
     if (definition) {
       // Make sure it has the current namespace.
@@ -2309,7 +2822,7 @@ StructDef *Parser::LookupCreateStruct(const std::string &name,
   if (!struct_def && create_if_new) {
     struct_def = new StructDef();
     if (definition) {
-      structs_.Add(qualified_name, struct_def);
+      structs_.Add(current_namespace_->GetFullyQualifiedName(name), struct_def);
       struct_def->name = name;
       struct_def->defined_namespace = current_namespace_;
     } else {
@@ -2326,6 +2839,9 @@ StructDef *Parser::LookupCreateStruct(const std::string &name,
       struct_def->original_location.reset(
           new std::string(file_being_parsed_ + ":" + NumToString(name_start.line) + ":" +
               NumToString(name_start.col) + "-" + NumToString(name_end.line) + ":" + NumToString(name_end.col)));
+      struct_def->original_file = file_being_parsed_;
+      struct_def->original_range.start = name_start;
+      struct_def->original_range.end = name_end;
     }
   }
   return struct_def;
@@ -2455,10 +2971,15 @@ struct EnumValBuilder {
     temp = nullptr;
     if (not_unique) {
       auto prev_def = enum_def.vals.Lookup(name);
-      auto prev_loc = prev_def != nullptr ?
-          " previously defined at " + enum_def.file+":"+NumToString(prev_def->decl_line)+":"+NumToString(prev_def->decl_col) : "";
       std::string type_name = enum_def.is_union ? "union field" : "enum value";
-      return parser.Error(type_name + " already exists: " + name + prev_loc, temp_line, temp_col);
+      if (prev_def == nullptr)
+        return parser.Error(type_name + " already exists: " + name, temp_line, temp_col);
+      auto prev_loc = " previously defined at " + enum_def.file+":"+NumToString(prev_def->decl_line)+":"+NumToString(prev_def->decl_col);
+      return parser.Error(type_name + " already exists: " + name + prev_loc,
+                          ParserDiagnostic::kDuplicateDefinition,
+                          { name, enum_def.file, NumToString(prev_def->decl_line),
+                            NumToString(prev_def->decl_col) },
+                          temp_line, temp_col);
     }
     return NoError();
   }
@@ -2532,6 +3053,8 @@ struct EnumValBuilder {
 CheckedError Parser::ParseEnum(const bool is_union, EnumDef **dest,
                                const char *filename) {
   std::vector<std::string> enum_comment = doc_comment_;
+  const SourceRange enum_comment_range = doc_comment_range_;
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
   NEXT();
   std::string enum_name = attribute_;
   const int decl_line = line_;
@@ -2539,11 +3062,13 @@ CheckedError Parser::ParseEnum(const bool is_union, EnumDef **dest,
   EXPECT(kTokenIdentifier);
   EnumDef *enum_def;
   ECHECK(StartEnum(enum_name, is_union, decl_line, decl_col, &enum_def));
+  ClassifyToken(PrevSourcePosition(), SemanticToken::kType,
+                SemanticToken::kDeclaration, enum_def);
   if (filename != nullptr && !opts.project_root.empty()) {
     enum_def->declaration_file =
         &GetPooledString(FilePath(opts.project_root, filename, opts.binary_schema_absolute_paths));
   }
-  enum_def->doc_comment = enum_comment;
+  SetDocComment(enum_def, enum_comment, enum_comment_range);
   if (!opts.proto_mode) {
     // Give specialized error message, since this type spec used to
     // be optional in the first FlatBuffers release.
@@ -2606,12 +3131,18 @@ CheckedError Parser::ParseEnum(const bool is_union, EnumDef **dest,
       ev.decl_col = static_cast<int>(CursorPosition());
       SourcePosition start_pos = CurrentSourcePosition(-attribute_.length());
       const char *start_cursor = cursor_ - attribute_.length();
-      ev.doc_comment = doc_comment_;
+      if (!opts.lsp_mode) ev.doc_comment = doc_comment_;
+      ev.doc_range = doc_comment_range_;
       EXPECT(kTokenIdentifier);
-      if (is_union) {
+      if (!is_union) {
+        ClassifyToken(PrevSourcePosition(), SemanticToken::kEnumMember,
+                      SemanticToken::kDeclaration);
+      } else {
         ECHECK(ParseNamespacing(&full_name, &ev.name));
+        const std::string last_name = ev.name;
+        const SourcePosition name_end = PrevSourcePosition();
         ev.decl_range = {start_pos, PrevSourcePosition()};
-        ev.decl_text = std::string(start_cursor, prev_cursor_);
+        ev.decl_text = DeclText(start_cursor, prev_cursor_);
         if (opts.union_value_namespacing) {
           // Since we can't namespace the actual enum identifiers, turn
           // namespace parts into part of the identifier.
@@ -2619,6 +3150,8 @@ CheckedError Parser::ParseEnum(const bool is_union, EnumDef **dest,
           std::replace(ev.name.begin(), ev.name.end(), '.', '_');
         }
         if (Is(':')) {
+          ClassifyToken(PrevSourcePosition(), SemanticToken::kEnumMember,
+                        SemanticToken::kDeclaration);
           NEXT();
           ECHECK(ParseType(ev.union_type));
           if (ev.union_type.base_type != BASE_TYPE_STRUCT &&
@@ -2629,6 +3162,7 @@ CheckedError Parser::ParseEnum(const bool is_union, EnumDef **dest,
           ev.decl_text = ev.union_type.decl_text;
         } else {
           ev.union_type = Type(BASE_TYPE_STRUCT, LookupCreateStruct(full_name));
+          AddOccurrence(last_name, name_end, ev.union_type.struct_def);
         }
         if (!enum_def->uses_multiple_type_instances) {
           auto ins = union_types.insert(std::make_pair(
@@ -2705,8 +3239,13 @@ CheckedError Parser::StartStruct(const std::string &name, int decl_line, int dec
   if (!struct_def.predecl)  {
     auto prev_loc = " previously defined at " + struct_def.file+":"+NumToString(struct_def.decl_line)+":"+NumToString(struct_def.decl_col);
     std::string type_name = struct_def.fixed ? "struct" : "table";
-    return Error(type_name + " already exists: " +
-                 current_namespace_->GetFullyQualifiedName(name) + prev_loc, decl_line, decl_col);
+    auto qualified_name = current_namespace_->GetFullyQualifiedName(name);
+    return Error(type_name + " already exists: " + qualified_name + prev_loc,
+                 ParserDiagnostic::kDuplicateDefinition,
+                 { qualified_name, struct_def.file,
+                   NumToString(struct_def.decl_line),
+                   NumToString(struct_def.decl_col) },
+                 decl_line, decl_col);
   }
   struct_def.predecl = false;
   struct_def.name = name;
@@ -2727,6 +3266,7 @@ CheckedError Parser::StartStruct(const std::string &name, int decl_line, int dec
 CheckedError Parser::CheckClash(std::vector<FieldDef *> &fields,
                                 StructDef *struct_def, const char *suffix,
                                 BaseType basetype) {
+  PhaseTimer timer(PhaseTotal(&stats_.check_clash_ns));
   auto len = strlen(suffix);
   for (auto it = fields.begin(); it != fields.end(); ++it) {
     auto &fname = (*it)->name;
@@ -2826,8 +3366,10 @@ std::string Parser::UnqualifiedName(const std::string &full_qualified_name) {
 
 CheckedError Parser::ParseDecl(const char *filename) {
   std::vector<std::string> dc = doc_comment_;
+  const SourceRange dc_range = doc_comment_range_;
   bool fixed = IsIdent("struct");
   if (!fixed && !IsIdent("table")) return Error("declaration expected");
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
   NEXT();
   std::string name = attribute_;
   const int decl_line = line_;
@@ -2835,7 +3377,9 @@ CheckedError Parser::ParseDecl(const char *filename) {
   EXPECT(kTokenIdentifier);
   StructDef *struct_def;
   ECHECK(StartStruct(name, decl_line, decl_col, &struct_def));
-  struct_def->doc_comment = dc;
+  ClassifyToken(PrevSourcePosition(), SemanticToken::kType,
+                SemanticToken::kDeclaration, struct_def);
+  SetDocComment(struct_def, dc, dc_range);
   struct_def->fixed = fixed;
   if (filename && !opts.project_root.empty()) {
     struct_def->declaration_file =
@@ -2844,21 +3388,37 @@ CheckedError Parser::ParseDecl(const char *filename) {
   ECHECK(ParseMetaData(&struct_def->attributes));
   struct_def->sortbysize =
       struct_def->attributes.Lookup("original_order") == nullptr && !fixed;
+  ECHECK(ParseFields(*struct_def));
+  const auto qualified_name =
+      current_namespace_->GetFullyQualifiedName(struct_def->name);
+  if (types_.Add(qualified_name,
+                 new Type(BASE_TYPE_STRUCT, struct_def, nullptr)))
+    return Error("datatype already exists: " + qualified_name);
+  return NoError();
+}
+
+// Parses the braces of a struct or table declaration and the fields in them.
+CheckedError Parser::ParseFields(StructDef &struct_def) {
+  const bool fixed = struct_def.fixed;
+  // The brace is the current token, so it ends at the cursor.
+  struct_def.body_range.start = CurrentSourcePosition(-1);
+  struct_def.body_offset = static_cast<size_t>(cursor_ - source_) - 1;
+  struct_def.body_end = 0;
   EXPECT('{');
-  while (token_ != '}') ECHECK(ParseField(*struct_def));
+  while (token_ != '}') ECHECK(ParseField(struct_def));
   if (fixed) {
-    const auto force_align = struct_def->attributes.Lookup("force_align");
+    const auto force_align = struct_def.attributes.Lookup("force_align");
     if (force_align) {
       size_t align;
-      ECHECK(ParseAlignAttribute(force_align->constant, struct_def->minalign,
+      ECHECK(ParseAlignAttribute(force_align->constant, struct_def.minalign,
                                  &align));
-      struct_def->minalign = align;
+      struct_def.minalign = align;
     }
-    if (!struct_def->bytesize) return Error("size 0 structs not allowed");
+    if (!struct_def.bytesize) return Error("size 0 structs not allowed");
   }
-  struct_def->PadLastField(struct_def->minalign);
+  struct_def.PadLastField(struct_def.minalign);
   // Check if this is a table that has manual id assignments
-  auto &fields = struct_def->fields.vec;
+  auto &fields = struct_def.fields.vec;
   if (!fixed && fields.size()) {
     size_t num_id_fields = 0;
     for (auto it = fields.begin(); it != fields.end(); ++it) {
@@ -2905,33 +3465,34 @@ CheckedError Parser::ParseDecl(const char *filename) {
     }
   }
 
-  ECHECK(
-      CheckClash(fields, struct_def, UnionTypeFieldSuffix(), BASE_TYPE_UNION));
-  ECHECK(CheckClash(fields, struct_def, "Type", BASE_TYPE_UNION));
-  ECHECK(CheckClash(fields, struct_def, "_length", BASE_TYPE_VECTOR));
-  ECHECK(CheckClash(fields, struct_def, "Length", BASE_TYPE_VECTOR));
-  ECHECK(CheckClash(fields, struct_def, "_byte_vector", BASE_TYPE_STRING));
-  ECHECK(CheckClash(fields, struct_def, "ByteVector", BASE_TYPE_STRING));
+  ECHECK(CheckClash(fields, &struct_def, UnionTypeFieldSuffix(),
+                    BASE_TYPE_UNION));
+  ECHECK(CheckClash(fields, &struct_def, "Type", BASE_TYPE_UNION));
+  ECHECK(CheckClash(fields, &struct_def, "_length", BASE_TYPE_VECTOR));
+  ECHECK(CheckClash(fields, &struct_def, "Length", BASE_TYPE_VECTOR));
+  ECHECK(CheckClash(fields, &struct_def, "_byte_vector", BASE_TYPE_STRING));
+  ECHECK(CheckClash(fields, &struct_def, "ByteVector", BASE_TYPE_STRING));
   EXPECT('}');
-  const auto qualified_name =
-      current_namespace_->GetFullyQualifiedName(struct_def->name);
-  if (types_.Add(qualified_name,
-                 new Type(BASE_TYPE_STRUCT, struct_def, nullptr)))
-    return Error("datatype already exists: " + qualified_name);
+  struct_def.body_range.end = PrevSourcePosition();
+  struct_def.body_end = static_cast<size_t>(prev_cursor_ - source_);
   return NoError();
 }
 
 CheckedError Parser::ParseService(const char *filename) {
   std::vector<std::string> service_comment = doc_comment_;
+  const SourceRange service_comment_range = doc_comment_range_;
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
   NEXT();
   auto service_name = attribute_;
   const int service_decl_line = line_;
   const int service_decl_col = static_cast<int>(CursorPosition());
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kService,
+                SemanticToken::kDeclaration);
   EXPECT(kTokenIdentifier);
   auto &service_def = *new ServiceDef();
   service_def.name = service_name;
   service_def.file = file_being_parsed_;
-  service_def.doc_comment = service_comment;
+  SetDocComment(&service_def, service_comment, service_comment_range);
   service_def.defined_namespace = current_namespace_;
   service_def.decl_line = service_decl_line;
   service_def.decl_col = service_decl_col;
@@ -2946,9 +3507,12 @@ CheckedError Parser::ParseService(const char *filename) {
   EXPECT('{');
   do {
     std::vector<std::string> doc_comment = doc_comment_;
+    const SourceRange doc_range = doc_comment_range_;
     auto rpc_name = attribute_;
     const int rpc_decl_line = line_;
     const int rpc_decl_col = static_cast<int>(CursorPosition());
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kMethod,
+                  SemanticToken::kDeclaration);
     EXPECT(kTokenIdentifier);
     EXPECT('(');
     Type reqtype, resptype;
@@ -2967,7 +3531,7 @@ CheckedError Parser::ParseService(const char *filename) {
     rpc.response = resptype.struct_def;
     rpc.response_decl_range = resptype.decl_range;
     rpc.response_decl_text = resptype.decl_text;
-    rpc.doc_comment = doc_comment;
+    SetDocComment(&rpc, doc_comment, doc_range);
     rpc.decl_line = rpc_decl_line;
     rpc.decl_col = rpc_decl_col;
     if (service_def.calls.Add(rpc_name, &rpc))
@@ -3007,12 +3571,14 @@ void Parser::MarkGenerated() {
 }
 
 CheckedError Parser::ParseNamespace() {
+  ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
   NEXT();
   auto ns = new Namespace();
   namespaces_.push_back(ns);  // Store it here to not leak upon error.
   if (token_ != ';') {
     for (;;) {
       ns->components.push_back(attribute_);
+      ClassifyToken(CurrentSourcePosition(), SemanticToken::kNamespace);
       EXPECT(kTokenIdentifier);
       if (Is('.')) NEXT() else break;
     }
@@ -3034,6 +3600,7 @@ CheckedError Parser::ParseProtoDecl() {
     ECHECK(ParseNamespace());
   } else if (IsIdent("message") || isextend) {
     std::vector<std::string> struct_comment = doc_comment_;
+    const SourceRange struct_comment_range = doc_comment_range_;
     NEXT();
     StructDef *struct_def = nullptr;
     Namespace *parent_namespace = nullptr;
@@ -3060,6 +3627,7 @@ CheckedError Parser::ParseProtoDecl() {
       current_namespace_ = UniqueNamespace(ns);
     }
     struct_def->doc_comment = struct_comment;
+    struct_def->doc_range = struct_comment_range;
     ECHECK(ParseProtoFields(struct_def, isextend, false));
     if (!isextend) { current_namespace_ = parent_namespace; }
     if (Is(';')) NEXT();
@@ -3100,6 +3668,7 @@ CheckedError Parser::StartEnum(const std::string &name, bool is_union,
     enum_def.decl_col = decl_col;
   }
   enum_def.doc_comment = doc_comment_;
+  enum_def.doc_range = doc_comment_range_;
 
   enum_def.is_union = is_union;
   enum_def.defined_namespace = current_namespace_;
@@ -3176,6 +3745,7 @@ CheckedError Parser::ParseProtoFields(StructDef *struct_def, bool isextend,
       ECHECK(ParseProtoMapField(struct_def));
     } else {
       std::vector<std::string> field_comment = doc_comment_;
+      const SourceRange field_comment_range = doc_comment_range_;
       // Parse the qualifier.
       bool required = false;
       bool repeated = false;
@@ -3245,6 +3815,7 @@ CheckedError Parser::ParseProtoFields(StructDef *struct_def, bool isextend,
       }
       if (!field) ECHECK(AddField(*struct_def, name, type, &field));
       field->doc_comment = field_comment;
+      field->doc_range = field_comment_range;
       if (!proto_field_id.empty() || oneof) {
         auto val = new Value();
         val->constant = proto_field_id;
@@ -3304,6 +3875,7 @@ CheckedError Parser::ParseProtoFields(StructDef *struct_def, bool isextend,
           auto ev = evb.CreateEnumerator(oneof_type.struct_def->name);
           ev->union_type = oneof_type;
           ev->doc_comment = oneof_field.doc_comment;
+          ev->doc_range = oneof_field.doc_range;
           ECHECK(evb.AcceptEnumerator(oneof_field.name));
         }
       } else {
@@ -3402,7 +3974,7 @@ CheckedError Parser::ParseTypeFromProtoType(Type *type) {
     const char *proto_type;
     BaseType fb_type, element;
   };
-  static type_lookup lookup[] = {
+  static const type_lookup lookup[] = {
     { "float", BASE_TYPE_FLOAT, BASE_TYPE_NONE },
     { "double", BASE_TYPE_DOUBLE, BASE_TYPE_NONE },
     { "int32", BASE_TYPE_INT, BASE_TYPE_NONE },
@@ -3573,12 +4145,96 @@ bool Parser::Parse(const char *source, const char **include_paths,
   if (opts.use_flexbuffers) {
     r = ParseFlexBuffer(source, source_filename, &flex_builder_);
   } else {
-    r = !ParseRoot(source, include_paths, source_filename).Check();
+    r = !ParseRoot(MakeSourceText(source), include_paths, source_filename)
+             .Check();
   }
   FLATBUFFERS_ASSERT(initial_depth == parse_depth_counter_);
   return r;
 }
 
+bool Parser::ParseSource(SourceText source, const char **include_paths,
+                         const char *source_filename) {
+  if (opts.use_flexbuffers)
+    return Parse(source.get(), include_paths, source_filename);
+  const auto initial_depth = parse_depth_counter_;
+  (void)initial_depth;
+  const bool r =
+      !ParseRoot(std::move(source), include_paths, source_filename).Check();
+  FLATBUFFERS_ASSERT(initial_depth == parse_depth_counter_);
+  return r;
+}
+
+void Parser::Reset() {
+  // Definitions first, as they point into namespaces_.
+  services_.Clear();
+  enums_.Clear();
+  structs_.Clear();
+  types_.Clear();
+  for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it) {
+    delete *it;
+  }
+  namespaces_.clear();
+  empty_namespace_ = new Namespace();
+  namespaces_.push_back(empty_namespace_);
+  current_namespace_ = empty_namespace_;
+  delete root_type_loc_;
+  root_type_loc_ = nullptr;
+  root_struct_def_ = nullptr;
+
+  error_.clear();
+  diagnostics_.clear();
+  diagnostic_files_.clear();
+  builder_.Clear();
+  flex_builder_.Clear();
+  flex_root_ = flexbuffers::Reference();
+  file_identifier_.clear();
+  file_extension_.clear();
+  included_files_.clear();
+  included_file_hashes_.clear();
+  files_included_per_file_.clear();
+  native_included_files_.clear();
+  occurrences_.clear();
+  semantic_tokens_.clear();
+
+  // Only user-defined attributes are forgotten. Those that redeclared a
+  // built-in one get it back.
+  for (auto it = known_attributes_.begin(); it != known_attributes_.end();) {
+    if (it->second) {
+      ++it;
+    } else {
+      it = known_attributes_.erase(it);
+    }
+  }
+  AddBuiltinAttributes();
+  user_attribute_files_.clear();
+  user_attribute_docs_.clear();
+
+  uses_flexbuffers_ = false;
+  has_warning_ = false;
+  cancelled_ = false;
+  advanced_features_ = 0;
+  bytes_scanned_ = 0;
+  stats_ = ParseStats();
+  file_being_parsed_.clear();
+  source_ = nullptr;
+  semantic_tokens_source_ = nullptr;
+  field_stack_.clear();
+  retained_sources_.clear();
+  sources_.clear();
+  string_cache_.clear();
+  anonymous_counter_ = 0;
+  prev_cursor_ = cursor_ = nullptr;
+  prev_cursor_line_start_ = line_start_ = nullptr;
+  prev_cursor_line_ = line_ = 0;
+  token_ = -1;
+  error_line_ = -1;
+  error_cursor_ = -1;
+  attr_is_trivial_ascii_string_ = true;
+  attribute_.clear();
+  doc_comment_.clear();
+  doc_comment_range_ = SourceRange();
+}
+
 bool Parser::ParseJson(const char *json, const char *json_filename) {
   const auto initial_depth = parse_depth_counter_;
   (void)initial_depth;
@@ -3593,21 +4249,84 @@ std::ptrdiff_t Parser::BytesConsumed() const {
   return std::distance(source_, prev_cursor_);
 }
 
+bool Parser::SourceFileExists(const std::string &filename) const {
+  if (file_overlay_ && file_overlay_->Exists(filename)) return true;
+  return FileExists(filename.c_str());
+}
+
+bool Parser::LoadSourceFile(const std::string &filename,
+                            std::string *contents) const {
+  if (file_overlay_ && file_overlay_->Load(filename, contents)) return true;
+  return LoadFile(filename.c_str(), true, contents);
+}
+
+bool Parser::LoadSource(const std::string &filename,
+                        SourceText *contents) const {
+  std::string text;
+  if (file_overlay_ && file_overlay_->Load(filename, &text)) {
+    *contents = MakeSourceText(std::move(text));
+    return true;
+  }
+  return LoadSourceText(filename, contents);
+}
+
+bool Parser::HashSource(const std::string &filename, uint64_t *hash,
+                        SourceText *contents) const {
+  std::string text;
+  if (file_overlay_ && file_overlay_->Load(filename, &text)) {
+    *hash = HashFile(filename.c_str(), text.c_str());
+    if (contents) *contents = MakeSourceText(std::move(text));
+    return true;
+  }
+  if (HashSourceFile(filename, hash, contents)) return true;
+  *hash = HashFile(filename.c_str(), nullptr);
+  return false;
+}
+
+const char *Parser::RetainSource(const std::string &filename,
+                                 SourceText source) {
+  retained_sources_.push_back(source);
+  sources_[filename] = source;
+  return source.get();
+}
+
 CheckedError Parser::StartParseFile(const char *source,
                                     const char *source_filename) {
+  PhaseTimer timer(PhaseTotal(&stats_.start_parse_file_ns));
   file_being_parsed_ = source_filename ? source_filename : "";
   source_ = source;
   ResetState(source_);
-  error_.clear();
+  diagnostics_.clear();
   ECHECK(SkipByteOrderMark());
   NEXT();
   if (Is(kTokenEof)) return Error("input file is empty");
   return NoError();
 }
 
-CheckedError Parser::ParseRoot(const char *source, const char **include_paths,
+CheckedError Parser::ParseRoot(SourceText _source, const char **include_paths,
                                const char *source_filename) {
-  ECHECK(DoParse(source, include_paths, source_filename, nullptr));
+  const char *source =
+      RetainSource(source_filename ? source_filename : "", std::move(_source));
+  semantic_tokens_.clear();
+  semantic_tokens_source_ = opts.collect_semantic_tokens ? source : nullptr;
+  uint64_t source_hash = 0;
+  if (source_filename) {
+    // If the file is in-memory, don't include its contents in the hash as we
+    // won't be able to load them later.
+    source_hash = HashFile(source_filename,
+                           SourceFileExists(source_filename) ? source : nullptr);
+  }
+  ECHECK(DoParse(source, include_paths, source_filename, nullptr,
+                 source_hash));
+  ECHECK(CheckDefinitions());
+
+  // Parse JSON object only if the scheme has been parsed.
+  if (token_ == '{') { ECHECK(DoParseJson()); }
+  return NoError();
+}
+
+CheckedError Parser::CheckDefinitions() {
+  PhaseTimer timer(PhaseTotal(&stats_.checks_ns));
 
   // Check that all types were defined.
   for (auto it = structs_.vec.begin(); it != structs_.vec.end();) {
@@ -3652,7 +4371,7 @@ CheckedError Parser::ParseRoot(const char *source, const char **include_paths,
                          NumToString(initial_count) +
                          " use(s) of pre-declaration enum not accounted for: " +
                          enum_def->name);
-          structs_.dict.erase(structs_.dict.find(struct_def.name));
+          structs_.Erase(struct_def.name);
           it = structs_.vec.erase(it);
           delete &struct_def;
           continue;  // Skip error.
@@ -3660,9 +4379,18 @@ CheckedError Parser::ParseRoot(const char *source, const char **include_paths,
       }
       auto err = "type referenced but not defined (check namespace): " +
                  struct_def.name;
-      if (struct_def.original_location)
-        err += ", originally at: " + *struct_def.original_location;
-      return Error(err);
+      auto result =
+          Error(err, ParserDiagnostic::kUndefinedType, { struct_def.name });
+      if (struct_def.original_location) {
+        // Report it where the type was referenced rather than where the
+        // parse ended.
+        auto &diagnostic = diagnostics_.back();
+        diagnostic.file = DiagnosticFile(struct_def.original_file);
+        diagnostic.line = struct_def.original_range.start.line;
+        diagnostic.col = struct_def.original_range.start.col;
+        diagnostic.range = struct_def.original_range;
+      }
+      return result;
     }
     ++it;
   }
@@ -3686,12 +4414,7 @@ CheckedError Parser::ParseRoot(const char *source, const char **include_paths,
     }
   }
 
-  auto err = CheckPrivateLeak();
-  if (err.Check()) return err;
-
-  // Parse JSON object only if the scheme has been parsed.
-  if (token_ == '{') { ECHECK(DoParseJson()); }
-  return NoError();
+  return CheckPrivateLeak();
 }
 
 CheckedError Parser::CheckPrivateLeak() {
@@ -3747,20 +4470,111 @@ CheckedError Parser::CheckPrivatelyLeakedFields(const Definition &def,
   return NoError();
 }
 
+// Parses a declaration other than an include, at the top level of a file.
+CheckedError Parser::ParseTopLevelDecl(const char *source_filename) {
+  PhaseTimer timer(PhaseTotal(&stats_.declarations_ns));
+  if (opts.proto_mode) {
+    ECHECK(ParseProtoDecl());
+  } else if (IsIdent("namespace")) {
+    ECHECK(ParseNamespace());
+  } else if (IsIdent("enum")) {
+    ECHECK(ParseEnum(false, nullptr, source_filename));
+  } else if (IsIdent("union")) {
+    ECHECK(ParseEnum(true, nullptr, source_filename));
+  } else if (IsIdent("root_type")) {
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
+    NEXT();
+    auto root_type = attribute_;
+    auto last = attribute_;
+    SourcePosition start = CurrentSourcePosition(-attribute_.length());
+    const char *start_cursor = cursor_ - attribute_.length();
+    auto root_loc = new RootTypeLoc{source_filename, {}, {}};
+    EXPECT(kTokenIdentifier);
+    ECHECK(ParseNamespacing(&root_type, &last));
+    if (opts.root_type.empty()) {
+      if (!SetRootType(root_type.c_str(), root_loc))
+        return Error("unknown root type: " + root_type);
+      AddOccurrence(last, PrevSourcePosition(), root_struct_def_);
+      if (root_struct_def_->fixed) return Error("root type must be a table");
+    }
+    root_loc->decl_range = SourceRange{start, PrevSourcePosition()};
+    root_loc->decl_text = DeclText(start_cursor, prev_cursor_);
+    EXPECT(';');
+  } else if (IsIdent("file_identifier")) {
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
+    NEXT();
+    file_identifier_ = attribute_;
+    EXPECT(kTokenStringConstant);
+    if (file_identifier_.length() != flatbuffers::kFileIdentifierLength)
+      return Error("file_identifier must be exactly " +
+                   NumToString(flatbuffers::kFileIdentifierLength) +
+                   " characters");
+    EXPECT(';');
+  } else if (IsIdent("file_extension")) {
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
+    NEXT();
+    file_extension_ = attribute_;
+    EXPECT(kTokenStringConstant);
+    EXPECT(';');
+  } else if (IsIdent("include")) {
+    return Error("includes must come before declarations");
+  } else if (IsIdent("attribute")) {
+    std::vector<std::string> dc = doc_comment_;
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
+    NEXT();
+    auto name = attribute_;
+    ClassifyToken(CurrentSourcePosition(), SemanticToken::kAttribute,
+                  SemanticToken::kDeclaration);
+    if (Is(kTokenIdentifier)) {
+      NEXT();
+    } else {
+      EXPECT(kTokenStringConstant);
+    }
+    EXPECT(';');
+    known_attributes_[name] = false;
+    user_attribute_files_[name] = file_being_parsed_;
+    if (!dc.empty()) {
+      user_attribute_docs_[name] = dc;
+    }
+  } else if (IsIdent("rpc_service")) {
+    ECHECK(ParseService(source_filename));
+  } else {
+    ECHECK(ParseDecl(source_filename));
+  }
+  return NoError();
+}
+
+// Skips ahead after a declaration failed to parse, to where the next one
+// probably starts: a definition keyword, or just past a closing brace.
+void Parser::SkipToNextDecl(const char *decl_start) {
+  // Don't report later messages at the position of the error.
+  error_line_ = -1;
+  error_cursor_ = -1;
+  field_stack_.clear();
+  // Skip at least a token if the declaration stopped where it started.
+  bool at_start = cursor_ == decl_start;
+  while (token_ != kTokenEof) {
+    if (!at_start &&
+        (IsIdent("table") || IsIdent("struct") || IsIdent("enum") ||
+         IsIdent("union") || IsIdent("rpc_service") || IsIdent("namespace")))
+      return;
+    const bool closing = token_ == '}';
+    // Errors in the text being skipped would only be noise.
+    if (Next().Check()) diagnostics_.pop_back();
+    if (closing) return;
+    at_start = false;
+  }
+}
+
 CheckedError Parser::DoParse(const char *source, const char **include_paths,
                              const char *source_filename,
-                             const char *include_filename) {
-  uint64_t source_hash = 0;
+                             const char *include_filename,
+                             uint64_t source_hash) {
+  ECHECK(CheckCancelled());
   if (source_filename) {
-    // If the file is in-memory, don't include its contents in the hash as we
-    // won't be able to load them later.
-    if (FileExists(source_filename))
-      source_hash = HashFile(source_filename, source);
-    else
-      source_hash = HashFile(source_filename, nullptr);
-
     if (included_files_.find(source_hash) == included_files_.end()) {
       included_files_[source_hash] = include_filename ? include_filename : "";
+      included_file_hashes_[source_filename] = source_hash;
       files_included_per_file_[source_filename] = std::set<IncludedFile>();
     } else {
       return NoError();
@@ -3771,7 +4585,9 @@ CheckedError Parser::DoParse(const char *source, const char **include_paths,
     include_paths = current_directory;
   }
   field_stack_.clear();
-  builder_.Clear();
+  // Declarations never write to the builder, and a parse in lsp_mode starts
+  // from a Reset() one.
+  if (!opts.lsp_mode) builder_.Clear();
   // Start with a blank namespace just in case this file doesn't have one.
   current_namespace_ = empty_namespace_;
 
@@ -3784,31 +4600,49 @@ CheckedError Parser::DoParse(const char *source, const char **include_paths,
                             attribute_ == "package")) {
       ECHECK(ParseProtoDecl());
     } else if (IsIdent("native_include")) {
+      ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
       NEXT();
       native_included_files_.emplace_back(attribute_);
       EXPECT(kTokenStringConstant);
       EXPECT(';');
     } else if (IsIdent("include") || (opts.proto_mode && IsIdent("import"))) {
+      ClassifyToken(CurrentSourcePosition(), SemanticToken::kKeyword);
       NEXT();
       if (opts.proto_mode && attribute_ == "public") NEXT();
       auto name = flatbuffers::PosixPath(attribute_.c_str());
       EXPECT(kTokenStringConstant);
-      // Look for the file relative to the directory of the current file.
+      PhaseTimer resolve_timer(PhaseTotal(&stats_.include_resolve_ns));
+      const std::string source_file_directory =
+          source_filename ? flatbuffers::StripFileName(source_filename) : "";
       std::string filepath;
-      if (source_filename) {
-        auto source_file_directory =
-            flatbuffers::StripFileName(source_filename);
-        filepath = flatbuffers::ConCatPathFileName(source_file_directory, name);
-      }
-      if (filepath.empty() || !FileExists(filepath.c_str())) {
+      if (!include_cache_ || !include_cache_->LookupInclude(
+                                 source_file_directory, name, &filepath)) {
+        // Look for the file relative to the directory of the current file.
+        bool found = false;
+        if (source_filename) {
+          filepath =
+              flatbuffers::ConCatPathFileName(source_file_directory, name);
+          found = SourceFileExists(filepath);
+        }
         // Look for the file in include_paths.
-        for (auto paths = include_paths; paths && *paths; paths++) {
+        for (auto paths = include_paths; !found && paths && *paths; paths++) {
           filepath = flatbuffers::ConCatPathFileName(*paths, name);
-          if (FileExists(filepath.c_str())) break;
+          found = SourceFileExists(filepath);
+        }
+        // A file on disk is known by one name however it was found, and is
+        // found there again unless files are added or removed. One only in
+        // file_overlay_ may not be there for the next parse.
+        std::string canonical;
+        if (found && CanonicalSourcePath(filepath, &canonical)) {
+          filepath = canonical;
+          if (include_cache_)
+            include_cache_->StoreInclude(source_file_directory, name,
+                                         filepath);
         }
       }
       if (filepath.empty())
-        return Error("unable to locate include file: " + name);
+        return Error("unable to locate include file: " + name,
+                     ParserDiagnostic::kUnresolvedInclude, { name });
       if (source_filename) {
         IncludedFile included_file;
         included_file.filename = filepath;
@@ -3816,32 +4650,53 @@ CheckedError Parser::DoParse(const char *source, const char **include_paths,
         files_included_per_file_[source_filename].insert(included_file);
       }
 
-      std::string contents;
-      bool file_loaded = LoadFile(filepath.c_str(), true, &contents);
-      if (included_files_.find(HashFile(filepath.c_str(), contents.c_str())) ==
-          included_files_.end()) {
+      // The file is only read if it has to be parsed, or to hash it if its
+      // hash isn't known from an earlier parse.
+      SourceText contents;
+      uint64_t include_hash = 0;
+      const bool file_loaded = HashSource(filepath, &include_hash, &contents);
+      resolve_timer.Stop();
+      if (included_files_.find(include_hash) == included_files_.end()) {
         // We found an include file that we have not parsed yet.
-        // Parse it.
         if (!file_loaded) return Error("unable to load include file: " + name);
-        ECHECK(DoParse(contents.c_str(), include_paths, filepath.c_str(),
-                       name.c_str()));
-        // We generally do not want to output code for any included files:
-        if (!opts.generate_all) MarkGenerated();
-        // Reset these just in case the included file had them, and the
-        // parent doesn't.
-        root_struct_def_ = nullptr;
-        file_identifier_.clear();
-        file_extension_.clear();
-        // This is the easiest way to continue this file after an include:
-        // instead of saving and restoring all the state, we simply start the
-        // file anew. This will cause it to encounter the same include
-        // statement again, but this time it will skip it, because it was
-        // entered into included_files_.
-        // This is recursive, but only go as deep as the number of include
-        // statements.
-        included_files_.erase(source_hash);
-        return DoParse(source, include_paths, source_filename,
-                       include_filename);
+        // Reuse its definitions from an earlier parse if we can.
+        const bool cached =
+            include_cache_ &&
+            include_cache_->Lookup(*this, filepath, include_hash);
+        if (include_cache_) {
+          if (cached)
+            stats_.include_cache_hits++;
+          else
+            stats_.include_cache_misses++;
+        }
+        if (!cached) {
+          if (!contents && !LoadSource(filepath, &contents))
+            return Error("unable to load include file: " + name);
+          stats_.includes_parsed++;
+          // Parse it, then pick this file up again right after the include
+          // statement so that it is only ever lexed once.
+          const ParserState saved_state = *this;
+          const std::string saved_file_being_parsed = file_being_parsed_;
+          Namespace *saved_namespace = current_namespace_;
+          ECHECK(DoParse(RetainSource(filepath, std::move(contents)),
+                         include_paths, filepath.c_str(), name.c_str(),
+                         include_hash));
+          // We generally do not want to output code for any included files:
+          if (!opts.generate_all && !opts.lsp_mode) MarkGenerated();
+          if (include_cache_)
+            include_cache_->Store(*this, filepath, include_hash);
+          static_cast<ParserState &>(*this) = saved_state;
+          file_being_parsed_ = saved_file_being_parsed;
+          source_ = source;
+          current_namespace_ = saved_namespace;
+          field_stack_.clear();
+          if (!opts.lsp_mode) builder_.Clear();
+          // Reset these just in case the included file had them, and the
+          // parent doesn't.
+          root_struct_def_ = nullptr;
+          file_identifier_.clear();
+          file_extension_.clear();
+        }
       }
       EXPECT(';');
     } else {
@@ -3849,76 +4704,284 @@ CheckedError Parser::DoParse(const char *source, const char **include_paths,
     }
   }
   // Now parse all other kinds of declarations:
+  bool recovered = false;
   while (token_ != kTokenEof) {
-    if (opts.proto_mode) {
-      ECHECK(ParseProtoDecl());
-    } else if (IsIdent("namespace")) {
-      ECHECK(ParseNamespace());
-    } else if (token_ == '{') {
-      return NoError();
-    } else if (IsIdent("enum")) {
-      ECHECK(ParseEnum(false, nullptr, source_filename));
-    } else if (IsIdent("union")) {
-      ECHECK(ParseEnum(true, nullptr, source_filename));
-    } else if (IsIdent("root_type")) {
-      NEXT();
-      auto root_type = attribute_;
-      SourcePosition start = CurrentSourcePosition(-attribute_.length());
-      const char *start_cursor = cursor_ - attribute_.length();
-      auto root_loc = new RootTypeLoc{source_filename, {}, {}};
-      EXPECT(kTokenIdentifier);
-      ECHECK(ParseNamespacing(&root_type, nullptr));
-      if (opts.root_type.empty()) {
-        if (!SetRootType(root_type.c_str(), root_loc))
-          return Error("unknown root type: " + root_type);
-        if (root_struct_def_->fixed) return Error("root type must be a table");
-      }
-      root_loc->decl_range = SourceRange{start, PrevSourcePosition()};
-      root_loc->decl_text = std::string(start_cursor, prev_cursor_);
-      EXPECT(';');
-    } else if (IsIdent("file_identifier")) {
-      NEXT();
-      file_identifier_ = attribute_;
-      EXPECT(kTokenStringConstant);
-      if (file_identifier_.length() != flatbuffers::kFileIdentifierLength)
-        return Error("file_identifier must be exactly " +
-                     NumToString(flatbuffers::kFileIdentifierLength) +
-                     " characters");
-      EXPECT(';');
-    } else if (IsIdent("file_extension")) {
-      NEXT();
-      file_extension_ = attribute_;
-      EXPECT(kTokenStringConstant);
-      EXPECT(';');
-    } else if (IsIdent("include")) {
-      return Error("includes must come before declarations");
-    } else if (IsIdent("attribute")) {
-      std::vector<std::string> dc = doc_comment_;
-      NEXT();
-      auto name = attribute_;
-      if (Is(kTokenIdentifier)) {
-        NEXT();
-      } else {
-        EXPECT(kTokenStringConstant);
-      }
-      EXPECT(';');
-      known_attributes_[name] = false;
-      if (!dc.empty()) {
-        user_attribute_docs_[name] = dc;
-      }
-    } else if (IsIdent("rpc_service")) {
-      ECHECK(ParseService(source_filename));
-    } else {
-      ECHECK(ParseDecl(source_filename));
+    // Not a declaration error, so don't recover from it.
+    ECHECK(CheckCancelled());
+    if (!opts.proto_mode && token_ == '{') return NoError();
+    const char *decl_start = cursor_;
+    auto ce = ParseTopLevelDecl(source_filename);
+    if (ce.Check()) {
+      if (!opts.recover_from_errors) return ce;
+      recovered = true;
+      SkipToNextDecl(decl_start);
     }
   }
   EXPECT(kTokenEof);
+  // The errors have been reported already.
+  if (recovered) return CheckedError(true);
   if (opts.warnings_as_errors && has_warning_) {
     return Error("treating warnings as errors, failed due to above warnings");
   }
   return NoError();
 }
 
+bool Parser::ReparseTable(const char *source, size_t length, bool *parsed) {
+  auto last_source = sources_.find(file_being_parsed_);
+  if (!source || file_being_parsed_.empty() || last_source == sources_.end() ||
+      opts.proto_mode || opts.warnings_as_errors || cancelled_ ||
+      builder_.GetSize())
+    return false;
+  const char *last = last_source->second.get();
+  const size_t last_length = strlen(last);
+
+  // What changed is what is left between the common prefix and suffix.
+  const size_t shorter = std::min(last_length, length);
+  size_t prefix = 0;
+  while (prefix < shorter && last[prefix] == source[prefix]) prefix++;
+  size_t suffix = 0;
+  while (suffix < shorter - prefix &&
+         last[last_length - 1 - suffix] == source[length - 1 - suffix])
+    suffix++;
+  const size_t last_end = last_length - suffix;
+  const size_t end = length - suffix;
+  const size_t file = DiagnosticFile(file_being_parsed_);
+  auto has_errors = [this]() {
+    for (auto it = diagnostics_.begin(); it != diagnostics_.end(); ++it) {
+      if (it->severity == ParserDiagnostic::kError) return true;
+    }
+    return false;
+  };
+  if (prefix == last_length && prefix == length) {
+    *parsed = !has_errors();
+    return true;
+  }
+  // Everything after the edit has to stay on the line it was on.
+  if (std::count(last + prefix, last + last_end, '\n') !=
+      std::count(source + prefix, source + end, '\n'))
+    return false;
+
+  StructDef *table = nullptr;
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    auto &struct_def = **it;
+    if (struct_def.file == file_being_parsed_ && !struct_def.fixed &&
+        !struct_def.predecl && struct_def.body_end &&
+        struct_def.body_offset < prefix && last_end < struct_def.body_end) {
+      table = &struct_def;
+      break;
+    }
+  }
+  if (!table) return false;
+  const SourceRange body = table->body_range;
+  const size_t body_end = table->body_end + length - last_length;
+  // Unless a line break comes first, whatever follows the closing brace on
+  // its line moves with the edit.
+  if (std::find(source + end, source + body_end, '\n') == source + body_end) {
+    for (const char *p = source + body_end; p < source + length && *p != '\n';
+         p++) {
+      if (*p != ' ' && *p != '\t' && *p != '\r') return false;
+    }
+  }
+  // Errors anywhere else would stay, and may have kept the checks of the
+  // whole schema from running.
+  for (auto it = diagnostics_.begin(); it != diagnostics_.end(); ++it) {
+    if (it->severity == ParserDiagnostic::kError &&
+        (it->file != file || !IsWithin(DiagnosticPosition(*it), body)))
+      return false;
+  }
+  for (auto it = included_file_hashes_.begin();
+       it != included_file_hashes_.end(); ++it) {
+    if (it->first == file_being_parsed_) continue;
+    uint64_t hash = 0;
+    if (!HashSource(it->first, &hash, nullptr) || hash != it->second)
+      return false;
+  }
+
+  stats_ = ParseStats();
+  // Forget what the old fields left behind, remembering where it was so
+  // that what the new ones leave goes in its place.
+  diagnostics_.erase(
+      std::remove_if(diagnostics_.begin(), diagnostics_.end(),
+                     [&](const ParserDiagnostic &diagnostic) {
+                       return diagnostic.file == file &&
+                              IsWithin(DiagnosticPosition(diagnostic), body);
+                     }),
+      diagnostics_.end());
+  const size_t diagnostics_at = static_cast<size_t>(
+      std::find_if(diagnostics_.begin(), diagnostics_.end(),
+                   [&](const ParserDiagnostic &diagnostic) {
+                     return diagnostic.file == file &&
+                            IsBefore(body.start,
+                                     DiagnosticPosition(diagnostic));
+                   }) -
+      diagnostics_.begin());
+  auto in_file = [this](const TypeOccurrence &occurrence) {
+    return *occurrence.file == file_being_parsed_;
+  };
+  occurrences_.erase(
+      std::remove_if(occurrences_.begin(), occurrences_.end(),
+                     [&](const TypeOccurrence &occurrence) {
+                       return in_file(occurrence) &&
+                              IsWithin(occurrence.range.start, body);
+                     }),
+      occurrences_.end());
+  const size_t occurrences_at = static_cast<size_t>(
+      std::find_if(occurrences_.begin(), occurrences_.end(),
+                   [&](const TypeOccurrence &occurrence) {
+                     return in_file(occurrence) &&
+                            IsBefore(body.start, occurrence.range.start);
+                   }) -
+      occurrences_.begin());
+  // Not the token right after the closing brace, which keeps its kind.
+  semantic_tokens_.erase(
+      std::remove_if(semantic_tokens_.begin(), semantic_tokens_.end(),
+                     [&](const SemanticToken &token) {
+                       return IsWithin(token.start, body) &&
+                              IsBefore(token.start, body.end);
+                     }),
+      semantic_tokens_.end());
+  const size_t tokens_at = static_cast<size_t>(
+      std::find_if(semantic_tokens_.begin(), semantic_tokens_.end(),
+                   [&](const SemanticToken &token) {
+                     return IsBefore(body.start, token.start);
+                   }) -
+      semantic_tokens_.begin());
+  table->fields.Clear();
+  table->has_key = false;
+  table->minalign = 1;
+  table->bytesize = 0;
+  // The types only the old fields referred to would never have been
+  // declared. Any others would be reported where they were first referred
+  // to, which may have been one of the old fields.
+  RemoveUnreferencedPredecls();
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    if ((*it)->predecl) return false;
+  }
+
+  const size_t num_structs = structs_.vec.size();
+  const size_t first_diagnostic = diagnostics_.size();
+  const size_t first_occurrence = occurrences_.size();
+  const size_t first_token = semantic_tokens_.size();
+  Namespace *saved_namespace = current_namespace_;
+  source_ = RetainSource(file_being_parsed_,
+                         MakeSourceText(std::string(source, length)));
+  if (semantic_tokens_source_) semantic_tokens_source_ = source_;
+  cursor_ = source_ + table->body_offset;
+  line_ = body.start.line;
+  line_start_ = cursor_ - body.start.col;
+  error_line_ = -1;
+  error_cursor_ = -1;
+  field_stack_.clear();
+  current_namespace_ = table->defined_namespace;
+  if (Next().Check()) return false;
+  const bool failed = ParseFields(*table).Check();
+  // Skip the rest like DoParse would, which has to end where the table did.
+  if (failed) SkipToNextDecl(nullptr);
+  current_namespace_ = saved_namespace;
+  if (static_cast<size_t>(prev_cursor_ - source_) != body_end) return false;
+  const SourcePosition new_body_end = PrevSourcePosition();
+  semantic_tokens_.erase(
+      std::remove_if(semantic_tokens_.begin() + first_token,
+                     semantic_tokens_.end(),
+                     [&](const SemanticToken &token) {
+                       return !IsBefore(token.start, new_body_end);
+                     }),
+      semantic_tokens_.end());
+  if (failed) {
+    table->body_range.end = new_body_end;
+    table->body_end = body_end;
+  }
+
+  // The whole file would have been parsed with the definitions declared
+  // before the table, so everything found has to have been declared by then.
+  for (size_t i = first_occurrence; i < occurrences_.size(); i++) {
+    if (IsDeclaredAfter(*occurrences_[i].target, *table)) return false;
+  }
+  // And a type it predeclared could have been declared further down.
+  for (size_t i = num_structs; i < structs_.vec.size(); i++) {
+    const auto &name = structs_.vec[i]->name;
+    const auto unqualified_name = name.substr(name.rfind('.') + 1);
+    for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+      if (!(*it)->predecl && (*it)->name == unqualified_name &&
+          IsDeclaredAfter(**it, *table))
+        return false;
+    }
+  }
+
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    auto &struct_def = **it;
+    if (&struct_def != table && struct_def.file == table->file &&
+        struct_def.body_end && struct_def.body_offset > table->body_offset) {
+      struct_def.body_offset += length - last_length;
+      struct_def.body_end += length - last_length;
+    }
+  }
+  std::rotate(diagnostics_.begin() + diagnostics_at,
+              diagnostics_.begin() + first_diagnostic, diagnostics_.end());
+  std::rotate(occurrences_.begin() + occurrences_at,
+              occurrences_.begin() + first_occurrence, occurrences_.end());
+  std::rotate(semantic_tokens_.begin() + tokens_at,
+              semantic_tokens_.begin() + first_token, semantic_tokens_.end());
+  has_warning_ = false;
+  for (auto it = diagnostics_.begin(); it != diagnostics_.end(); ++it) {
+    if (it->severity == ParserDiagnostic::kWarning) has_warning_ = true;
+  }
+  if (failed) {
+    // The errors have been reported already.
+    *parsed = false;
+    return true;
+  }
+  const auto qualified_name =
+      table->defined_namespace->GetFullyQualifiedName(table->name);
+  if (!types_.Lookup(qualified_name))
+    types_.Add(qualified_name, new Type(BASE_TYPE_STRUCT, table, nullptr));
+  *parsed = !CheckDefinitions().Check();
+  return true;
+}
+
+void Parser::RemoveUnreferencedPredecls() {
+  bool any = false;
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    if ((*it)->predecl) any = true;
+  }
+  if (!any) return;
+  std::set<const StructDef *> referenced;
+  auto refer = [&referenced](const StructDef *struct_def) {
+    if (struct_def && struct_def->predecl) referenced.insert(struct_def);
+  };
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    for (auto field_it = (*it)->fields.vec.begin();
+         field_it != (*it)->fields.vec.end(); ++field_it) {
+      refer((*field_it)->value.type.struct_def);
+      refer((*field_it)->nested_flatbuffer);
+    }
+  }
+  for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it) {
+    for (auto val_it = (*it)->Vals().begin(); val_it != (*it)->Vals().end();
+         ++val_it) {
+      refer((*val_it)->union_type.struct_def);
+    }
+  }
+  for (auto it = services_.vec.begin(); it != services_.vec.end(); ++it) {
+    for (auto call_it = (*it)->calls.vec.begin();
+         call_it != (*it)->calls.vec.end(); ++call_it) {
+      refer((*call_it)->request);
+      refer((*call_it)->response);
+    }
+  }
+  refer(root_struct_def_);
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end();) {
+    auto &struct_def = **it;
+    if (struct_def.predecl && !referenced.count(&struct_def)) {
+      structs_.Erase(struct_def.name);
+      it = structs_.vec.erase(it);
+      delete &struct_def;
+    } else {
+      ++it;
+    }
+  }
+}
+
 CheckedError Parser::DoParseJson() {
   if (token_ != '{') {
     EXPECT('{');
@@ -4492,6 +5555,410 @@ bool Parser::Deserialize(const reflection::Schema *schema) {
   return true;
 }
 
+StructDef *DefinitionRemap::Map(const StructDef *struct_def) const {
+  if (!struct_def) return nullptr;
+  auto it = structs.find(struct_def);
+  FLATBUFFERS_ASSERT(it != structs.end());
+  return it != structs.end() ? it->second : nullptr;
+}
+
+EnumDef *DefinitionRemap::Map(const EnumDef *enum_def) const {
+  if (!enum_def) return nullptr;
+  auto it = enums.find(enum_def);
+  FLATBUFFERS_ASSERT(it != enums.end());
+  return it != enums.end() ? it->second : nullptr;
+}
+
+Namespace *DefinitionRemap::Map(const Namespace *ns) const {
+  if (!ns) return nullptr;
+  auto it = namespaces.find(ns);
+  FLATBUFFERS_ASSERT(it != namespaces.end());
+  return it != namespaces.end() ? it->second : nullptr;
+}
+
+Type DefinitionRemap::Map(const Type &type) const {
+  Type mapped = type;
+  mapped.struct_def = Map(type.struct_def);
+  mapped.enum_def = Map(type.enum_def);
+  return mapped;
+}
+
+static void CopyAttributes(const SymbolTable<Value> &src,
+                           SymbolTable<Value> *dest) {
+  for (auto it = src.dict.begin(); it != src.dict.end(); ++it) {
+    dest->Add(it->first, new Value(*it->second));
+  }
+}
+
+void Definition::CopyDefinitionFrom(const Definition &src,
+                                    const DefinitionRemap &remap) {
+  name = src.name;
+  file = src.file;
+  decl_line = src.decl_line;
+  decl_col = src.decl_col;
+  doc_comment = src.doc_comment;
+  doc_range = src.doc_range;
+  CopyAttributes(src.attributes, &attributes);
+  generated = src.generated;
+  defined_namespace = remap.Map(src.defined_namespace);
+  serialized_location = src.serialized_location;
+  index = src.index;
+  refcount = src.refcount;
+  // Pooled by the Parser that owns src, so it can't be shared.
+  declaration_file = nullptr;
+}
+
+void StructDef::CopyFrom(const StructDef &src, const DefinitionRemap &remap) {
+  CopyDefinitionFrom(src, remap);
+  std::map<const FieldDef *, FieldDef *> copied_fields;
+  for (auto it = src.fields.vec.begin(); it != src.fields.vec.end(); ++it) {
+    const auto &src_field = **it;
+    auto field = new FieldDef();
+    field->CopyDefinitionFrom(src_field, remap);
+    field->value = src_field.value;
+    field->value.type = remap.Map(src_field.value.type);
+    field->deprecated = src_field.deprecated;
+    field->key = src_field.key;
+    field->shared = src_field.shared;
+    field->native_inline = src_field.native_inline;
+    field->flexbuffer = src_field.flexbuffer;
+    field->offset64 = src_field.offset64;
+    field->presence = src_field.presence;
+    field->nested_flatbuffer = remap.Map(src_field.nested_flatbuffer);
+    field->padding = src_field.padding;
+    fields.Add(src_field.name, field);
+    copied_fields[&src_field] = field;
+  }
+  for (auto it = src.fields.vec.begin(); it != src.fields.vec.end(); ++it) {
+    if ((*it)->sibling_union_field) {
+      copied_fields[*it]->sibling_union_field =
+          copied_fields[(*it)->sibling_union_field];
+    }
+  }
+  fixed = src.fixed;
+  predecl = src.predecl;
+  sortbysize = src.sortbysize;
+  has_key = src.has_key;
+  minalign = src.minalign;
+  bytesize = src.bytesize;
+  if (src.original_location) {
+    original_location.reset(new std::string(*src.original_location));
+  }
+  original_file = src.original_file;
+  original_range = src.original_range;
+  reserved_ids = src.reserved_ids;
+}
+
+void EnumDef::CopyFrom(const EnumDef &src, const DefinitionRemap &remap) {
+  CopyDefinitionFrom(src, remap);
+  for (auto it = src.vals.vec.begin(); it != src.vals.vec.end(); ++it) {
+    const auto &src_val = **it;
+    auto val = new EnumVal(src_val.name, src_val.value);
+    val->doc_comment = src_val.doc_comment;
+    val->doc_range = src_val.doc_range;
+    val->union_type = remap.Map(src_val.union_type);
+    CopyAttributes(src_val.attributes, &val->attributes);
+    val->decl_line = src_val.decl_line;
+    val->decl_col = src_val.decl_col;
+    val->decl_range = src_val.decl_range;
+    val->decl_text = src_val.decl_text;
+    vals.Add(src_val.name, val);
+  }
+  is_union = src.is_union;
+  uses_multiple_type_instances = src.uses_multiple_type_instances;
+  underlying_type = remap.Map(src.underlying_type);
+}
+
+void ServiceDef::CopyFrom(const ServiceDef &src,
+                          const DefinitionRemap &remap) {
+  CopyDefinitionFrom(src, remap);
+  for (auto it = src.calls.vec.begin(); it != src.calls.vec.end(); ++it) {
+    const auto &src_call = **it;
+    auto call = new RPCCall();
+    call->CopyDefinitionFrom(src_call, remap);
+    call->request = remap.Map(src_call.request);
+    call->response = remap.Map(src_call.response);
+    call->request_decl_range = src_call.request_decl_range;
+    call->response_decl_range = src_call.response_decl_range;
+    call->request_decl_text = src_call.request_decl_text;
+    call->response_decl_text = src_call.response_decl_text;
+    calls.Add(src_call.name, call);
+  }
+}
+
+template<typename T> static std::string QualifiedName(const T &def) {
+  return def.defined_namespace
+             ? def.defined_namespace->GetFullyQualifiedName(def.name)
+             : def.name;
+}
+
+bool Parser::Snapshot(const std::string &filename,
+                      DefinitionSnapshot *snapshot) const {
+  const auto files = GetIncludedFilesRecursive(filename);
+  for (auto it = files.begin(); it != files.end(); ++it) {
+    auto hash = included_file_hashes_.find(*it);
+    if (hash == included_file_hashes_.end()) return false;
+    auto schema_name = included_files_.find(hash->second);
+    DefinitionSnapshot::File file;
+    file.filename = *it;
+    file.schema_name =
+        schema_name != included_files_.end() ? schema_name->second : "";
+    file.hash = hash->second;
+    snapshot->files.push_back(file);
+
+    auto source = sources_.find(*it);
+    if (source != sources_.end()) snapshot->sources[*it] = source->second;
+
+    auto includes = files_included_per_file_.find(*it);
+    if (includes != files_included_per_file_.end()) {
+      snapshot->files_included_per_file[*it] = includes->second;
+    }
+  }
+
+  DefinitionRemap remap;
+  for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it) {
+    auto ns = new Namespace(**it);
+    snapshot->namespaces.push_back(ns);
+    remap.namespaces[*it] = ns;
+  }
+
+  std::vector<const StructDef *> structs;
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    if (!files.count((*it)->file)) continue;
+    auto struct_def = new StructDef();
+    snapshot->structs.Add(QualifiedName(**it), struct_def);
+    remap.structs[*it] = struct_def;
+    structs.push_back(*it);
+  }
+  std::vector<const EnumDef *> enums;
+  for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it) {
+    if (!files.count((*it)->file)) continue;
+    auto enum_def = new EnumDef();
+    snapshot->enums.Add(QualifiedName(**it), enum_def);
+    remap.enums[*it] = enum_def;
+    enums.push_back(*it);
+  }
+  std::vector<const ServiceDef *> services;
+  for (auto it = services_.vec.begin(); it != services_.vec.end(); ++it) {
+    if (!files.count((*it)->file)) continue;
+    services.push_back(*it);
+  }
+
+  // Definitions from other files are left as stand-ins to be looked up by
+  // name on import. Pre-declared ones might never get defined, so those make
+  // the snapshot unusable.
+  auto reference_struct = [&](const StructDef *struct_def) -> bool {
+    if (!struct_def || remap.structs.count(struct_def)) return true;
+    if (struct_def->predecl) return false;
+    auto stub = new StructDef();
+    stub->name = struct_def->name;
+    stub->defined_namespace = remap.Map(struct_def->defined_namespace);
+    stub->predecl = false;
+    snapshot->external_structs.Add(QualifiedName(*struct_def), stub);
+    remap.structs[struct_def] = stub;
+    return true;
+  };
+  auto reference_enum = [&](const EnumDef *enum_def) -> bool {
+    if (!enum_def || remap.enums.count(enum_def)) return true;
+    auto stub = new EnumDef();
+    stub->name = enum_def->name;
+    stub->defined_namespace = remap.Map(enum_def->defined_namespace);
+    snapshot->external_enums.Add(QualifiedName(*enum_def), stub);
+    remap.enums[enum_def] = stub;
+    return true;
+  };
+  // User-defined attributes declared elsewhere must be known on import too.
+  auto reference_attributes = [&](const SymbolTable<Value> &attributes) {
+    for (auto it = attributes.dict.begin(); it != attributes.dict.end();
+         ++it) {
+      auto known = known_attributes_.find(it->first);
+      if (known != known_attributes_.end() && known->second) continue;
+      auto declared = user_attribute_files_.find(it->first);
+      if (declared == user_attribute_files_.end() ||
+          !files.count(declared->second)) {
+        snapshot->external_attributes.insert(it->first);
+      }
+    }
+  };
+  for (auto it = structs.begin(); it != structs.end(); ++it) {
+    reference_attributes((*it)->attributes);
+    for (auto field = (*it)->fields.vec.begin();
+         field != (*it)->fields.vec.end(); ++field) {
+      if (!reference_struct((*field)->value.type.struct_def) ||
+          !reference_enum((*field)->value.type.enum_def) ||
+          !reference_struct((*field)->nested_flatbuffer)) {
+        return false;
+      }
+      reference_attributes((*field)->attributes);
+    }
+  }
+  for (auto it = enums.begin(); it != enums.end(); ++it) {
+    if (!reference_enum((*it)->underlying_type.enum_def)) return false;
+    reference_attributes((*it)->attributes);
+    for (auto val = (*it)->Vals().begin(); val != (*it)->Vals().end(); ++val) {
+      if (!reference_struct((*val)->union_type.struct_def) ||
+          !reference_enum((*val)->union_type.enum_def)) {
+        return false;
+      }
+      reference_attributes((*val)->attributes);
+    }
+  }
+  for (auto it = services.begin(); it != services.end(); ++it) {
+    reference_attributes((*it)->attributes);
+    for (auto call = (*it)->calls.vec.begin(); call != (*it)->calls.vec.end();
+         ++call) {
+      if (!reference_struct((*call)->request) ||
+          !reference_struct((*call)->response)) {
+        return false;
+      }
+      reference_attributes((*call)->attributes);
+    }
+  }
+
+  for (auto it = structs.begin(); it != structs.end(); ++it) {
+    remap.Map(*it)->CopyFrom(**it, remap);
+  }
+  for (auto it = enums.begin(); it != enums.end(); ++it) {
+    remap.Map(*it)->CopyFrom(**it, remap);
+  }
+  for (auto it = services.begin(); it != services.end(); ++it) {
+    auto service_def = new ServiceDef();
+    service_def->CopyFrom(**it, remap);
+    snapshot->services.Add(QualifiedName(**it), service_def);
+  }
+
+  for (auto it = user_attribute_files_.begin();
+       it != user_attribute_files_.end(); ++it) {
+    if (!files.count(it->second)) continue;
+    snapshot->user_attribute_files[it->first] = it->second;
+    auto docs = user_attribute_docs_.find(it->first);
+    if (docs != user_attribute_docs_.end()) {
+      snapshot->user_attribute_docs[it->first] = docs->second;
+    }
+  }
+  return true;
+}
+
+bool Parser::Import(const DefinitionSnapshot &snapshot) {
+  // Files this parser has already seen keep their own definitions, and the
+  // snapshot's copies of them are only used to resolve references.
+  std::set<std::string> seen;
+  for (auto it = snapshot.files.begin(); it != snapshot.files.end(); ++it) {
+    if (included_files_.count(it->hash)) seen.insert(it->filename);
+  }
+
+  // Resolve everything before changing anything, so that a snapshot which
+  // doesn't fit leaves this parser as it was.
+  DefinitionRemap remap;
+  for (auto it = snapshot.structs.dict.begin();
+       it != snapshot.structs.dict.end(); ++it) {
+    auto existing = structs_.Lookup(it->first);
+    if (seen.count(it->second->file)) {
+      if (!existing || existing->predecl) return false;
+      remap.structs[it->second] = existing;
+    } else if (existing || types_.Lookup(it->first)) {
+      return false;
+    }
+  }
+  for (auto it = snapshot.enums.dict.begin(); it != snapshot.enums.dict.end();
+       ++it) {
+    auto existing = enums_.Lookup(it->first);
+    if (seen.count(it->second->file)) {
+      if (!existing) return false;
+      remap.enums[it->second] = existing;
+    } else if (existing || types_.Lookup(it->first)) {
+      return false;
+    }
+  }
+  for (auto it = snapshot.services.dict.begin();
+       it != snapshot.services.dict.end(); ++it) {
+    if (!seen.count(it->second->file) && services_.Lookup(it->first)) {
+      return false;
+    }
+  }
+  for (auto it = snapshot.external_structs.dict.begin();
+       it != snapshot.external_structs.dict.end(); ++it) {
+    auto existing = structs_.Lookup(it->first);
+    if (!existing || existing->predecl) return false;
+    remap.structs[it->second] = existing;
+  }
+  for (auto it = snapshot.external_enums.dict.begin();
+       it != snapshot.external_enums.dict.end(); ++it) {
+    auto existing = enums_.Lookup(it->first);
+    if (!existing) return false;
+    remap.enums[it->second] = existing;
+  }
+  for (auto it = snapshot.external_attributes.begin();
+       it != snapshot.external_attributes.end(); ++it) {
+    if (!known_attributes_.count(*it)) return false;
+  }
+
+  for (auto it = snapshot.namespaces.begin(); it != snapshot.namespaces.end();
+       ++it) {
+    remap.namespaces[*it] = UniqueNamespace(new Namespace(**it));
+  }
+  for (auto it = snapshot.structs.vec.begin(); it != snapshot.structs.vec.end();
+       ++it) {
+    if (seen.count((*it)->file)) continue;
+    const auto qualified_name = QualifiedName(**it);
+    auto struct_def = new StructDef();
+    structs_.Add(qualified_name, struct_def);
+    types_.Add(qualified_name, new Type(BASE_TYPE_STRUCT, struct_def, nullptr));
+    remap.structs[*it] = struct_def;
+  }
+  for (auto it = snapshot.enums.vec.begin(); it != snapshot.enums.vec.end();
+       ++it) {
+    if (seen.count((*it)->file)) continue;
+    const auto qualified_name = QualifiedName(**it);
+    auto enum_def = new EnumDef();
+    enums_.Add(qualified_name, enum_def);
+    types_.Add(qualified_name, new Type(BASE_TYPE_UNION, nullptr, enum_def));
+    remap.enums[*it] = enum_def;
+  }
+  for (auto it = snapshot.structs.vec.begin(); it != snapshot.structs.vec.end();
+       ++it) {
+    if (!seen.count((*it)->file)) remap.Map(*it)->CopyFrom(**it, remap);
+  }
+  for (auto it = snapshot.enums.vec.begin(); it != snapshot.enums.vec.end();
+       ++it) {
+    if (!seen.count((*it)->file)) remap.Map(*it)->CopyFrom(**it, remap);
+  }
+  for (auto it = snapshot.services.vec.begin();
+       it != snapshot.services.vec.end(); ++it) {
+    if (seen.count((*it)->file)) continue;
+    auto service_def = new ServiceDef();
+    service_def->CopyFrom(**it, remap);
+    services_.Add(QualifiedName(**it), service_def);
+  }
+
+  for (auto it = snapshot.sources.begin(); it != snapshot.sources.end();
+       ++it) {
+    retained_sources_.push_back(it->second);
+    if (!seen.count(it->first)) sources_[it->first] = it->second;
+  }
+  for (auto it = snapshot.files.begin(); it != snapshot.files.end(); ++it) {
+    if (seen.count(it->filename)) continue;
+    included_files_[it->hash] = it->schema_name;
+    included_file_hashes_[it->filename] = it->hash;
+    auto includes = snapshot.files_included_per_file.find(it->filename);
+    files_included_per_file_[it->filename] =
+        includes != snapshot.files_included_per_file.end()
+            ? includes->second
+            : std::set<IncludedFile>();
+  }
+  for (auto it = snapshot.user_attribute_files.begin();
+       it != snapshot.user_attribute_files.end(); ++it) {
+    if (seen.count(it->second)) continue;
+    known_attributes_[it->first] = false;
+    user_attribute_files_[it->first] = it->second;
+    auto docs = snapshot.user_attribute_docs.find(it->first);
+    if (docs != snapshot.user_attribute_docs.end()) {
+      user_attribute_docs_[it->first] = docs->second;
+    }
+  }
+  return true;
+}
+
 std::string Parser::ConformTo(const Parser &base) {
   for (auto sit = structs_.vec.begin(); sit != structs_.vec.end(); ++sit) {
     auto &struct_def = **sit;
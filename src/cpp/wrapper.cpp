@@ -1,48 +1,632 @@
 #include "wrapper.h"
 #include "flatbuffers/idl.h"
+#include "flatbuffers/util.h"
 #include <string>
+#include <string_view>
 #ifdef _WIN32
 #include <direct.h>
 #else
 #include <unistd.h>
 #endif
 #include <vector>
-#include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+#ifdef FLATBUFFERS_LS_MEMORY_STATS
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(_WIN32) || defined(__linux__)
+#include <malloc.h>
+#endif
+
+// The C++ side allocates through these, so that each thread can tell how much of it is
+// allocated at a time for the memory figures of ParseStats. The size is what malloc actually
+// reserved, so it is also known when the memory is freed. Replacing them affects every C++
+// allocation in the process, so it is only compiled in with the parse-memory-stats feature.
+static thread_local int64_t allocated_bytes = 0;
+static thread_local int64_t peak_allocated_bytes = 0;
+
+static int64_t AllocationSize(void* p) {
+#if defined(__APPLE__)
+    return static_cast<int64_t>(malloc_size(p));
+#elif defined(_WIN32)
+    return static_cast<int64_t>(_msize(p));
+#elif defined(__linux__)
+    return static_cast<int64_t>(malloc_usable_size(p));
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+void* operator new(std::size_t size) {
+    void* p;
+    while (!(p = std::malloc(size ? size : 1))) {
+        auto handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+    allocated_bytes += AllocationSize(p);
+    peak_allocated_bytes = std::max(peak_allocated_bytes, allocated_bytes);
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    // Memory allocated on another thread is counted off this one, so only differences on
+    // one thread mean anything.
+    allocated_bytes -= AllocationSize(p);
+    std::free(p);
+}
+
+// Measures the memory allocated on this thread from construction until Stop().
+class AllocationMeter {
+public:
+    AllocationMeter() : start_(allocated_bytes) { peak_allocated_bytes = allocated_bytes; }
+
+    // The most that was allocated at once since construction, and what of it is still.
+    void Stop(uint64_t* peak, uint64_t* retained) const {
+        *peak = static_cast<uint64_t>(std::max<int64_t>(peak_allocated_bytes - start_, 0));
+        *retained = static_cast<uint64_t>(std::max<int64_t>(allocated_bytes - start_, 0));
+    }
+
+private:
+    int64_t start_;
+};
+#else
+// Without allocation counting, parses report no memory figures.
+class AllocationMeter {
+public:
+    void Stop(uint64_t* peak, uint64_t* retained) const {
+        *peak = 0;
+        *retained = 0;
+    }
+};
+#endif
+
+// Bump-allocates interned strings out of large chunks, so a repeated string costs one hash
+// lookup and no allocation. Interned strings are null-terminated and stay valid until the
+// arena is destroyed.
+class StringArena {
+public:
+    struct String {
+        const char* data;
+        uint32_t length;
+        uint32_t id; // order in which the string was first interned
+    };
+
+    String Intern(const char* s, size_t length) {
+        if ((entries_.size() + 1) * 4 > slots_.size() * 3) Grow();
+        const uint64_t hash = Hash(s, length);
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const uint32_t id = slots_[i];
+            if (id == kEmptySlot) {
+                Entry entry = { { Copy(s, length), static_cast<uint32_t>(length), static_cast<uint32_t>(entries_.size()) }, hash };
+                slots_[i] = entry.string.id;
+                entries_.push_back(entry);
+                return entry.string;
+            }
+            const auto& entry = entries_[id];
+            if (entry.hash == hash && entry.string.length == length && memcmp(entry.string.data, s, length) == 0) {
+                return entry.string;
+            }
+        }
+    }
+
+    String Intern(std::string_view s) { return Intern(s.data(), s.size()); }
+
+    // Forgets every string, keeping the first chunk and the slot table for the next ones.
+    void Clear() {
+        if (chunks_.size() > 1) chunks_.resize(1);
+        chunk_next_ = chunks_.empty() ? nullptr : chunks_[0].data.get();
+        chunk_remaining_ = chunks_.empty() ? 0 : chunks_[0].size;
+        std::fill(slots_.begin(), slots_.end(), static_cast<uint32_t>(kEmptySlot));
+        entries_.clear();
+        allocations_ = 0;
+    }
+
+    // Number of heap allocations made since the arena was created or last cleared.
+    uint64_t allocations() const { return allocations_; }
+
+private:
+    struct Entry {
+        String string;
+        uint64_t hash;
+    };
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    static const uint32_t kEmptySlot = 0xffffffffu;
+    static const size_t kChunkSize = 64 * 1024;
+
+    const char* Copy(const char* s, size_t length) {
+        if (length + 1 > chunk_remaining_) {
+            const size_t size = length + 1 > kChunkSize ? length + 1 : kChunkSize;
+            chunks_.push_back(Chunk{ std::unique_ptr<char[]>(new char[size]), size });
+            allocations_++;
+            chunk_next_ = chunks_.back().data.get();
+            chunk_remaining_ = size;
+        }
+        char* copy = chunk_next_;
+        memcpy(copy, s, length);
+        copy[length] = '\0';
+        chunk_next_ += length + 1;
+        chunk_remaining_ -= length + 1;
+        return copy;
+    }
+
+    // Doubles the slot table, keeping it at most 3/4 full.
+    void Grow() {
+        const size_t num_slots = slots_.empty() ? 64 : slots_.size() * 2;
+        std::vector<uint32_t> slots(num_slots, static_cast<uint32_t>(kEmptySlot));
+        const size_t mask = num_slots - 1;
+        for (const auto& entry : entries_) {
+            size_t i = entry.hash & mask;
+            while (slots[i] != kEmptySlot) i = (i + 1) & mask;
+            slots[i] = entry.string.id;
+        }
+        slots_.swap(slots);
+        entries_.reserve(num_slots * 3 / 4);
+        allocations_ += 2;
+    }
+
+    // FNV-1a
+    static uint64_t Hash(const char* s, size_t length) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(s[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::vector<Chunk> chunks_;
+    char* chunk_next_ = nullptr;
+    size_t chunk_remaining_ = 0;
+    std::vector<uint32_t> slots_;
+    std::vector<Entry> entries_;
+    uint64_t allocations_ = 0;
+};
 
 // We use a C-style struct to hide the C++ Parser implementation from Rust.
 struct FlatbuffersParser {
     flatbuffers::Parser impl;
     bool error;
-    std::unordered_set<std::string> string_cache;
+    StringArena strings;
+    std::vector<uint8_t> schema_export;
+    uint64_t parse_ns = 0;
+    uint64_t export_ns = 0;
+    uint64_t parse_peak_bytes = 0;
+    uint64_t parse_retained_bytes = 0;
+    struct {
+        bool built = false;
+        std::vector<const char*> files;
+        std::vector<struct IncludeEdge> edges;
+        std::vector<uint32_t> all_included;
+    } include_graph;
+    struct {
+        bool built = false;
+        std::vector<const char*> files;
+        std::vector<struct DiagnosticRecord> records;
+        std::vector<const char*> args;
+    } diagnostics;
+    struct {
+        bool built = false;
+        std::vector<uint32_t> data;
+    } semantic_tokens;
+
+    // Clears the results of the last parse, keeping the memory allocated for them.
+    void Reset() {
+        impl.Reset();
+        error = false;
+        parse_ns = 0;
+        parse_peak_bytes = 0;
+        parse_retained_bytes = 0;
+        ClearExports();
+    }
+
+    // Forgets what was exported from the last parse, for a parse that changed it.
+    void ClearExports() {
+        strings.Clear();
+        schema_export.clear();
+        export_ns = 0;
+        include_graph.built = false;
+        include_graph.files.clear();
+        include_graph.edges.clear();
+        include_graph.all_included.clear();
+        diagnostics.built = false;
+        diagnostics.files.clear();
+        diagnostics.records.clear();
+        diagnostics.args.clear();
+        semantic_tokens.built = false;
+        semantic_tokens.data.clear();
+    }
 };
 
-// Helper function to recursively build a type name
-std::string GetTypeName(const flatbuffers::Type& type) {
+// Parsers that were released for reuse, already reset. The pool only keeps as many
+// as were in use at once, up to kMaxIdle.
+class ParserPool {
+public:
+    ~ParserPool() {
+        for (auto parser : idle_) delete parser;
+    }
+
+    FlatbuffersParser* Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                auto parser = idle_.back();
+                idle_.pop_back();
+                return parser;
+            }
+        }
+        return new FlatbuffersParser();
+    }
+
+    void Release(FlatbuffersParser* parser) {
+        parser->Reset();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_.size() < kMaxIdle) {
+                idle_.push_back(parser);
+                return;
+            }
+        }
+        delete parser;
+    }
+
+    static ParserPool& Instance() {
+        static ParserPool pool;
+        return pool;
+    }
+
+private:
+    static const size_t kMaxIdle = 64;
+
+    std::mutex mutex_;
+    std::vector<FlatbuffersParser*> idle_;
+};
+
+// Runs batches of tasks on a fixed set of worker threads, with the calling thread
+// joining in. Each thread takes tasks from the front of its own queue and, once that
+// is empty, steals from the back of the others', so a few slow tasks don't hold up the
+// rest of a batch.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(size_t)>;
+
+    explicit WorkStealingPool(size_t num_threads) {
+        if (num_threads == 0) num_threads = 1;
+        for (size_t i = 0; i < num_threads; i++) queues_.emplace_back(new Queue());
+        // Queue 0 belongs to the thread calling Run.
+        for (size_t i = 1; i < num_threads; i++) {
+            threads_.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) thread.join();
+    }
+
+    // Calls task(i) for every i below count on the pool's threads, and returns once
+    // every call has. Batches from different callers run one after another.
+    void Run(size_t count, const Task& task) {
+        if (count == 0) return;
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            remaining_ = count;
+            batch_++;
+        }
+        for (size_t i = 0; i < count; i++) {
+            auto& queue = *queues_[i % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.items.push_back(Item{ &task, i });
+        }
+        wake_.notify_all();
+        Work(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return remaining_ == 0; });
+    }
+
+    size_t num_threads() const { return queues_.size(); }
+
+    // Shared by every batch parse, sized to the machine.
+    static WorkStealingPool& Instance() {
+        static WorkStealingPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+private:
+    // Items carry their batch's task, so a thread still finishing one batch can't
+    // run another's items with the wrong task.
+    struct Item {
+        const Task* task;
+        size_t index;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Item> items;
+    };
+
+    void WorkerLoop(size_t self) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || batch_ != seen; });
+                if (stopping_) return;
+                seen = batch_;
+            }
+            Work(self);
+        }
+    }
+
+    void Work(size_t self) {
+        Item item;
+        while (Take(self, &item)) {
+            (*item.task)(item.index);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--remaining_ == 0) done_.notify_all();
+        }
+    }
+
+    bool Take(size_t self, Item* item) {
+        {
+            auto& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.items.empty()) {
+                *item = own.items.front();
+                own.items.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); i++) {
+            auto& victim = *queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty()) {
+                *item = victim.items.back();
+                victim.items.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex run_mutex_;
+    std::mutex mutex_; // guards the members below
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t batch_ = 0;
+    size_t remaining_ = 0;
+    bool stopping_ = false;
+};
+
+// Definitions of previously parsed include files, keyed by the path the include
+// resolved to. An entry is only used while that file, and everything it includes,
+// still hashes to what was parsed.
+struct FlatbuffersIncludeCache {
+    struct Entry {
+        uint64_t hash;
+        std::shared_ptr<const flatbuffers::DefinitionSnapshot> snapshot;
+    };
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    // Every list of include paths parses have used, numbered in the order they were first.
+    std::unordered_map<std::string, size_t> search_path_sets;
+    // Where includes were resolved to, by the number of the include paths they were resolved
+    // with, the includer's directory and the name they include.
+    std::unordered_map<std::string, std::string> includes;
+};
+
+// Connects a single parse to a FlatbuffersIncludeCache.
+class IncludeCacheSession : public flatbuffers::IncludeCacheHook {
+public:
+    IncludeCacheSession(FlatbuffersIncludeCache* cache, const char* root_filename, const char** include_paths) : cache_(cache) {
+        if (root_filename) in_progress_.push_back(root_filename);
+        std::string search_paths;
+        for (auto paths = include_paths; paths && *paths; paths++) {
+            search_paths += *paths;
+            search_paths += '\0';
+        }
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        const auto set = cache_->search_path_sets.emplace(search_paths, cache_->search_path_sets.size()).first;
+        include_key_prefix_ = std::to_string(set->second) + '\0';
+    }
+
+    bool Lookup(flatbuffers::Parser& parser, const std::string& filename, uint64_t hash) override {
+        std::shared_ptr<const flatbuffers::DefinitionSnapshot> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(cache_->mutex);
+            auto it = cache_->entries.find(filename);
+            if (it != cache_->entries.end() && it->second.hash == hash) {
+                snapshot = it->second.snapshot;
+            }
+        }
+        if (snapshot && IsCurrent(parser, *snapshot, hash) && parser.Import(*snapshot)) {
+            return true;
+        }
+        in_progress_.push_back(filename);
+        return false;
+    }
+
+    void Store(const flatbuffers::Parser& parser, const std::string& filename, uint64_t hash) override {
+        if (!in_progress_.empty() && in_progress_.back() == filename) {
+            in_progress_.pop_back();
+        }
+        // Warnings are reported by the parse that produced them, so a file whose
+        // definitions were imported instead would lose them.
+        if (parser.has_warning_) return;
+
+        auto snapshot = std::make_shared<flatbuffers::DefinitionSnapshot>();
+        if (!parser.Snapshot(filename, snapshot.get())) return;
+        for (const auto& file : snapshot->files) {
+            // Part of an include cycle whose definitions aren't all parsed yet.
+            if (std::find(in_progress_.begin(), in_progress_.end(), file.filename) != in_progress_.end()) {
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        auto& entry = cache_->entries[filename];
+        entry.hash = hash;
+        entry.snapshot = snapshot;
+    }
+
+    bool LookupInclude(const std::string& directory, const std::string& name, std::string* filepath) override {
+        const std::string key = IncludeKey(directory, name);
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        auto it = cache_->includes.find(key);
+        if (it == cache_->includes.end()) return false;
+        *filepath = it->second;
+        return true;
+    }
+
+    void StoreInclude(const std::string& directory, const std::string& name, const std::string& filepath) override {
+        std::string key = IncludeKey(directory, name);
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        cache_->includes[std::move(key)] = filepath;
+    }
+
+private:
+    // Whether every file in the snapshot still has the contents it was parsed with.
+    static bool IsCurrent(const flatbuffers::Parser& parser, const flatbuffers::DefinitionSnapshot& snapshot, uint64_t hash) {
+        for (const auto& file : snapshot.files) {
+            if (file.hash == hash || parser.included_files_.count(file.hash)) continue;
+            uint64_t current = 0;
+            if (!parser.HashSource(file.filename, &current, nullptr) || current != file.hash) return false;
+        }
+        return true;
+    }
+
+    std::string IncludeKey(const std::string& directory, const std::string& name) const {
+        std::string key = include_key_prefix_;
+        key += directory;
+        key += '\0';
+        key += name;
+        return key;
+    }
+
+    FlatbuffersIncludeCache* cache_;
+    std::vector<std::string> in_progress_;
+    std::string include_key_prefix_; // the number of this parse's include paths
+};
+
+// Resolves paths to the virtual files passed to parse_schema_with_overlay. Included
+// paths are joined onto the includer's directory, so both sides are normalized
+// lexically (without touching the disk) before they are compared.
+class VirtualFileTable : public flatbuffers::FileOverlay {
+public:
+    VirtualFileTable(const VirtualFile* files, size_t num_files) {
+        for (size_t i = 0; i < num_files; i++) {
+            if (!files[i].path || (!files[i].contents && files[i].length)) continue;
+            files_[NormalizePath(files[i].path)] = &files[i];
+        }
+    }
+
+    bool Exists(const std::string& filename) const override {
+        return Find(filename) != nullptr;
+    }
+
+    bool Load(const std::string& filename, std::string* contents) const override {
+        auto file = Find(filename);
+        if (!file) return false;
+        contents->assign(file->contents ? file->contents : "", file->length);
+        return true;
+    }
+
+private:
+    const VirtualFile* Find(const std::string& filename) const {
+        if (files_.empty()) return nullptr;
+        auto it = files_.find(NormalizePath(filename));
+        return it == files_.end() ? nullptr : it->second;
+    }
+
+    // Collapses "." and ".." components and repeated separators.
+    static std::string NormalizePath(const std::string& path) {
+        auto posix_path = flatbuffers::PosixPath(path.c_str());
+        const bool absolute = !posix_path.empty() && posix_path[0] == '/';
+        std::vector<std::string> components;
+        size_t start = 0;
+        while (start <= posix_path.size()) {
+            auto end = posix_path.find('/', start);
+            if (end == std::string::npos) end = posix_path.size();
+            auto component = posix_path.substr(start, end - start);
+            if (component == "..") {
+                if (!components.empty() && components.back() != "..") {
+                    components.pop_back();
+                } else if (!absolute) {
+                    components.push_back(component);
+                }
+            } else if (!component.empty() && component != ".") {
+                components.push_back(component);
+            }
+            start = end + 1;
+        }
+        std::string normalized = absolute ? "/" : "";
+        for (size_t i = 0; i < components.size(); i++) {
+            if (i) normalized += '/';
+            normalized += components[i];
+        }
+        return normalized;
+    }
+
+    std::unordered_map<std::string, const VirtualFile*> files_;
+};
+
+// Appends the fully qualified display name of a type to out, e.g. "[a.b.Name:4]".
+void AppendTypeName(const flatbuffers::Type& type, std::string* out) {
     switch (type.base_type) {
         case flatbuffers::BASE_TYPE_STRUCT: {
             if (type.struct_def) {
-                if (type.struct_def->defined_namespace) {
-                    return type.struct_def->defined_namespace->GetFullyQualifiedName(type.struct_def->name);
-                }
-                return type.struct_def->name;
+                *out += type.struct_def->GetQualifiedName();
+                return;
             }
             break;
         }
         case flatbuffers::BASE_TYPE_UNION: {
             if (type.enum_def) {
-                if (type.enum_def->defined_namespace) {
-                    return type.enum_def->defined_namespace->GetFullyQualifiedName(type.enum_def->name);
-                }
-                return type.enum_def->name;
+                *out += type.enum_def->GetQualifiedName();
+                return;
             }
             break;
         }
         case flatbuffers::BASE_TYPE_VECTOR:
         case flatbuffers::BASE_TYPE_VECTOR64: {
-            return "[" + GetTypeName(type.VectorType()) + "]";
+            *out += '[';
+            AppendTypeName(type.VectorType(), out);
+            *out += ']';
+            return;
         }
         case flatbuffers::BASE_TYPE_ARRAY: {
-            return "[" + GetTypeName(type.VectorType()) + ":" + std::to_string(type.fixed_length) + "]";
+            *out += '[';
+            AppendTypeName(type.VectorType(), out);
+            *out += ':';
+            *out += std::to_string(type.fixed_length);
+            *out += ']';
+            return;
         }
         case flatbuffers::BASE_TYPE_UTYPE:
         case flatbuffers::BASE_TYPE_BOOL:
@@ -55,10 +639,8 @@ std::string GetTypeName(const flatbuffers::Type& type) {
         case flatbuffers::BASE_TYPE_LONG:
         case flatbuffers::BASE_TYPE_ULONG: {
             if (type.enum_def) {
-                if (type.enum_def->defined_namespace) {
-                    return type.enum_def->defined_namespace->GetFullyQualifiedName(type.enum_def->name);
-                }
-                return type.enum_def->name;
+                *out += type.enum_def->GetQualifiedName();
+                return;
             }
             break;
         }
@@ -69,387 +651,514 @@ std::string GetTypeName(const flatbuffers::Type& type) {
             break;
         }
     }
-    return flatbuffers::TypeName(type.base_type);
+    *out += flatbuffers::TypeName(type.base_type);
 }
 
-const char* join_doc_comments(const std::vector<std::string>& doc_comment, std::unordered_set<std::string>& string_cache) {
-    if (doc_comment.empty()) return "";
-
-    std::string full_doc;
+// Appends the lines of a doc comment to out, separated by newlines.
+void JoinDocComments(const std::vector<std::string>& doc_comment, std::string* out) {
     for (size_t i = 0; i < doc_comment.size(); ++i) {
-        full_doc += doc_comment[i];
+        *out += doc_comment[i];
         if (i < doc_comment.size() - 1) {
-            full_doc += "\n";
+            *out += "\n";
         }
     }
-
-    if (!full_doc.empty()) {
-        auto result = string_cache.insert(full_doc);
-        return result.first->c_str();
-    }
-    return "";
 }
 
-struct FlatbuffersParser* parse_schema(const char* schema_content, const char* filename, const char **include_paths) {
-    auto parser = new FlatbuffersParser();
-    parser->error = !parser->impl.Parse(schema_content, include_paths, filename ? filename : "");
-    return parser;
+const char* join_doc_comments(const std::vector<std::string>& doc_comment, StringArena& strings) {
+    if (doc_comment.empty()) return "";
+
+    std::string full_doc;
+    JoinDocComments(doc_comment, &full_doc);
+    return strings.Intern(full_doc).data;
 }
 
-void delete_parser(struct FlatbuffersParser* parser) {
-    if (parser) {
-        delete parser;
+// Lays out the definitions of a parser in the format described by SchemaExportHeader.
+class SchemaExporter {
+public:
+    SchemaExporter(const flatbuffers::Parser& parser, StringArena& strings) : parser_(parser), strings_(strings) {}
+
+    void Export(std::vector<uint8_t>* buffer) {
+        for (auto struct_def : parser_.structs_.vec) AddStruct(*struct_def);
+        for (auto enum_def : parser_.enums_.vec) AddEnum(*enum_def);
+        for (auto service_def : parser_.services_.vec) AddService(*service_def);
+        for (const auto& occurrence : parser_.occurrences_) AddOccurrence(occurrence);
+
+        struct SchemaExportHeader header = {};
+        header.version = SCHEMA_EXPORT_VERSION;
+        size_t size = sizeof(header);
+        header.structs = Layout(structs_, &size);
+        header.fields = Layout(fields_, &size);
+        header.enums = Layout(enums_, &size);
+        header.enum_vals = Layout(enum_vals_, &size);
+        header.rpc_services = Layout(rpc_services_, &size);
+        header.rpc_methods = Layout(rpc_methods_, &size);
+        header.occurrences = Layout(occurrences_, &size);
+        header.strings.offset = static_cast<uint32_t>(size);
+        header.strings.count = static_cast<uint32_t>(string_data_.size());
+        size += string_data_.size();
+        header.size = static_cast<uint32_t>(size);
+
+        buffer->assign(size, 0);
+        memcpy(buffer->data(), &header, sizeof(header));
+        Write(structs_, header.structs, buffer);
+        Write(fields_, header.fields, buffer);
+        Write(enums_, header.enums, buffer);
+        Write(enum_vals_, header.enum_vals, buffer);
+        Write(rpc_services_, header.rpc_services, buffer);
+        Write(rpc_methods_, header.rpc_methods, buffer);
+        Write(occurrences_, header.occurrences, buffer);
+        if (!string_data_.empty()) memcpy(buffer->data() + header.strings.offset, string_data_.data(), string_data_.size());
     }
-}
 
-const char* get_parser_error(struct FlatbuffersParser* parser) {
-    if (!parser) {
-        return "Invalid parser pointer.";
+private:
+    void AddStruct(const flatbuffers::StructDef& struct_def) {
+        struct_indices_.emplace(&struct_def, static_cast<uint32_t>(structs_.size()));
+        struct ExportedStruct info = {};
+        info.name = String(struct_def.name);
+        info.file = String(struct_def.file);
+        info.namespace_ = NamespaceString(struct_def.defined_namespace);
+        info.documentation = Doc(struct_def.doc_range);
+        info.is_table = !struct_def.fixed;
+        info.is_predeclared = struct_def.predecl;
+        info.line = struct_def.decl_line - 1; // parser line is 1-based
+        info.col = struct_def.decl_col;
+        info.bytesize = struct_def.bytesize;
+        info.minalign = struct_def.minalign;
+        info.first_field = static_cast<uint32_t>(fields_.size());
+        for (auto field_def : struct_def.fields.vec) {
+            if (IsUnionTypeField(*field_def)) continue;
+            AddField(*field_def);
+        }
+        info.num_fields = static_cast<uint32_t>(fields_.size()) - info.first_field;
+        structs_.push_back(info);
     }
-    return parser->impl.error_.c_str();
-}
 
-bool is_parser_success(struct FlatbuffersParser* parser) {
-    if (!parser) {
-        return false;
+    void AddField(const flatbuffers::FieldDef& field_def) {
+        struct ExportedField info = {};
+        info.name = String(field_def.name);
+        info.type_name = TypeNameString(field_def.value.type);
+
+        flatbuffers::Type type = field_def.value.type;
+        switch (type.base_type) {
+            case flatbuffers::BASE_TYPE_VECTOR:
+            case flatbuffers::BASE_TYPE_VECTOR64:
+            case flatbuffers::BASE_TYPE_ARRAY:
+                type = type.VectorType();
+                break;
+            default:
+                break;
+        }
+        info.base_type_name = TypeNameString(type);
+
+        info.documentation = Doc(field_def.doc_range);
+        info.line = field_def.decl_line - 1;
+        info.col = field_def.decl_col;
+        info.type_range = ToRange(field_def.value.type.decl_range);
+        info.type_source = String(field_def.value.type.decl_text);
+        info.deprecated = field_def.deprecated;
+
+        auto id_attr = field_def.attributes.Lookup("id");
+        if (id_attr) {
+            info.has_id = true;
+            info.id = std::stoi(id_attr->constant);
+        }
+        fields_.push_back(info);
     }
-    return !parser->error;
-}
 
-// Functions for structs and tables
-int get_num_structs(struct FlatbuffersParser* parser) {
-    if (!parser) return 0;
-    return static_cast<int>(parser->impl.structs_.vec.size());
-}
+    void AddEnum(const flatbuffers::EnumDef& enum_def) {
+        enum_indices_.emplace(&enum_def, static_cast<uint32_t>(enums_.size()));
+        struct ExportedEnum info = {};
+        info.name = String(enum_def.name);
+        info.file = String(enum_def.file);
+        info.namespace_ = NamespaceString(enum_def.defined_namespace);
+        info.documentation = Doc(enum_def.doc_range);
+        info.underlying_type = String(flatbuffers::TypeName(enum_def.underlying_type.base_type));
+        info.is_union = enum_def.is_union;
+        info.line = enum_def.decl_line - 1;
+        info.col = enum_def.decl_col;
+        info.first_val = static_cast<uint32_t>(enum_vals_.size());
+        for (auto enum_val : enum_def.Vals()) {
+            struct ExportedEnumVal val_info = {};
+            // Union variants are named by their fully-qualified type.
+            val_info.name = enum_def.is_union ? TypeNameString(enum_val->union_type) : String(enum_val->name);
+            val_info.documentation = Doc(enum_val->doc_range);
+            val_info.value = enum_val->GetAsInt64();
+            val_info.line = enum_val->decl_line - 1;
+            val_info.col = enum_val->decl_col;
+            val_info.type_range = ToRange(enum_val->decl_range);
+            val_info.type_source = String(enum_val->decl_text);
+            enum_vals_.push_back(val_info);
+        }
+        info.num_vals = static_cast<uint32_t>(enum_vals_.size()) - info.first_val;
+        enums_.push_back(info);
+    }
 
-struct StructDefinitionInfo get_struct_info(struct FlatbuffersParser* parser, int index) {
-    struct StructDefinitionInfo info = { nullptr, nullptr, nullptr, nullptr, false, 0, 0, 0, 0, false };
-    if (!parser || index < 0 || static_cast<size_t>(index) >= parser->impl.structs_.vec.size()) {
-        return info;
+    void AddService(const flatbuffers::ServiceDef& service_def) {
+        struct ExportedRpcService info = {};
+        info.name = String(service_def.name);
+        info.file = String(service_def.file);
+        info.namespace_ = NamespaceString(service_def.defined_namespace);
+        info.documentation = Doc(service_def.doc_range);
+        info.line = service_def.decl_line - 1;
+        info.col = service_def.decl_col;
+        info.first_method = static_cast<uint32_t>(rpc_methods_.size());
+        for (auto call_def : service_def.calls.vec) {
+            struct ExportedRpcMethod method_info = {};
+            method_info.name = String(call_def->name);
+            method_info.documentation = Doc(call_def->doc_range);
+            method_info.line = call_def->decl_line - 1;
+            method_info.col = call_def->decl_col;
+            method_info.request_type_name = String(call_def->request->GetQualifiedName());
+            method_info.request_range = ToRange(call_def->request_decl_range);
+            method_info.request_source = String(call_def->request_decl_text);
+            method_info.response_type_name = String(call_def->response->GetQualifiedName());
+            method_info.response_range = ToRange(call_def->response_decl_range);
+            method_info.response_source = String(call_def->response_decl_text);
+            rpc_methods_.push_back(method_info);
+        }
+        info.num_methods = static_cast<uint32_t>(rpc_methods_.size()) - info.first_method;
+        rpc_services_.push_back(info);
     }
-    auto struct_def = parser->impl.structs_.vec[static_cast<size_t>(index)];
-    info.name = struct_def->name.c_str();
-    info.file = struct_def->file.c_str();
 
-    if (struct_def->defined_namespace) {
-        std::string ns;
-        for (size_t i = 0; i < struct_def->defined_namespace->components.size(); ++i) {
-            if (i > 0) {
-                ns += ".";
-            }
-            ns += struct_def->defined_namespace->components[i];
+    // Targets are only used as keys, never dereferenced, and occurrences of anything that
+    // wasn't exported are left out.
+    void AddOccurrence(const flatbuffers::TypeOccurrence& occurrence) {
+        struct ExportedOccurrence info = {};
+        auto struct_it = struct_indices_.find(occurrence.target);
+        auto enum_it = enum_indices_.find(occurrence.target);
+        if (struct_it != struct_indices_.end()) {
+            info.target = struct_it->second;
+        } else if (enum_it != enum_indices_.end()) {
+            info.target = enum_it->second;
+            info.target_is_enum = true;
+        } else {
+            return;
         }
-        auto result = parser->string_cache.insert(ns);
-        info.namespace_ = result.first->c_str();
+        info.file = String(*occurrence.file);
+        info.range = ToRange(occurrence.range);
+        occurrences_.push_back(info);
     }
 
-    info.documentation = join_doc_comments(struct_def->doc_comment, parser->string_cache);
-    info.is_table = !struct_def->fixed;
-    info.line = struct_def->decl_line - 1;
-    info.col = struct_def->decl_col;
-    info.bytesize = struct_def->bytesize;
-    info.minalign = struct_def->minalign;
-    info.is_predeclared = struct_def->predecl;
-    return info;
-}
+    // Internal union _type fields are synthesized by the parser and not shown to users.
+    // Only they have the UTYPE base type, or element type for vectors of unions.
+    static bool IsUnionTypeField(const flatbuffers::FieldDef& field_def) {
+        const auto& type = field_def.value.type;
+        return type.base_type == flatbuffers::BASE_TYPE_UTYPE ||
+               (flatbuffers::IsVector(type) && type.element == flatbuffers::BASE_TYPE_UTYPE);
+    }
 
-// Functions for enums and unions
-int get_num_enums(struct FlatbuffersParser* parser) {
-    if (!parser) return 0;
-    return static_cast<int>(parser->impl.enums_.vec.size());
-}
+    static struct Range ToRange(const flatbuffers::SourceRange& range) {
+        struct Range result;
+        result.start.line = range.start.line - 1; // parser line is 1-based
+        result.start.col = range.start.col;
+        result.end.line = range.end.line - 1;
+        result.end.col = range.end.col;
+        return result;
+    }
 
-struct EnumDefinitionInfo get_enum_info(struct FlatbuffersParser* parser, int index) {
-    struct EnumDefinitionInfo info = { nullptr, nullptr, nullptr, nullptr, nullptr, false, 0, 0 };
-    if (!parser || index < 0 || static_cast<size_t>(index) >= parser->impl.enums_.vec.size()) {
-        return info;
+    struct ExportedString String(const char* s, size_t length) {
+        struct ExportedString result = { 0, 0 };
+        if (!length) return result;
+        auto interned = strings_.Intern(s, length);
+        if (interned.id >= string_offsets_.size()) {
+            string_offsets_.resize(interned.id + 1, static_cast<uint32_t>(kNoOffset));
+        }
+        if (string_offsets_[interned.id] == kNoOffset) {
+            string_offsets_[interned.id] = static_cast<uint32_t>(string_data_.size());
+            string_data_.append(interned.data, interned.length);
+        }
+        result.offset = string_offsets_[interned.id];
+        result.length = interned.length;
+        return result;
     }
-    auto enum_def = parser->impl.enums_.vec[static_cast<size_t>(index)];
-    info.name = enum_def->name.c_str();
-    info.file = enum_def->file.c_str();
 
-    if (enum_def->defined_namespace) {
-        std::string ns;
-        for (size_t i = 0; i < enum_def->defined_namespace->components.size(); ++i) {
+    struct ExportedString String(std::string_view s) { return String(s.data(), s.size()); }
+
+    // Namespaces are shared by many definitions, so each one is only joined once.
+    struct ExportedString NamespaceString(const flatbuffers::Namespace* ns) {
+        struct ExportedString result = { 0, 0 };
+        if (!ns) return result;
+        auto it = namespace_strings_.find(ns);
+        if (it != namespace_strings_.end()) return it->second;
+        scratch_.clear();
+        for (size_t i = 0; i < ns->components.size(); ++i) {
             if (i > 0) {
-                ns += ".";
+                scratch_ += ".";
             }
-            ns += enum_def->defined_namespace->components[i];
+            scratch_ += ns->components[i];
         }
-        auto result = parser->string_cache.insert(ns);
-        info.namespace_ = result.first->c_str();
+        result = String(scratch_);
+        namespace_strings_.emplace(ns, result);
+        return result;
     }
 
-    {
-        std::string underlying = flatbuffers::TypeName(enum_def->underlying_type.base_type);
-        auto result = parser->string_cache.insert(underlying);
-        info.underlying_type = result.first->c_str();
+    struct ExportedString TypeNameString(const flatbuffers::Type& type) {
+        scratch_.clear();
+        AppendTypeName(type, &scratch_);
+        return String(scratch_);
     }
 
-    info.documentation = join_doc_comments(enum_def->doc_comment, parser->string_cache);
-    info.is_union = enum_def->is_union;
-    info.line = enum_def->decl_line - 1;
-    info.col = enum_def->decl_col;
-    return info;
-}
-
-int get_num_enum_vals(struct FlatbuffersParser* parser, int enum_index) {
-    if (!parser || enum_index < 0 || static_cast<size_t>(enum_index) >= parser->impl.enums_.vec.size()) {
-        return 0;
+    // The parser only sets the range of a doc comment (lines are 1-based), and with lsp_mode
+    // keeps no text.
+    static struct ExportedDoc Doc(const flatbuffers::SourceRange& range) {
+        struct ExportedDoc doc = {};
+        if (range.end.line) doc.range = ToRange(range);
+        return doc;
     }
-    auto enum_def = parser->impl.enums_.vec[static_cast<size_t>(enum_index)];
-    return static_cast<int>(enum_def->Vals().size());
-}
 
-struct EnumValDefinitionInfo get_enum_val_info(struct FlatbuffersParser* parser, int enum_index, int val_index) {
-    struct EnumValDefinitionInfo info = { nullptr, nullptr, 0, 0, 0, {}, {}};
-    if (!parser || enum_index < 0 || static_cast<size_t>(enum_index) >= parser->impl.enums_.vec.size()) {
-        return info;
-    }
-    auto enum_def = parser->impl.enums_.vec[static_cast<size_t>(enum_index)];
-    if (val_index < 0 || static_cast<size_t>(val_index) >= enum_def->Vals().size()) {
-        return info;
-    }
-    auto enum_val = enum_def->Vals()[static_cast<size_t>(val_index)];
-    info.name = enum_val->name.c_str();
-    if (enum_def->is_union) {
-        std::string name = GetTypeName(enum_val->union_type);
-        auto result = parser->string_cache.insert(name);
-        info.name = result.first->c_str(); // fully-qualified name
-    }
+    static const uint32_t kNoOffset = 0xffffffffu;
 
-    info.documentation = join_doc_comments(enum_val->doc_comment, parser->string_cache);
-    info.value = enum_val->GetAsInt64();
-    info.line = enum_val->decl_line - 1;
-    info.col = enum_val->decl_col;
+    template <typename T>
+    static struct ExportedSection Layout(const std::vector<T>& records, size_t* size) {
+        *size = (*size + alignof(T) - 1) / alignof(T) * alignof(T);
+        struct ExportedSection section = { static_cast<uint32_t>(*size), static_cast<uint32_t>(records.size()) };
+        *size += records.size() * sizeof(T);
+        return section;
+    }
 
-    auto def_range = enum_val->decl_range;
-    info.type_range.start.line = def_range.start.line - 1; // parser line is 1-based
-    info.type_range.start.col = def_range.start.col;
-    info.type_range.end.line = def_range.end.line - 1;
-    info.type_range.end.col = def_range.end.col;
+    template <typename T>
+    static void Write(const std::vector<T>& records, const struct ExportedSection& section, std::vector<uint8_t>* buffer) {
+        if (records.empty()) return;
+        memcpy(buffer->data() + section.offset, records.data(), records.size() * sizeof(T));
+    }
 
-    info.type_source = enum_val->decl_text.c_str();
+    const flatbuffers::Parser& parser_;
+    std::vector<struct ExportedStruct> structs_;
+    std::vector<struct ExportedField> fields_;
+    std::vector<struct ExportedEnum> enums_;
+    std::vector<struct ExportedEnumVal> enum_vals_;
+    std::vector<struct ExportedRpcService> rpc_services_;
+    std::vector<struct ExportedRpcMethod> rpc_methods_;
+    std::vector<struct ExportedOccurrence> occurrences_;
+    std::unordered_map<const flatbuffers::Definition*, uint32_t> struct_indices_;
+    std::unordered_map<const flatbuffers::Definition*, uint32_t> enum_indices_;
+    StringArena& strings_;
+    std::string string_data_;
+    std::vector<uint32_t> string_offsets_; // in string_data_, by StringArena id
+    std::unordered_map<const flatbuffers::Namespace*, struct ExportedString> namespace_strings_;
+    std::string scratch_;
+};
 
-    return info;
+struct FlatbuffersParser* parse_schema(const char* schema_content, const char* filename, const char **include_paths) {
+    return parse_schema_with_cache(schema_content, filename, include_paths, nullptr);
 }
 
-bool has_root_type(struct FlatbuffersParser* parser) {
-    if (!parser) return false;
-    return parser->impl.root_struct_def_ != nullptr && parser->impl.root_type_loc_ != nullptr;;
+struct FlatbuffersParser* parse_schema_with_cache(const char* schema_content, const char* filename, const char **include_paths, struct FlatbuffersIncludeCache* cache) {
+    return parse_schema_with_overlay(schema_content, filename, include_paths, nullptr, 0, cache);
 }
 
-struct RootTypeDefinitionInfo get_root_type_info(struct FlatbuffersParser* parser) {
-    struct RootTypeDefinitionInfo info = { nullptr, nullptr, {}, nullptr};
-    if (!parser || !has_root_type(parser)) return info;
-    auto root_def = parser->impl.root_struct_def_;
+struct FlatbuffersParser* parse_schema_with_overlay(const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache) {
+    auto parser = new FlatbuffersParser();
+    parse_schema_into(parser, schema_content, filename, include_paths, files, num_files, cache);
+    return parser;
+}
 
-    info.name = root_def->name.c_str();
-    if (root_def->defined_namespace) {
-        std::string fqn = root_def->defined_namespace->GetFullyQualifiedName(root_def->name);
-        auto result = parser->string_cache.insert(fqn);
-        info.name = result.first->c_str();
+// The C API takes cancel flags as plain bools, which Parser reads atomically.
+static_assert(sizeof(std::atomic<bool>) == sizeof(bool) && std::atomic<bool>::is_always_lock_free,
+              "std::atomic<bool> must have the layout of bool");
+
+// Parses into parser like parse_schema_buffer. If cache_root is set, the definitions of
+// the schema itself are added to the cache as well, for the files that include it to import.
+static bool ParseInto(struct FlatbuffersParser* parser, const char* schema_content, size_t schema_length, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel, bool cache_root) {
+    parser->Reset();
+    // Report every broken declaration, and keep the definitions around them.
+    parser->impl.opts.recover_from_errors = true;
+    parser->impl.opts.collect_parse_stats = true;
+    parser->impl.opts.collect_semantic_tokens = true;
+    parser->impl.opts.lsp_mode = true;
+    std::unique_ptr<IncludeCacheSession> session;
+    if (cache) {
+        session.reset(new IncludeCacheSession(cache, filename, include_paths));
+        parser->impl.include_cache_ = session.get();
     }
-    info.file = parser->impl.root_type_loc_->filename_.c_str();
-
-    auto def_range = parser->impl.root_type_loc_->decl_range;
-    info.type_range.start.line = def_range.start.line - 1; // parser line is 1-based
-    info.type_range.start.col = def_range.start.col;
-    info.type_range.end.line = def_range.end.line - 1;
-    info.type_range.end.col = def_range.end.col;
-
-    info.type_source = parser->impl.root_type_loc_->decl_text.c_str();
-
-    return info;
+    VirtualFileTable overlay(files, num_files);
+    parser->impl.file_overlay_ = &overlay;
+    parser->impl.cancel_ = reinterpret_cast<const std::atomic<bool>*>(cancel);
+    AllocationMeter meter;
+    flatbuffers::PhaseTimer timer(&parser->parse_ns);
+    // The one copy of the schema, which the parser keeps since its definitions view it.
+    auto source = flatbuffers::MakeSourceText(schema_content ? std::string(schema_content, schema_length) : std::string());
+    parser->error = !parser->impl.ParseSource(std::move(source), include_paths, filename ? filename : "");
+    timer.Stop();
+    if (session && cache_root && !parser->error && filename) {
+        auto hash = parser->impl.included_file_hashes_.find(filename);
+        if (hash != parser->impl.included_file_hashes_.end()) {
+            session->Store(parser->impl, filename, hash->second);
+        }
+    }
+    meter.Stop(&parser->parse_peak_bytes, &parser->parse_retained_bytes);
+    parser->impl.include_cache_ = nullptr;
+    parser->impl.file_overlay_ = nullptr;
+    parser->impl.cancel_ = nullptr;
+    return !parser->error;
 }
 
-int get_num_all_included_files(struct FlatbuffersParser* parser) {
-    if (!parser) return 0;
-    int count = 0;
-    for (const auto& pair : parser->impl.files_included_per_file_) {
-        count += pair.second.size();
-    }
-    return count;
+bool parse_schema_into(struct FlatbuffersParser* parser, const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache) {
+    return parse_schema_cancellable(parser, schema_content, filename, include_paths, files, num_files, cache, nullptr);
 }
 
-const char* get_all_included_file_path(struct FlatbuffersParser* parser, int index) {
+bool parse_schema_cancellable(struct FlatbuffersParser* parser, const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel) {
+    if (!parser) return false;
+    return parse_schema_buffer(parser, schema_content, schema_content ? strlen(schema_content) : 0, filename, include_paths, files, num_files, cache, cancel);
+}
 
-    if (!parser) return "";
+bool parse_schema_buffer(struct FlatbuffersParser* parser, const char* schema_content, size_t schema_length, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel) {
+    if (!parser) return false;
+    return ParseInto(parser, schema_content, schema_length, filename, include_paths, files, num_files, cache, cancel, false);
+}
 
-    int current_index = 0;
-    for (const auto& pair : parser->impl.files_included_per_file_) {
-        for (const auto& included_file : pair.second) {
-            if (current_index == index) {
-                auto result = parser->string_cache.insert(included_file.filename);
-                return result.first->c_str();
-            }
-            current_index++;
-        }
-    }
-    return "";
+bool reparse_schema(struct FlatbuffersParser* parser, const char* schema_content, size_t schema_length, const struct VirtualFile* files, size_t num_files) {
+    if (!parser || !schema_content) return false;
+    VirtualFileTable overlay(files, num_files);
+    parser->impl.file_overlay_ = &overlay;
+    parser->parse_ns = 0;
+    AllocationMeter meter;
+    flatbuffers::PhaseTimer timer(&parser->parse_ns);
+    bool parsed = false;
+    const bool reparsed = parser->impl.ReparseTable(schema_content, schema_length, &parsed);
+    timer.Stop();
+    meter.Stop(&parser->parse_peak_bytes, &parser->parse_retained_bytes);
+    parser->impl.file_overlay_ = nullptr;
+    if (!reparsed) return false;
+    parser->error = !parsed;
+    parser->ClearExports();
+    return true;
 }
 
-// Functions for fields
-int get_num_fields(struct FlatbuffersParser* parser, int struct_index) {
-    if (!parser || struct_index < 0 || static_cast<size_t>(struct_index) >= parser->impl.structs_.vec.size()) {
-        return 0;
-    }
-    auto struct_def = parser->impl.structs_.vec[static_cast<size_t>(struct_index)];
-    return static_cast<int>(struct_def->fields.vec.size());
+struct FlatbuffersParser* acquire_parser(void) {
+    return ParserPool::Instance().Acquire();
 }
 
-struct FieldDefinitionInfo get_field_info(struct FlatbuffersParser* parser, int struct_index, int field_index) {
-    struct FieldDefinitionInfo info = { nullptr, nullptr, nullptr, nullptr, 0, 0, {}, nullptr, false, false, 0 };
-    if (!parser || struct_index < 0 || static_cast<size_t>(struct_index) >= parser->impl.structs_.vec.size()) {
-        return info;
-    }
-    auto struct_def = parser->impl.structs_.vec[static_cast<size_t>(struct_index)];
-    if (field_index < 0 || static_cast<size_t>(field_index) >= struct_def->fields.vec.size()) {
-        return info;
+void reset_parser(struct FlatbuffersParser* parser) {
+    if (parser) {
+        parser->Reset();
     }
-    auto field_def = struct_def->fields.vec[static_cast<size_t>(field_index)];
+}
 
-    // Filter out internal union _type fields.
-    if (field_def->name.length() > 5 && field_def->name.substr(field_def->name.length() - 5) == "_type") {
-        if (field_def->value.type.enum_def && field_def->value.type.enum_def->is_union) {
-            return info; // It's an internal union type field, skip it.
-        }
+void release_parser(struct FlatbuffersParser* parser) {
+    if (parser) {
+        ParserPool::Instance().Release(parser);
     }
+}
 
-    info.name = field_def->name.c_str();
+void parse_schemas_batch(const struct SchemaSource* sources, size_t num_sources, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel, ParsedSchemaCallback on_parsed, void* context) {
+    if (!sources || !on_parsed) return;
+    WorkStealingPool::Instance().Run(num_sources, [&](size_t i) {
+        auto parser = ParserPool::Instance().Acquire();
+        ParseInto(parser, sources[i].content, sources[i].length, sources[i].filename, include_paths, files, num_files, cache, cancel, sources[i].cache_definitions);
+        on_parsed(context, i, parser);
+        ParserPool::Instance().Release(parser);
+    });
+}
 
-    {
-        std::string type_name = GetTypeName(field_def->value.type);
-        auto result = parser->string_cache.insert(type_name);
-        info.type_name = result.first->c_str();
-    }
+struct FlatbuffersIncludeCache* create_include_cache(void) {
+    return new FlatbuffersIncludeCache();
+}
 
-    {
-        flatbuffers::Type type  = field_def->value.type;
-        switch (type.base_type) {
-            case flatbuffers::BASE_TYPE_VECTOR:
-            case flatbuffers::BASE_TYPE_VECTOR64:
-            case flatbuffers::BASE_TYPE_ARRAY: {
-                type = type.VectorType();
-            }
-            default:
-                break;
-        }
-        std::string type_name = GetTypeName(type);
-        auto result = parser->string_cache.insert(type_name);
-        info.base_type_name = result.first->c_str();
+void delete_include_cache(struct FlatbuffersIncludeCache* cache) {
+    if (cache) {
+        delete cache;
     }
+}
 
-    info.documentation = join_doc_comments(field_def->doc_comment, parser->string_cache);
-
-    info.line = field_def->decl_line - 1;
-    info.col = field_def->decl_col;
-    info.deprecated = field_def->deprecated;
-
-    auto def_range = field_def->value.type.decl_range;
-    info.type_range.start.line = def_range.start.line - 1; // parser line is 1-based
-    info.type_range.start.col = def_range.start.col;
-    info.type_range.end.line = def_range.end.line - 1;
-    info.type_range.end.col = def_range.end.col;
-
-    info.type_source = field_def->value.type.decl_text.c_str();
+void forget_include_resolutions(struct FlatbuffersIncludeCache* cache) {
+    if (!cache) return;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->includes.clear();
+}
 
-    auto id_attr = field_def->attributes.Lookup("id");
-    if (id_attr) {
-        info.has_id = true;
-        info.id = std::stoi(id_attr->constant);
+void delete_parser(struct FlatbuffersParser* parser) {
+    if (parser) {
+        delete parser;
     }
-
-    return info;
 }
 
-// Functions for RPC services
-int get_num_rpc_services(struct FlatbuffersParser* parser) {
-    if (!parser) return 0;
-    return static_cast<int>(parser->impl.services_.vec.size());
+const char* get_parser_error(struct FlatbuffersParser* parser) {
+    if (!parser) {
+        return "Invalid parser pointer.";
+    }
+    return parser->impl.ErrorText().c_str();
 }
 
-struct RpcServiceDefinitionInfo get_rpc_service_info(struct FlatbuffersParser* parser, int index) {
-    struct RpcServiceDefinitionInfo info = { nullptr, nullptr, nullptr, nullptr, 0, 0 };
-    if (!parser || index < 0 || static_cast<size_t>(index) >= parser->impl.services_.vec.size()) {
-        return info;
+bool is_parser_success(struct FlatbuffersParser* parser) {
+    if (!parser) {
+        return false;
     }
-    auto service_def = parser->impl.services_.vec[static_cast<size_t>(index)];
-    info.name = service_def->name.c_str();
-    info.file = service_def->file.c_str();
+    return !parser->error;
+}
 
-    if (service_def->defined_namespace) {
-        std::string ns;
-        for (size_t i = 0; i < service_def->defined_namespace->components.size(); ++i) {
-            if (i > 0) {
-                ns += ".";
-            }
-            ns += service_def->defined_namespace->components[i];
-        }
-        auto result = parser->string_cache.insert(ns);
-        info.namespace_ = result.first->c_str();
+bool is_parser_cancelled(struct FlatbuffersParser* parser) {
+    if (!parser) {
+        return false;
     }
-
-    info.documentation = join_doc_comments(service_def->doc_comment, parser->string_cache);
-    info.line = service_def->decl_line - 1;
-    info.col = service_def->decl_col;
-    return info;
+    return parser->impl.cancelled_;
 }
 
-// Functions for RPC methods
-int get_num_rpc_methods(struct FlatbuffersParser* parser, int service_index) {
-    if (!parser || service_index < 0 || static_cast<size_t>(service_index) >= parser->impl.services_.vec.size()) {
+uint64_t get_bytes_scanned(struct FlatbuffersParser* parser) {
+    if (!parser) {
         return 0;
     }
-    auto service_def = parser->impl.services_.vec[static_cast<size_t>(service_index)];
-    return static_cast<int>(service_def->calls.vec.size());
+    return parser->impl.bytes_scanned_;
 }
 
-struct RpcMethodDefinitionInfo get_rpc_method_info(struct FlatbuffersParser* parser, int service_index, int method_index) {
-    struct RpcMethodDefinitionInfo info = { nullptr, nullptr, 0, 0, nullptr, {}, nullptr, nullptr, {}, nullptr };
+struct ParseStats get_parse_stats(struct FlatbuffersParser* parser) {
+    struct ParseStats stats = {};
+    if (!parser) return stats;
+    const auto& impl_stats = parser->impl.stats_;
+    stats.parse_ns = parser->parse_ns;
+    stats.start_parse_file_ns = impl_stats.start_parse_file_ns;
+    stats.include_resolve_ns = impl_stats.include_resolve_ns;
+    stats.declarations_ns = impl_stats.declarations_ns;
+    stats.check_clash_ns = impl_stats.check_clash_ns;
+    stats.checks_ns = impl_stats.checks_ns;
+    stats.export_ns = parser->export_ns;
+    stats.tokens = impl_stats.tokens;
+    stats.bytes_scanned = parser->impl.bytes_scanned_;
+    stats.includes_parsed = impl_stats.includes_parsed;
+    stats.include_cache_hits = impl_stats.include_cache_hits;
+    stats.include_cache_misses = impl_stats.include_cache_misses;
+    stats.peak_bytes = parser->parse_peak_bytes;
+    stats.retained_bytes = parser->parse_retained_bytes;
+    return stats;
+}
 
-    if (!parser || service_index < 0 || static_cast<size_t>(service_index) >= parser->impl.services_.vec.size()) {
-        return info;
-    }
-    auto service_def = parser->impl.services_.vec[static_cast<size_t>(service_index)];
-    if (method_index < 0 || static_cast<size_t>(method_index) >= service_def->calls.vec.size()) {
-        return info;
+size_t export_schema(struct FlatbuffersParser* parser, const uint8_t** out_buffer) {
+    if (!out_buffer) return 0;
+    *out_buffer = nullptr;
+    if (!parser) return 0;
+    if (parser->schema_export.empty()) {
+        flatbuffers::PhaseTimer timer(&parser->export_ns);
+        SchemaExporter(parser->impl, parser->strings).Export(&parser->schema_export);
     }
-    flatbuffers::RPCCall *call_def = service_def->calls.vec[static_cast<size_t>(method_index)];
-
-    info.name = call_def->name.c_str();
-    info.documentation = join_doc_comments(call_def->doc_comment, parser->string_cache);
-
-    info.line = call_def->decl_line - 1;
-    info.col = call_def->decl_col;
+    *out_buffer = parser->schema_export.data();
+    return parser->schema_export.size();
+}
 
-    {
-        std::string fqn = call_def->request->defined_namespace->GetFullyQualifiedName(call_def->request->name);
-        auto result = parser->string_cache.insert(fqn);
-        info.request_type_name = result.first->c_str();
-    }
+uint64_t get_string_allocation_count(struct FlatbuffersParser* parser) {
+    if (!parser) return 0;
+    return parser->strings.allocations();
+}
 
-    auto req_range = call_def->request_decl_range;
-    info.request_range.start.line = req_range.start.line - 1; // parser line is 1-based
-    info.request_range.start.col = req_range.start.col;
-    info.request_range.end.line = req_range.end.line - 1;
-    info.request_range.end.col = req_range.end.col;
+bool has_root_type(struct FlatbuffersParser* parser) {
+    if (!parser) return false;
+    return parser->impl.root_struct_def_ != nullptr && parser->impl.root_type_loc_ != nullptr;;
+}
 
-    info.request_source = call_def->request_decl_text.c_str();
+struct RootTypeDefinitionInfo get_root_type_info(struct FlatbuffersParser* parser) {
+    struct RootTypeDefinitionInfo info = { nullptr, nullptr, {}, nullptr};
+    if (!parser || !has_root_type(parser)) return info;
+    auto root_def = parser->impl.root_struct_def_;
 
-    {
-        std::string fqn = call_def->response->defined_namespace->GetFullyQualifiedName(call_def->response->name);
-        auto result = parser->string_cache.insert(fqn);
-        info.response_type_name = result.first->c_str();
-    }
+    info.name = root_def->GetQualifiedName().c_str();
+    info.file = parser->impl.root_type_loc_->filename_.c_str();
 
-    auto resp_range = call_def->response_decl_range;
-    info.response_range.start.line = resp_range.start.line - 1; // parser line is 1-based
-    info.response_range.start.col = resp_range.start.col;
-    info.response_range.end.line = resp_range.end.line - 1;
-    info.response_range.end.col = resp_range.end.col;
+    auto def_range = parser->impl.root_type_loc_->decl_range;
+    info.type_range.start.line = def_range.start.line - 1; // parser line is 1-based
+    info.type_range.start.col = def_range.start.col;
+    info.type_range.end.line = def_range.end.line - 1;
+    info.type_range.end.col = def_range.end.col;
 
-    info.response_source = call_def->response_decl_text.c_str();
+    info.type_source = parser->strings.Intern(parser->impl.root_type_loc_->decl_text).data;
 
     return info;
 }
@@ -472,8 +1181,7 @@ const char* get_user_defined_attribute(struct FlatbuffersParser* parser, int ind
     for (const auto& attr : parser->impl.known_attributes_) {
         if (!attr.second) { // `false` indicates a user-defined attribute
             if (current_index == index) {
-                auto result = parser->string_cache.insert(attr.first);
-                return result.first->c_str();
+                return attr.first.c_str();
             }
             current_index++;
         }
@@ -485,51 +1193,152 @@ const char* get_user_defined_attribute_doc(struct FlatbuffersParser* parser, con
     if (!parser || !name) return "";
     auto it = parser->impl.user_attribute_docs_.find(name);
     if (it != parser->impl.user_attribute_docs_.end()) {
-        return join_doc_comments(it->second, parser->string_cache);
+        return join_doc_comments(it->second, parser->strings);
     }
     return "";
 }
 
-// Functions for include graph
-int get_num_files_with_includes(struct FlatbuffersParser* parser) {
-    if (!parser) return 0;
-    return static_cast<int>(parser->impl.files_included_per_file_.size());
+struct IncludeGraph get_include_graph(struct FlatbuffersParser* parser) {
+    struct IncludeGraph graph = { nullptr, 0, nullptr, 0, nullptr, 0 };
+    if (!parser) return graph;
+    auto& data = parser->include_graph;
+    if (!data.built) {
+        // The names point into files_included_per_file_, which outlives the graph.
+        std::unordered_map<std::string, uint32_t> file_indices;
+        auto index_of = [&](const std::string& filename) {
+            auto inserted = file_indices.emplace(filename, static_cast<uint32_t>(data.files.size()));
+            if (inserted.second) data.files.push_back(filename.c_str());
+            return inserted.first->second;
+        };
+        std::vector<bool> is_included;
+        for (const auto& pair : parser->impl.files_included_per_file_) {
+            auto from = index_of(pair.first);
+            for (const auto& included_file : pair.second) {
+                auto to = index_of(included_file.filename);
+                data.edges.push_back({ from, to });
+                if (is_included.size() <= to) is_included.resize(to + 1, false);
+                if (!is_included[to]) {
+                    is_included[to] = true;
+                    data.all_included.push_back(to);
+                }
+            }
+        }
+        data.built = true;
+    }
+    graph.files = data.files.data();
+    graph.num_files = data.files.size();
+    graph.edges = data.edges.data();
+    graph.num_edges = data.edges.size();
+    graph.all_included = data.all_included.data();
+    graph.num_all_included = data.all_included.size();
+    return graph;
 }
 
-const char* get_file_with_includes_path(struct FlatbuffersParser* parser, int index) {
-    if (!parser) return "";
-
-    int current_index = 0;
-    for (const auto& pair : parser->impl.files_included_per_file_) {
-        if (current_index == index) {
-            auto result = parser->string_cache.insert(pair.first);
-            return result.first->c_str();
+// The SEMANTIC_TOKEN_ kind of a token, or -1 if it shouldn't be sent. kinds holds the
+// SEMANTIC_TOKEN_ kind of each definition a type can name.
+static int SemanticTokenKind(const flatbuffers::SemanticToken& token, const std::unordered_map<const flatbuffers::Definition*, uint32_t>& kinds) {
+    using flatbuffers::SemanticToken;
+    switch (token.kind) {
+        case SemanticToken::kUnclassified: return -1;
+        case SemanticToken::kKeyword: return SEMANTIC_TOKEN_KEYWORD;
+        case SemanticToken::kNamespace: return SEMANTIC_TOKEN_NAMESPACE;
+        case SemanticToken::kType: {
+            // Targets are only used as keys, never dereferenced.
+            auto it = token.target ? kinds.find(token.target) : kinds.end();
+            return it != kinds.end() ? static_cast<int>(it->second) : SEMANTIC_TOKEN_TYPE;
         }
-        current_index++;
+        case SemanticToken::kEnumMember: return SEMANTIC_TOKEN_ENUM_MEMBER;
+        case SemanticToken::kField: return SEMANTIC_TOKEN_FIELD;
+        case SemanticToken::kAttribute: return SEMANTIC_TOKEN_ATTRIBUTE;
+        case SemanticToken::kService: return SEMANTIC_TOKEN_SERVICE;
+        case SemanticToken::kMethod: return SEMANTIC_TOKEN_METHOD;
+        case SemanticToken::kString: return SEMANTIC_TOKEN_STRING;
+        case SemanticToken::kNumber: return SEMANTIC_TOKEN_NUMBER;
     }
-    return "";
+    return -1;
 }
 
-int get_num_includes_for_file(struct FlatbuffersParser* parser, const char* file_path) {
-    if (!parser || !file_path) return 0;
-    auto it = parser->impl.files_included_per_file_.find(file_path);
-    if (it != parser->impl.files_included_per_file_.end()) {
-        return static_cast<int>(it->second.size());
+struct SemanticTokens get_semantic_tokens(struct FlatbuffersParser* parser) {
+    struct SemanticTokens tokens = { nullptr, 0 };
+    if (!parser) return tokens;
+    auto& data = parser->semantic_tokens;
+    if (!data.built) {
+        const auto& impl = parser->impl;
+        std::unordered_map<const flatbuffers::Definition*, uint32_t> kinds;
+        for (auto struct_def : impl.structs_.vec) {
+            // A predeclared struct is a type that was never defined.
+            if (!struct_def->predecl) kinds.emplace(struct_def, struct_def->fixed ? SEMANTIC_TOKEN_STRUCT : SEMANTIC_TOKEN_TABLE);
+        }
+        for (auto enum_def : impl.enums_.vec) {
+            kinds.emplace(enum_def, enum_def->is_union ? SEMANTIC_TOKEN_UNION : SEMANTIC_TOKEN_ENUM);
+        }
+        data.data.reserve(impl.semantic_tokens_.size() * 5);
+        // parser line is 1-based
+        int32_t line = 1;
+        int32_t col = 0;
+        for (const auto& token : impl.semantic_tokens_) {
+            const int kind = SemanticTokenKind(token, kinds);
+            if (kind < 0) continue;
+            uint32_t modifiers = 0;
+            if (token.modifiers & flatbuffers::SemanticToken::kDeclaration) modifiers |= SEMANTIC_TOKEN_MODIFIER_DECLARATION;
+            if (token.modifiers & flatbuffers::SemanticToken::kDeprecated) modifiers |= SEMANTIC_TOKEN_MODIFIER_DEPRECATED;
+            if (token.modifiers & flatbuffers::SemanticToken::kBuiltin) modifiers |= SEMANTIC_TOKEN_MODIFIER_DEFAULT_LIBRARY;
+            data.data.push_back(static_cast<uint32_t>(token.start.line - line));
+            data.data.push_back(static_cast<uint32_t>(token.start.line == line ? token.start.col - col : token.start.col));
+            data.data.push_back(static_cast<uint32_t>(token.length));
+            data.data.push_back(static_cast<uint32_t>(kind));
+            data.data.push_back(modifiers);
+            line = token.start.line;
+            col = token.start.col;
+        }
+        data.built = true;
     }
-    return 0;
+    tokens.data = data.data.data();
+    tokens.length = data.data.size();
+    return tokens;
 }
 
-const char* get_included_file_path(struct FlatbuffersParser* parser, const char* file_path, int index) {
-    if (!parser || !file_path) return "";
-
-    auto it = parser->impl.files_included_per_file_.find(file_path);
-    if (it != parser->impl.files_included_per_file_.end()) {
-        if (index >= 0 && static_cast<size_t>(index) < it->second.size()) {
-            auto set_it = it->second.begin();
-            std::advance(set_it, index);
-            auto result = parser->string_cache.insert(set_it->filename);
-            return result.first->c_str();
+struct Diagnostics get_diagnostics(struct FlatbuffersParser* parser) {
+    struct Diagnostics diagnostics = { nullptr, 0, nullptr, 0 };
+    if (!parser) return diagnostics;
+    auto& data = parser->diagnostics;
+    if (!data.built) {
+        // The strings point into the parser's diagnostics, which outlive these arrays.
+        for (const auto& file : parser->impl.diagnostic_files_) {
+            data.files.push_back(file.c_str());
         }
+        std::vector<size_t> first_args;
+        for (const auto& diagnostic : parser->impl.diagnostics_) {
+            struct DiagnosticRecord record = {};
+            record.severity = diagnostic.severity == flatbuffers::ParserDiagnostic::kError ? DIAGNOSTIC_ERROR : DIAGNOSTIC_WARNING;
+            record.kind = static_cast<uint32_t>(diagnostic.kind);
+            record.file = static_cast<uint32_t>(diagnostic.file);
+            record.line = static_cast<unsigned>(diagnostic.line);
+            record.col = static_cast<unsigned>(diagnostic.col);
+            const auto& range = diagnostic.range;
+            record.has_range = range.start.line > 0;
+            if (record.has_range) {
+                // parser line is 1-based
+                record.range.start = { static_cast<unsigned>(range.start.line - 1), static_cast<unsigned>(range.start.col) };
+                record.range.end = { static_cast<unsigned>(range.end.line - 1), static_cast<unsigned>(range.end.col) };
+            }
+            record.message = diagnostic.message.c_str();
+            record.num_args = diagnostic.args.size();
+            first_args.push_back(data.args.size());
+            for (const auto& arg : diagnostic.args) {
+                data.args.push_back(arg.c_str());
+            }
+            data.records.push_back(record);
+        }
+        // Only point into args once it has stopped growing.
+        for (size_t i = 0; i < data.records.size(); i++) {
+            if (data.records[i].num_args) data.records[i].args = &data.args[first_args[i]];
+        }
+        data.built = true;
     }
-    return "";
+    diagnostics.files = data.files.data();
+    diagnostics.num_files = data.files.size();
+    diagnostics.records = data.records.data();
+    diagnostics.num_records = data.records.size();
+    return diagnostics;
 }
@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,6 +11,9 @@ extern "C" {
 // Opaque pointer to the flatbuffers::Parser
 struct FlatbuffersParser;
 
+// Opaque pointer to a cache of parsed include files that is shared between parses
+struct FlatbuffersIncludeCache;
+
 struct Position {
     unsigned line, col; // 0-based
 };
@@ -17,56 +21,131 @@ struct Range {
     struct Position start, end; // 0-based
 };
 
-// A struct to pass struct/table definition information
-struct StructDefinitionInfo {
-    const char* name;
-    const char* file;
-    const char* namespace_;
-    const char* documentation;
+// Bumped whenever the layout of the export_schema buffer changes.
+#define SCHEMA_EXPORT_VERSION 3
+
+// A string in the strings section of a schema export. Not null-terminated; empty if length is 0.
+struct ExportedString {
+    uint32_t offset; // from the start of the strings section
+    uint32_t length;
+};
+
+// Where a definition's doc comment is in the file it is defined in, so that it can be read
+// from the source when it is shown rather than copied out of every parse. The range is
+// empty (all zero) if there is no doc comment.
+struct ExportedDoc {
+    struct Range range; // from the first comment's "//" to the end of the last one
+};
+
+// A run of records in a schema export.
+struct ExportedSection {
+    uint32_t offset; // from the start of the export, aligned for the record type
+    uint32_t count;  // of records, or of bytes for the strings section
+};
+
+// The start of the buffer returned by export_schema.
+struct SchemaExportHeader {
+    uint32_t version; // SCHEMA_EXPORT_VERSION
+    uint32_t size;    // of the whole buffer, in bytes
+    struct ExportedSection structs;      // struct ExportedStruct
+    struct ExportedSection fields;       // struct ExportedField, grouped by struct
+    struct ExportedSection enums;        // struct ExportedEnum
+    struct ExportedSection enum_vals;    // struct ExportedEnumVal, grouped by enum
+    struct ExportedSection rpc_services; // struct ExportedRpcService
+    struct ExportedSection rpc_methods;  // struct ExportedRpcMethod, grouped by service
+    struct ExportedSection occurrences;  // struct ExportedOccurrence, in parse order
+    struct ExportedSection strings;
+};
+
+// A struct or table definition
+struct ExportedStruct {
+    struct ExportedString name;
+    struct ExportedString file;
+    struct ExportedString namespace_;
+    struct ExportedDoc documentation;
     bool is_table;
+    bool is_predeclared;
     unsigned line;
     unsigned col;
     size_t bytesize; // struct only
     size_t minalign; // struct only
-    bool is_predeclared;
+    uint32_t first_field; // index into the fields section
+    uint32_t num_fields;
 };
 
-// A struct to pass enum/union definition information
-struct EnumDefinitionInfo {
-    const char* name;
-    const char* file;
-    const char* namespace_;
-    const char* documentation;
-    const char* underlying_type;
+// A field of a struct or table. Internal union _type fields are left out.
+struct ExportedField {
+    struct ExportedString name;
+    struct ExportedString type_name;      // fully qualified display name, including vector/array symbols
+    struct ExportedString base_type_name; // fully qualified name of the type or the vector/array's element type
+    struct ExportedDoc documentation;
+    unsigned line;
+    unsigned col;
+    struct Range type_range;
+    struct ExportedString type_source; // text of the type declaration
+    bool deprecated;
+    bool has_id;
+    int id;
+};
+
+// An enum or union definition
+struct ExportedEnum {
+    struct ExportedString name;
+    struct ExportedString file;
+    struct ExportedString namespace_;
+    struct ExportedDoc documentation;
+    struct ExportedString underlying_type;
     bool is_union;
     unsigned line;
     unsigned col;
+    uint32_t first_val; // index into the enum_vals section
+    uint32_t num_vals;
 };
 
-// A struct to pass enum value information
-struct EnumValDefinitionInfo {
-    const char* name;
-    const char* documentation;
+// An enum value or union variant
+struct ExportedEnumVal {
+    struct ExportedString name; // fully qualified type name for union variants
+    struct ExportedDoc documentation;
     long long value;
     unsigned line;
     unsigned col;
     struct Range type_range;
-    const char* type_source; // text of the type declaration
+    struct ExportedString type_source; // text of the type declaration
 };
 
-// A struct to pass field information
-struct FieldDefinitionInfo {
-    const char* name;
-    const char* type_name;      // fully qualified display name, including vectory/array symbols
-    const char* base_type_name; // fully qualified name of the type or the vector/array's element type
-    const char* documentation;
+// An rpc_service definition
+struct ExportedRpcService {
+    struct ExportedString name;
+    struct ExportedString file;
+    struct ExportedString namespace_;
+    struct ExportedDoc documentation;
     unsigned line;
     unsigned col;
-    struct Range type_range;
-    const char* type_source; // text of the type declaration
-    bool deprecated;
-    bool has_id;
-    int id;
+    uint32_t first_method; // index into the rpc_methods section
+    uint32_t num_methods;
+};
+
+// A method of an rpc_service
+struct ExportedRpcMethod {
+    struct ExportedString name;
+    struct ExportedDoc documentation;
+    unsigned line;
+    unsigned col;
+    struct ExportedString request_type_name; // fully qualified name of the type
+    struct Range request_range;
+    struct ExportedString request_source; // text of the type declaration
+    struct ExportedString response_type_name; // fully qualified name of the type
+    struct Range response_range;
+    struct ExportedString response_source; // text of the type declaration
+};
+
+// A reference to a struct, table, enum or union by name: a field or rpc type, a union
+// variant, a nested_flatbuffer attribute or a root_type.
+struct ExportedOccurrence {
+    struct ExportedString file;
+    struct Range range;    // of the last component of the name
+    uint32_t target;       // index into the structs section, or the enums section if target_is_enum
+    bool target_is_enum;
 };
 
 struct RootTypeDefinitionInfo {
@@ -76,82 +155,230 @@ struct RootTypeDefinitionInfo {
     const char* type_source; // text of the type declaration
 };
 
-struct RpcServiceDefinitionInfo {
-    const char* name;
-    const char* file;
-    const char* namespace_;
-    const char* documentation;
-    unsigned line;
-    unsigned col;
+// A direct include: files[from] includes files[to].
+struct IncludeEdge {
+    uint32_t from;
+    uint32_t to;
 };
 
-struct RpcMethodDefinitionInfo {
-    const char* name;
-    const char* documentation;
-    unsigned line;
-    unsigned col;
-    const char* request_type_name; // fully qualified name of the type
-    struct Range request_range;
-    const char* request_source; // text of the type declaration
-    const char* response_type_name; // fully qualified name of the type
-    struct Range response_range;
-    const char* response_source; // text of the type declaration
+// The files of a parse and the includes between them, as indices into files.
+struct IncludeGraph {
+    const char* const* files; // the parsed schema and everything it includes, transitively
+    size_t num_files;
+    const struct IncludeEdge* edges; // grouped by including file
+    size_t num_edges;
+    const uint32_t* all_included; // every file that some file includes, once each
+    size_t num_all_included;
+};
+
+#define DIAGNOSTIC_ERROR 0
+#define DIAGNOSTIC_WARNING 1
+
+// The kinds of diagnostic worth telling apart, with what each puts in its args.
+#define DIAGNOSTIC_GENERIC 0              // no args
+#define DIAGNOSTIC_DUPLICATE_DEFINITION 1 // name, previous file, previous line, previous col
+#define DIAGNOSTIC_EXPECTING_TOKEN 2      // expected token, found token
+#define DIAGNOSTIC_UNDEFINED_TYPE 3       // type name
+#define DIAGNOSTIC_NON_SNAKE_CASE 4       // field name
+#define DIAGNOSTIC_CANCELLED 5            // no args
+#define DIAGNOSTIC_UNRESOLVED_INCLUDE 6   // include name
+
+// A warning or error reported by the parser.
+struct DiagnosticRecord {
+    uint32_t severity; // DIAGNOSTIC_ERROR or DIAGNOSTIC_WARNING
+    uint32_t kind;     // one of the DIAGNOSTIC_ kinds
+    uint32_t file;     // index into Diagnostics.files
+    unsigned line;     // 1-based, where the parser was
+    unsigned col;      // cursor position in that line
+    bool has_range;
+    struct Range range; // of what the diagnostic is about, if has_range
+    const char* message;
+    const char* const* args;
+    size_t num_args;
+};
+
+// The diagnostics of a parse, in the order they were reported.
+struct Diagnostics {
+    const char* const* files; // absolute paths, or empty if no file was being parsed
+    size_t num_files;
+    const struct DiagnosticRecord* records;
+    size_t num_records;
+};
+
+// The kinds of semantic token, in the order of the legend a client is sent.
+#define SEMANTIC_TOKEN_KEYWORD 0
+#define SEMANTIC_TOKEN_NAMESPACE 1
+#define SEMANTIC_TOKEN_TYPE 2 // a scalar or string, or a type that isn't defined
+#define SEMANTIC_TOKEN_STRUCT 3
+#define SEMANTIC_TOKEN_TABLE 4
+#define SEMANTIC_TOKEN_ENUM 5
+#define SEMANTIC_TOKEN_UNION 6
+#define SEMANTIC_TOKEN_ENUM_MEMBER 7 // an enum value, union variant alias or enum default
+#define SEMANTIC_TOKEN_FIELD 8
+#define SEMANTIC_TOKEN_ATTRIBUTE 9
+#define SEMANTIC_TOKEN_SERVICE 10
+#define SEMANTIC_TOKEN_METHOD 11
+#define SEMANTIC_TOKEN_STRING 12
+#define SEMANTIC_TOKEN_NUMBER 13
+
+// Flags for the modifiers of a semantic token, in the order of the legend a client is sent.
+#define SEMANTIC_TOKEN_MODIFIER_DECLARATION 1
+#define SEMANTIC_TOKEN_MODIFIER_DEPRECATED 2
+#define SEMANTIC_TOKEN_MODIFIER_DEFAULT_LIBRARY 4 // scalars and string
+
+// The semantic tokens of the parsed schema itself, in the LSP wire layout: five values per
+// token, which are its line relative to the previous token's, its start column relative to
+// the previous token's if they are on the same line, its length in bytes, one of the
+// SEMANTIC_TOKEN_ kinds and its SEMANTIC_TOKEN_MODIFIER_ flags.
+struct SemanticTokens {
+    const uint32_t* data;
+    size_t length; // of data, five times the number of tokens
+};
+
+// Where a parse spent its time, in nanoseconds, how much work it did and how much of the
+// C++ heap it took, in bytes. The phases nest: parse_ns covers the others except export_ns,
+// and declarations_ns covers check_clash_ns.
+struct ParseStats {
+    uint64_t parse_ns;            // the whole parse
+    uint64_t start_parse_file_ns; // setting up the lexer for each file
+    uint64_t include_resolve_ns;  // locating and loading include files
+    uint64_t declarations_ns;     // parsing top-level declarations
+    uint64_t check_clash_ns;      // checking fields for name clashes
+    uint64_t checks_ns;           // the checks once every file is parsed
+    uint64_t export_ns;           // export_schema
+    uint64_t tokens;
+    uint64_t bytes_scanned;
+    uint64_t includes_parsed;
+    uint64_t include_cache_hits;
+    uint64_t include_cache_misses;
+    // The memory figures are 0 unless built with the parse-memory-stats feature.
+    uint64_t peak_bytes;          // the most memory the parse had allocated at once
+    uint64_t retained_bytes;      // what it had allocated and still held when it returned
+};
+
+// A file whose contents are read in place of the one on disk, e.g. an unsaved editor buffer.
+struct VirtualFile {
+    const char* path;
+    const char* contents; // need not be null-terminated
+    size_t length;
 };
 
 // Parses a schema and returns a pointer to the Parser object.
 struct FlatbuffersParser* parse_schema(const char* schema_content, const char* filename, const char **include_paths);
 
+// Parses a schema like parse_schema, reusing the definitions of any included files
+// found in the cache and adding the ones that had to be parsed. The cache may be null.
+struct FlatbuffersParser* parse_schema_with_cache(const char* schema_content, const char* filename, const char **include_paths, struct FlatbuffersIncludeCache* cache);
+
+// Parses a schema like parse_schema_with_cache, resolving and loading includes from files
+// before falling back to the disk. The buffers only need to outlive the call.
+struct FlatbuffersParser* parse_schema_with_overlay(const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache);
+
 // Deletes a parser object.
 void delete_parser(struct FlatbuffersParser* parser);
 
-// Returns the error string from the parser.
+// Returns a parser released earlier, allocated and warmed up by its last parse, or a
+// new one if there is none. Give it back with release_parser rather than delete_parser.
+struct FlatbuffersParser* acquire_parser(void);
+
+// Clears the results of the last parse, keeping the memory allocated for them.
+void reset_parser(struct FlatbuffersParser* parser);
+
+// Resets a parser from acquire_parser and returns it to the pool. It must not be used afterwards.
+void release_parser(struct FlatbuffersParser* parser);
+
+// Parses a schema like parse_schema_with_overlay into an existing parser, resetting it
+// first. Returns whether the parse succeeded.
+bool parse_schema_into(struct FlatbuffersParser* parser, const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache);
+
+// Parses a schema like parse_schema_into, but gives up early once *cancel is true, which may
+// be set from any thread while the parse runs. A parse that gave up fails with a single
+// DIAGNOSTIC_CANCELLED error and is_parser_cancelled returns true. cancel may be null.
+bool parse_schema_cancellable(struct FlatbuffersParser* parser, const char* schema_content, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel);
+
+// Parses a schema like parse_schema_cancellable from the schema_length bytes at
+// schema_content, which need not be null-terminated. The parser keeps its own copy of them,
+// and reads a null byte among them as the end of the schema.
+bool parse_schema_buffer(struct FlatbuffersParser* parser, const char* schema_content, size_t schema_length, const char* filename, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel);
+
+// Parses the schema_length bytes at schema_content, an edit of the schema parser last parsed,
+// with files like parse_schema_buffer, by parsing again only the table whose braces enclose everything
+// that changed. Returns false if that could give a different result than parsing the whole
+// schema, after which the parser has to be parsed into from scratch. Otherwise the parser
+// holds the same results as if it had been, and is_parser_success tells if it succeeded.
+bool reparse_schema(struct FlatbuffersParser* parser, const char* schema_content, size_t schema_length, const struct VirtualFile* files, size_t num_files);
+
+// A schema to parse with parse_schemas_batch.
+struct SchemaSource {
+    const char* content; // need not be null-terminated
+    size_t length;
+    const char* filename;
+    // Add the definitions of this schema, not just of its includes, to the cache, so that
+    // files including it can import them. Only takes effect if it parses without errors.
+    bool cache_definitions;
+};
+
+// Called with the parser of sources[index] once it has been parsed. It may be called from
+// several threads at once, and the parser is released when it returns.
+typedef void (*ParsedSchemaCallback)(void* context, size_t index, struct FlatbuffersParser* parser);
+
+// Parses every source like parse_schema_buffer, sharing include_paths, files, cache and
+// cancel, on a pool of worker threads, and returns once on_parsed has been called for each.
+void parse_schemas_batch(const struct SchemaSource* sources, size_t num_sources, const char **include_paths, const struct VirtualFile* files, size_t num_files, struct FlatbuffersIncludeCache* cache, const bool* cancel, ParsedSchemaCallback on_parsed, void* context);
+
+// Returns the warnings and errors of the parse formatted as text, one per line.
 const char* get_parser_error(struct FlatbuffersParser* parser);
 
 // Returns true if the parser has no errors.
 bool is_parser_success(struct FlatbuffersParser* parser);
 
-// Functions for structs and tables
-int get_num_structs(struct FlatbuffersParser* parser);
-struct StructDefinitionInfo get_struct_info(struct FlatbuffersParser* parser, int index);
+// Returns true if the last parse gave up because its cancel flag was set.
+bool is_parser_cancelled(struct FlatbuffersParser* parser);
 
-// Functions for enums and unions
-int get_num_enums(struct FlatbuffersParser* parser);
-struct EnumDefinitionInfo get_enum_info(struct FlatbuffersParser* parser, int index);
+// Returns the number of source bytes the lexer scanned, across all files, during the parse.
+uint64_t get_bytes_scanned(struct FlatbuffersParser* parser);
 
-// Functions for enum values
-int get_num_enum_vals(struct FlatbuffersParser* parser, int enum_index);
-struct EnumValDefinitionInfo get_enum_val_info(struct FlatbuffersParser* parser, int enum_index, int val_index);
+// Returns the time spent and work done by the parse so far, including export_schema if it was called.
+struct ParseStats get_parse_stats(struct FlatbuffersParser* parser);
 
-// Functions for root type
-bool has_root_type(struct FlatbuffersParser* parser);
-struct RootTypeDefinitionInfo get_root_type_info(struct FlatbuffersParser* parser);
+// Functions for the include cache
+struct FlatbuffersIncludeCache* create_include_cache(void);
+void delete_include_cache(struct FlatbuffersIncludeCache* cache);
 
-// Functions for fields
-int get_num_fields(struct FlatbuffersParser* parser, int struct_index);
-struct FieldDefinitionInfo get_field_info(struct FlatbuffersParser* parser, int struct_index, int field_index);
+// The cache also remembers which file each include statement resolved to, by the include
+// paths and the includer's directory, so that parses don't search the include paths again.
+// Forgets them, for when files have been added or removed. (Edits don't move files.)
+void forget_include_resolutions(struct FlatbuffersIncludeCache* cache);
 
-// Functions for RPC services
-int get_num_rpc_services(struct FlatbuffersParser* parser);
-struct RpcServiceDefinitionInfo get_rpc_service_info(struct FlatbuffersParser* parser, int index);
+// Lays out every struct, table, enum, union and rpc_service in one buffer that starts with a
+// SchemaExportHeader, and returns its size. The buffer is owned by the parser and stays valid
+// until delete_parser. Returns 0 and sets *out_buffer to null for an invalid parser.
+size_t export_schema(struct FlatbuffersParser* parser, const uint8_t** out_buffer);
 
-// Functions for RPC methods
-int get_num_rpc_methods(struct FlatbuffersParser* parser, int service_index);
-struct RpcMethodDefinitionInfo get_rpc_method_info(struct FlatbuffersParser* parser, int service_index, int method_index);
+// Returns the number of heap allocations made to intern the strings returned by this API,
+// including the strings of export_schema.
+uint64_t get_string_allocation_count(struct FlatbuffersParser* parser);
+
+// Functions for root type
+bool has_root_type(struct FlatbuffersParser* parser);
+struct RootTypeDefinitionInfo get_root_type_info(struct FlatbuffersParser* parser);
 
 // Functions for user-defined attributes
 int get_num_user_defined_attributes(struct FlatbuffersParser* parser);
 const char* get_user_defined_attribute(struct FlatbuffersParser* parser, int index);
 const char* get_user_defined_attribute_doc(struct FlatbuffersParser* parser, const char* name);
 
-// Functions for all included files
-int get_num_all_included_files(struct FlatbuffersParser* parser);
-const char* get_all_included_file_path(struct FlatbuffersParser* parser, int index);
+// Returns the include graph of the parse, computed on the first call. The arrays are owned by
+// the parser and stay valid until delete_parser.
+struct IncludeGraph get_include_graph(struct FlatbuffersParser* parser);
+
+// Returns the semantic tokens of the parse, computed on the first call. The array is owned
+// by the parser and stays valid until delete_parser.
+struct SemanticTokens get_semantic_tokens(struct FlatbuffersParser* parser);
 
-// Functions for include graph
-int get_num_files_with_includes(struct FlatbuffersParser* parser);
-const char* get_file_with_includes_path(struct FlatbuffersParser* parser, int index);
-int get_num_includes_for_file(struct FlatbuffersParser* parser, const char* file_path);
-const char* get_included_file_path(struct FlatbuffersParser* parser, const char* file_path, int index);
+// Returns the warnings and errors of the parse, computed on the first call. The arrays are
+// owned by the parser and stay valid until delete_parser.
+struct Diagnostics get_diagnostics(struct FlatbuffersParser* parser);
 
 
 #ifdef __cplusplus
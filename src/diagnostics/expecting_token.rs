@@ -1,39 +1,28 @@
-use std::{fs, path::PathBuf};
-
-use crate::diagnostics::ErrorDiagnosticHandler;
+use crate::diagnostics::{ErrorDiagnosticHandler, ParserMessage, ParserMessageKind};
 use crate::utils::as_pos_idx;
 use crate::{diagnostics::codes::DiagnosticCode, utils::paths::path_buf_to_uri};
-use log::error;
-use regex::Regex;
 use serde_json;
 use tower_lsp_server::lsp_types::{
     Diagnostic, DiagnosticRelatedInformation, DiagnosticSeverity, Location, Position, Range,
 };
 
-static RE: std::sync::LazyLock<Regex> = std::sync::LazyLock::new(|| {
-    Regex::new(r"^(.+?):\s*(\d+):\s*(\d+):\s*error:\s*expecting: (.+) instead got:\s*(.+)$")
-        .expect("expecting token regex failed to compile")
-});
-
 pub struct ExpectingTokenHandler;
 
 impl ErrorDiagnosticHandler for ExpectingTokenHandler {
     #[allow(clippy::too_many_lines)]
-    fn handle(&self, line: &str, content: &str) -> Option<(PathBuf, Diagnostic)> {
-        if let Some(captures) = RE.captures(line) {
-            let file_path = captures[1].trim();
-            let Ok(file_path) = fs::canonicalize(file_path) else {
-                error!("failed to canonicalize file: {file_path} in expecting token handler");
-                return None;
-            };
-            let Ok(file_url) = path_buf_to_uri(&file_path) else {
+    fn handle(&self, message: &ParserMessage, content: &str) -> Option<Diagnostic> {
+        if message.kind != ParserMessageKind::ExpectingToken {
+            return None;
+        }
+        if let [expected_token, unexpected_token] = message.args.as_slice() {
+            let Ok(file_url) = path_buf_to_uri(&message.path) else {
                 return None;
             };
 
-            let error_line_num: u32 = captures[2].parse().unwrap_or(1u32).saturating_sub(1);
-            let error_col_num: u32 = captures[3].parse().unwrap_or(1u32).saturating_sub(1);
-            let expected_token = captures[4].trim().to_string();
-            let unexpected_token = captures[5].trim().to_string();
+            let error_line_num: u32 = message.line.saturating_sub(1);
+            let error_col_num: u32 = message.col.saturating_sub(1);
+            let expected_token = expected_token.trim().to_string();
+            let unexpected_token = unexpected_token.trim().to_string();
 
             let message = if unexpected_token == "end of file" {
                 format!("expected `{expected_token}`, found `end of file`")
@@ -135,18 +124,15 @@ impl ErrorDiagnosticHandler for ExpectingTokenHandler {
                 message: format!("add `{expected_token}` here"),
             });
 
-            return Some((
-                file_path,
-                Diagnostic {
-                    range,
-                    severity: Some(DiagnosticSeverity::ERROR),
-                    message,
-                    related_information: Some(related_information),
-                    code: Some(DiagnosticCode::ExpectingToken.into()),
-                    data: Some(serde_json::json!({ "expected": expected_token, "eol": is_eol })),
-                    ..Default::default()
-                },
-            ));
+            return Some(Diagnostic {
+                range,
+                severity: Some(DiagnosticSeverity::ERROR),
+                message,
+                related_information: Some(related_information),
+                code: Some(DiagnosticCode::ExpectingToken.into()),
+                data: Some(serde_json::json!({ "expected": expected_token, "eol": is_eol })),
+                ..Default::default()
+            });
         }
         None
     }
@@ -1,10 +1,9 @@
 use std::{
-    borrow::Cow,
     collections::HashMap,
     fs,
     path::{Path, PathBuf},
 };
-use tower_lsp_server::lsp_types::Diagnostic;
+use tower_lsp_server::lsp_types::{Diagnostic, DiagnosticSeverity, Range};
 
 pub mod codes;
 pub mod duplicate_definition;
@@ -14,13 +13,44 @@ pub mod semantic;
 pub mod snake_case_warning;
 pub mod undefined_type;
 
+/// The kinds of flatc message that are told apart.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ParserMessageKind {
+    Generic,
+    DuplicateDefinition,
+    ExpectingToken,
+    UndefinedType,
+    NonSnakeCase,
+    /// Reported like a generic message, but tells the analyzer that adding a
+    /// file or search path can change the parse.
+    UnresolvedInclude,
+}
+
+/// A warning or error reported by flatc.
+#[derive(Debug, Clone)]
+pub struct ParserMessage {
+    /// The canonical path of the file it was reported in.
+    pub path: PathBuf,
+    pub severity: DiagnosticSeverity,
+    pub kind: ParserMessageKind,
+    /// Where the parser was. The line is 1-based and the column is the
+    /// parser's cursor in that line.
+    pub line: u32,
+    pub col: u32,
+    /// The span of what the message is about, if flatc knows it.
+    pub range: Option<Range>,
+    pub message: String,
+    /// The arguments of a kind, as listed in `wrapper.h`.
+    pub args: Vec<String>,
+}
+
 pub trait ErrorDiagnosticHandler {
-    fn handle(&self, line: &str, content: &str) -> Option<(PathBuf, Diagnostic)>;
+    fn handle(&self, message: &ParserMessage, content: &str) -> Option<Diagnostic>;
 }
 
 #[must_use]
-pub fn generate_diagnostics_from_error_string(
-    error_str: &str,
+pub fn generate_diagnostics_from_messages(
+    messages: &[ParserMessage],
     root_path: &Path,
     root_content: &str,
 ) -> HashMap<PathBuf, Vec<Diagnostic>> {
@@ -35,29 +65,21 @@ pub fn generate_diagnostics_from_error_string(
 
     let mut file_cache: HashMap<PathBuf, String> = HashMap::new();
 
-    for line in error_str.lines() {
-        let Some(file_path_str) = line.split(':').next() else {
-            continue;
-        };
-
-        let Ok(canonical_path) = fs::canonicalize(file_path_str) else {
-            continue;
-        };
-
-        let content = if canonical_path == root_path {
-            Cow::Borrowed(root_content)
+    for message in messages {
+        let content = if message.path == root_path {
+            root_content
         } else {
-            Cow::Owned(
-                file_cache
-                    .entry(canonical_path)
-                    .or_insert_with(|| fs::read_to_string(file_path_str).unwrap_or_default())
-                    .clone(),
-            )
+            file_cache
+                .entry(message.path.clone())
+                .or_insert_with(|| fs::read_to_string(&message.path).unwrap_or_default())
         };
 
         for handler in &handlers {
-            if let Some((path, diagnostic)) = handler.handle(line, &content) {
-                diagnostics_map.entry(path).or_default().push(diagnostic);
+            if let Some(diagnostic) = handler.handle(message, content) {
+                diagnostics_map
+                    .entry(message.path.clone())
+                    .or_default()
+                    .push(diagnostic);
                 break;
             }
         }
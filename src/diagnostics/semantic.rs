@@ -7,7 +7,7 @@ use std::path::{Path, PathBuf};
 
 use tower_lsp_server::lsp_types::{Diagnostic, DiagnosticSeverity, DiagnosticTag, Position, Range};
 
-use crate::symbol_table::{RootTypeInfo, SymbolKind, SymbolTable};
+use crate::symbol_table::{Occurrence, SymbolKind, SymbolTable};
 
 pub fn analyze_deprecated_fields<S: BuildHasher>(
     st: &SymbolTable,
@@ -64,53 +64,12 @@ pub fn analyze_unused_includes<S: BuildHasher>(
     file_contents: &str,
     include_graph: &HashMap<String, Vec<String>, S>,
     search_paths: &[PathBuf],
-    root_type_info: &Option<RootTypeInfo>,
+    occurrences: &[Occurrence],
 ) {
-    let mut used_types = HashSet::new();
-    if let Some(root_type) = root_type_info {
-        if root_type.location.path == st.path {
-            used_types.insert(root_type.type_name.clone());
-        }
-    }
-
-    for symbol in st.values() {
-        if symbol.info.location.path != st.path {
-            continue;
-        }
-        match &symbol.kind {
-            SymbolKind::Table(t) => {
-                for field in &t.fields {
-                    if let SymbolKind::Field(f) = &field.kind {
-                        used_types.insert(f.type_name.clone());
-                    }
-                }
-            }
-            SymbolKind::Struct(s) => {
-                for field in &s.fields {
-                    if let SymbolKind::Field(f) = &field.kind {
-                        used_types.insert(f.type_name.clone());
-                    }
-                }
-            }
-            SymbolKind::Union(u) => {
-                for variant in &u.variants {
-                    used_types.insert(variant.name.clone());
-                }
-            }
-            SymbolKind::RpcService(r) => {
-                for method in &r.methods {
-                    used_types.insert(method.request_type.parsed.qualified_name());
-                    used_types.insert(method.response_type.parsed.qualified_name());
-                }
-            }
-            _ => (),
-        }
-    }
-
-    // Need to get from the file's includes to each of these.
+    // Need to get from the file's includes to each of the types it uses.
     let mut symbol_defining_files = HashSet::new();
-    for used_type in &used_types {
-        if let Some(symbol) = st.get(used_type) {
+    for occurrence in occurrences {
+        if let Some(symbol) = st.get(&occurrence.target) {
             let path = &symbol.info.location.path;
             // TODO: Make everything PathBuf.
             if let Some(path_str) = path.to_str() {
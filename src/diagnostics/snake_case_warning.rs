@@ -1,38 +1,23 @@
-use std::sync::LazyLock;
-use std::{fs, path::PathBuf, str::FromStr};
+use std::str::FromStr;
 
-use crate::diagnostics::ErrorDiagnosticHandler;
+use crate::diagnostics::{ErrorDiagnosticHandler, ParserMessage, ParserMessageKind};
 use crate::{diagnostics::codes::DiagnosticCode, utils::as_pos_idx};
 use heck::ToSnakeCase;
-use log::error;
-use regex::Regex;
 use tower_lsp_server::lsp_types::{
     CodeDescription, Diagnostic, DiagnosticSeverity, Position, Range, Uri,
 };
 
-// Regex to capture snake_case warnings:
-// <1file>:<2line>: <3col>: warning: field names should be lowercase snake_case, got: <4name>
-static SNAKE_CASE_RE: LazyLock<Regex> = LazyLock::new(|| {
-    Regex::new(
-        r"^(.+?):(\d+): (\d+): warning: field names should be lowercase snake_case, got: (.+)$",
-    )
-    .expect("snake case regex failed to compile")
-});
-
 pub struct SnakeCaseWarningHandler;
 
 impl ErrorDiagnosticHandler for SnakeCaseWarningHandler {
-    fn handle(&self, line: &str, _content: &str) -> Option<(PathBuf, Diagnostic)> {
-        let captures = SNAKE_CASE_RE.captures(line)?;
-        let file_path = captures[1].trim();
-        let Ok(file_path) = fs::canonicalize(file_path) else {
-            error!("failed to canonicalize file: {file_path} in snake case handler");
+    fn handle(&self, message: &ParserMessage, _content: &str) -> Option<Diagnostic> {
+        if message.kind != ParserMessageKind::NonSnakeCase {
             return None;
-        };
+        }
 
-        let line_num: u32 = captures[2].parse().unwrap_or(1u32).saturating_sub(1);
-        let col_num: u32 = captures[3].parse().unwrap_or(1);
-        let name = captures[4].trim();
+        let line_num: u32 = message.line.saturating_sub(1);
+        let col_num: u32 = message.col;
+        let name = message.args.first()?.trim();
         let name_length = as_pos_idx(name.chars().count());
 
         let replacement = name.to_snake_case();
@@ -43,22 +28,19 @@ impl ErrorDiagnosticHandler for SnakeCaseWarningHandler {
             end: Position::new(line_num, col_num),
         };
 
-        Some((
-            file_path,
-            Diagnostic {
-                range,
-                severity: Some(DiagnosticSeverity::WARNING),
-                code: Some(DiagnosticCode::NonSnakeCase.into()),
-                code_description: Uri::from_str("https://flatbuffers.dev/schema/#style-guide")
-                    .map(|u| CodeDescription { href: u })
-                    .ok(),
-
-                message,
-                data: Some(
-                    serde_json::json!({ "original_name": name, "replacement_name": replacement }),
-                ),
-                ..Default::default()
-            },
-        ))
+        Some(Diagnostic {
+            range,
+            severity: Some(DiagnosticSeverity::WARNING),
+            code: Some(DiagnosticCode::NonSnakeCase.into()),
+            code_description: Uri::from_str("https://flatbuffers.dev/schema/#style-guide")
+                .map(|u| CodeDescription { href: u })
+                .ok(),
+
+            message,
+            data: Some(
+                serde_json::json!({ "original_name": name, "replacement_name": replacement }),
+            ),
+            ..Default::default()
+        })
     }
 }
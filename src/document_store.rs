@@ -1,16 +1,67 @@
 use crate::utils::paths::{is_flatbuffer_schema, uri_to_path_buf};
-use dashmap::DashMap;
+use dashmap::DashSet;
 use log::debug;
 use ropey::Rope;
-use std::path::PathBuf;
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, PoisonError, RwLock};
 use tower_lsp_server::lsp_types::{
     DidChangeTextDocumentParams, DidCloseTextDocumentParams, DidOpenTextDocumentParams,
     DidSaveTextDocumentParams,
 };
 
+/// The contents of each document, as one immutable map that is replaced on
+/// every change. Taking a snapshot of it only clones the `Arc`, and a change
+/// while a snapshot is held only copies the map, whose ropes share their text.
+#[derive(Debug, Default)]
+pub struct DocumentMap {
+    documents: RwLock<Arc<HashMap<PathBuf, Rope>>>,
+}
+
+impl DocumentMap {
+    #[must_use]
+    pub fn get(&self, path: &Path) -> Option<Rope> {
+        self.documents
+            .read()
+            .unwrap_or_else(PoisonError::into_inner)
+            .get(path)
+            .cloned()
+    }
+
+    pub fn insert(&self, path: PathBuf, document: Rope) {
+        let mut documents = self
+            .documents
+            .write()
+            .unwrap_or_else(PoisonError::into_inner);
+        Arc::make_mut(&mut documents).insert(path, document);
+    }
+
+    pub fn remove(&self, path: &Path) {
+        let mut documents = self
+            .documents
+            .write()
+            .unwrap_or_else(PoisonError::into_inner);
+        if documents.contains_key(path) {
+            Arc::make_mut(&mut documents).remove(path);
+        }
+    }
+
+    /// The documents as they are now, unaffected by later changes.
+    #[must_use]
+    pub fn snapshot(&self) -> Arc<HashMap<PathBuf, Rope>> {
+        self.documents
+            .read()
+            .unwrap_or_else(PoisonError::into_inner)
+            .clone()
+    }
+}
+
 #[derive(Debug)]
 pub struct DocumentStore {
-    pub document_map: DashMap<PathBuf, Rope>,
+    pub document_map: DocumentMap,
+    /// The documents the client has open. Their text in `document_map` is the
+    /// client's, while that of every other file is a copy of it on disk.
+    open: DashSet<PathBuf>,
 }
 
 impl Default for DocumentStore {
@@ -23,10 +74,18 @@ impl DocumentStore {
     #[must_use]
     pub fn new() -> Self {
         Self {
-            document_map: DashMap::new(),
+            document_map: DocumentMap::default(),
+            open: DashSet::new(),
         }
     }
 
+    /// Whether the client has `path` open, so that its text may differ from
+    /// the file on disk.
+    #[must_use]
+    pub fn is_open(&self, path: &Path) -> bool {
+        self.open.contains(path)
+    }
+
     pub fn handle_did_open(&self, params: &DidOpenTextDocumentParams) -> Option<PathBuf> {
         debug!("opened: {}", params.text_document.uri.path());
         if !is_flatbuffer_schema(&params.text_document.uri) {
@@ -38,6 +97,7 @@ impl DocumentStore {
             path.clone(),
             ropey::Rope::from_str(&params.text_document.text),
         );
+        self.open.insert(path.clone());
         Some(path)
     }
 
@@ -73,8 +133,13 @@ impl DocumentStore {
     pub fn handle_did_close(&self, params: &DidCloseTextDocumentParams) {
         debug!("closed: {}", params.text_document.uri.path());
         if !is_flatbuffer_schema(&params.text_document.uri) {
-            #[allow(clippy::needless_return)]
             return;
         }
+        let Ok(path) = uri_to_path_buf(&params.text_document.uri) else {
+            return;
+        };
+        // Unsaved edits are discarded, so the file is read from disk again.
+        self.open.remove(&path);
+        self.document_map.remove(&path);
     }
 }
@@ -17,7 +17,7 @@ use tower_lsp_server::lsp_types::{
 /// relevant quick-fix actions based on the diagnostic code.
 #[allow(clippy::too_many_lines)]
 pub fn handle_code_action(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: CodeActionParams,
 ) -> Option<CodeActionResponse> {
     let uri = params.text_document.uri;
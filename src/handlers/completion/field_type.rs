@@ -35,11 +35,8 @@ pub fn handle_field_type_completion(
 
     let mut items = Vec::new();
 
-    let collisions = snapshot.symbols.collisions();
-
     // User-defined symbols
-    for entry in &snapshot.symbols.global {
-        let symbol = entry.1;
+    for symbol in snapshot.symbols.type_candidates(&partial_text) {
         let kind: CompletionItemKind = (&symbol.kind).into();
         if kind == CompletionItemKind::FIELD {
             continue;
@@ -62,7 +59,7 @@ pub fn handle_field_type_completion(
         );
 
         if is_match {
-            let has_collision = collisions.contains_key(base_name);
+            let has_collision = snapshot.symbols.is_ambiguous(base_name);
 
             let detail = symbol.info.namespace_str().map_or_else(
                 || symbol.type_name().to_string(),
@@ -91,10 +88,10 @@ pub fn handle_field_type_completion(
                     detail: None, // for function signatures or type annotations, neither of which are relevant for us.
                     description: preview_text.or(symbol.info.namespace_str()), // for fully qualified name or file path.
                 }),
-                documentation: symbol.info.documentation.as_ref().map(|doc| {
+                documentation: snapshot.documentation(symbol).map(|doc| {
                     Documentation::MarkupContent(MarkupContent {
                         kind: MarkupKind::Markdown,
-                        value: doc.clone(),
+                        value: doc,
                     })
                 }),
                 ..Default::default()
@@ -118,10 +115,10 @@ pub fn handle_field_type_completion(
                 label: name.clone(),
                 sort_text: Some(sort_text),
                 kind: Some(CompletionItemKind::KEYWORD),
-                documentation: symbol.info.documentation.as_ref().map(|doc| {
+                documentation: snapshot.documentation(symbol).map(|doc| {
                     Documentation::MarkupContent(MarkupContent {
                         kind: MarkupKind::Markdown,
-                        value: doc.clone(),
+                        value: doc,
                     })
                 }),
                 ..Default::default()
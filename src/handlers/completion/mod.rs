@@ -20,7 +20,7 @@ use std::time::Instant;
 use tower_lsp_server::lsp_types::{CompletionParams, CompletionResponse, Position};
 
 pub fn handle_completion(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: &CompletionParams,
 ) -> Option<CompletionResponse> {
     let start = Instant::now();
@@ -54,10 +54,10 @@ pub fn handle_root_type_completion(
                         detail: None,
                         description: preview_text.or(symbol.info.namespace_str()), // for fully qualified name or file path.
                     }),
-                    documentation: symbol.info.documentation.as_ref().map(|doc| {
+                    documentation: snapshot.documentation(symbol).map(|doc| {
                         Documentation::MarkupContent(MarkupContent {
                             kind: MarkupKind::Markdown,
-                            value: doc.clone(),
+                            value: doc,
                         })
                     }),
                     ..Default::default()
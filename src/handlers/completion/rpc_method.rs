@@ -1,4 +1,7 @@
-use std::{path::PathBuf, sync::LazyLock};
+use std::{
+    path::PathBuf,
+    sync::{Arc, LazyLock},
+};
 
 use crate::{
     analysis::WorkspaceSnapshot,
@@ -33,8 +36,6 @@ pub fn handle_rpc_method_completion(
     let (captures, symbols) = line_completions(snapshot, line, position, &REQ_RE)
         .or_else(|| line_completions(snapshot, line, position, &RESP_RE))?;
 
-    let collisions = snapshot.symbols.collisions();
-
     let items: Vec<CompletionItem> = symbols
         .into_iter()
         .map(|symbol| {
@@ -42,7 +43,7 @@ pub fn handle_rpc_method_completion(
 
             let base_name = &symbol.info.name;
             let qualified_name = symbol.info.qualified_name();
-            let has_collision = collisions.contains_key(base_name);
+            let has_collision = snapshot.symbols.is_ambiguous(base_name);
 
             let detail = symbol.info.namespace_str().map_or_else(
                 || symbol.type_name().to_string(),
@@ -81,10 +82,10 @@ pub fn handle_rpc_method_completion(
                     detail: None, // for function signatures or type annotations, neither of which are relevant for us.
                     description: preview_text.or(symbol.info.namespace_str()), // for fully qualified name or file path.
                 }),
-                documentation: symbol.info.documentation.as_ref().map(|doc| {
+                documentation: snapshot.documentation(&symbol).map(|doc| {
                     Documentation::MarkupContent(MarkupContent {
                         kind: MarkupKind::Markdown,
-                        value: doc.clone(),
+                        value: doc,
                     })
                 }),
                 ..Default::default()
@@ -123,7 +124,7 @@ fn line_completions(
     line: &str,
     position: Position,
     re: &Regex,
-) -> Option<(LineCaptures, Vec<Symbol>)> {
+) -> Option<(LineCaptures, Vec<Arc<Symbol>>)> {
     let line_upto_cursor = &line[..position.character as usize];
     let captures = re.captures(line_upto_cursor).and_then(|capture| {
         let line_prefix = capture.name("line_prefix")?.as_str().to_string();
@@ -2,7 +2,7 @@ use crate::analysis::WorkspaceSnapshot;
 use tower_lsp_server::lsp_types::{GotoDefinitionParams, GotoDefinitionResponse};
 
 pub fn handle_goto_definition(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: GotoDefinitionParams,
 ) -> Option<GotoDefinitionResponse> {
     let uri = params.text_document_position_params.text_document.uri;
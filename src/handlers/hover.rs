@@ -45,7 +45,7 @@ fn is_inside_braces(doc: &Rope, position: Position) -> bool {
     open_braces > close_braces
 }
 
-pub fn handle_hover(snapshot: &WorkspaceSnapshot<'_>, params: HoverParams) -> Option<Hover> {
+pub fn handle_hover(snapshot: &WorkspaceSnapshot, params: HoverParams) -> Option<Hover> {
     let start = Instant::now();
     let uri = params.text_document_position_params.text_document.uri;
     let pos = params.text_document_position_params.position;
@@ -57,7 +57,11 @@ pub fn handle_hover(snapshot: &WorkspaceSnapshot<'_>, params: HoverParams) -> Op
         res = Some(Hover {
             contents: HoverContents::Markup(MarkupContent {
                 kind: MarkupKind::Markdown,
-                value: resolved.target.hover_markdown(),
+                value: resolved.target.hover_markdown(
+                    snapshot
+                        .source(&resolved.target.info.location.path)
+                        .as_ref(),
+                ),
             }),
             range: Some(resolved.range),
         });
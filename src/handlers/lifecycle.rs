@@ -1,6 +1,9 @@
 use std::{fs, iter::once, path::PathBuf};
 
-use crate::{ext::duration::DurationFormat, server::Backend, utils::paths::uri_to_path_buf};
+use crate::{
+    analysis::index_cache, ext::duration::DurationFormat, server::Backend,
+    utils::paths::uri_to_path_buf,
+};
 use log::{debug, info};
 use tokio::time::Instant;
 use tower_lsp_server::lsp_types::{
@@ -25,7 +28,7 @@ pub async fn handle_did_change(
     params: DidChangeTextDocumentParams,
 ) -> Vec<(PathBuf, Vec<Diagnostic>)> {
     if let Some(path) = backend.documents.handle_did_change(params) {
-        backend.analyzer.parse(vec![path]).await
+        backend.analyzer.parse_edit(path).await
     } else {
         vec![]
     }
@@ -51,6 +54,9 @@ pub async fn handle_did_save(
 
 pub fn handle_did_close(backend: &Backend, params: &DidCloseTextDocumentParams) {
     backend.documents.handle_did_close(params);
+    if let Ok(path) = uri_to_path_buf(&params.text_document.uri) {
+        backend.semantic_tokens.forget(&path);
+    }
 }
 
 pub async fn handle_initialize(backend: &Backend, params: InitializeParams) {
@@ -68,16 +74,38 @@ pub async fn handle_initialize(backend: &Backend, params: InitializeParams) {
     layout.add_roots(roots);
 }
 
-pub async fn handle_initialized(backend: &Backend) -> Vec<(PathBuf, Vec<Diagnostic>)> {
+/// The result of the scan of the workspace when the client is initialized.
+pub struct InitialScan {
+    pub diagnostics: Vec<(PathBuf, Vec<Diagnostic>)>,
+    /// Files restored from the index cache rather than parsed, to pass to
+    /// [`handle_index_revalidation`].
+    pub restored: Vec<PathBuf>,
+}
+
+pub async fn handle_initialized(backend: &Backend) -> InitialScan {
     let start = Instant::now();
 
-    let files = {
+    let (files, cache_path) = {
         let mut layout = backend.analyzer.layout.write().await;
         info!("initial workspace roots: {:?}", layout.workspace_roots);
 
-        layout.discover_files()
+        let cache_path = index_cache::default_dir()
+            .map(|dir| index_cache::cache_path(&dir, &layout.workspace_roots));
+        (layout.discover_files(), cache_path)
     };
-    let diagnostics = backend.analyzer.parse(files).await;
+    let (to_parse, restored) = match cache_path {
+        Some(cache_path) => {
+            let restore = backend.analyzer.restore_index(&cache_path, &files).await;
+            debug!(
+                "restored {} files from {}",
+                restore.restored.len(),
+                cache_path.display()
+            );
+            (restore.missing, restore.restored)
+        }
+        None => (files, vec![]),
+    };
+    let diagnostics = backend.analyzer.parse(to_parse).await;
 
     let snapshot = backend.analyzer.snapshot().await;
     debug!(
@@ -85,9 +113,47 @@ pub async fn handle_initialized(backend: &Backend) -> Vec<(PathBuf, Vec<Diagnost
         start.elapsed().log_str(),
         snapshot.symbols.per_file.len()
     );
+    InitialScan {
+        diagnostics,
+        restored,
+    }
+}
+
+/// Parse the files the initial scan restored from the index cache, which skips
+/// those that haven't changed since they were cached, then update the cache.
+pub async fn handle_index_revalidation(
+    backend: &Backend,
+    restored: Vec<PathBuf>,
+) -> Vec<(PathBuf, Vec<Diagnostic>)> {
+    let mut diagnostics = vec![];
+    if !restored.is_empty() {
+        let start = Instant::now();
+        let count = restored.len();
+        diagnostics = backend.analyzer.parse(restored).await;
+        debug!(
+            "revalidated {count} cached files in {}",
+            start.elapsed().log_str()
+        );
+    }
+    save_index_cache(backend).await;
     diagnostics
 }
 
+pub async fn handle_shutdown(backend: &Backend) {
+    save_index_cache(backend).await;
+}
+
+/// Save the index to the index cache, if there is one.
+async fn save_index_cache(backend: &Backend) {
+    let cache_path = {
+        let layout = backend.analyzer.layout.read().await;
+        index_cache::default_dir().map(|dir| index_cache::cache_path(&dir, &layout.workspace_roots))
+    };
+    if let Some(cache_path) = cache_path {
+        backend.analyzer.save_index(&cache_path).await;
+    }
+}
+
 pub async fn handle_did_change_workspace_folders(
     backend: &Backend,
     params: DidChangeWorkspaceFoldersParams,
@@ -5,4 +5,5 @@ pub mod hover;
 pub mod lifecycle;
 pub mod references;
 pub mod rename;
+pub mod semantic_tokens;
 pub mod workspace_symbol;
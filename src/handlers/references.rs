@@ -1,13 +1,12 @@
 use crate::analysis::WorkspaceSnapshot;
 use crate::ext::duration::DurationFormat;
-use crate::symbol_table;
 use crate::utils::paths::path_buf_to_uri;
 use log::debug;
 use std::time::Instant;
 use tower_lsp_server::lsp_types::{Location, ReferenceParams};
 
 pub fn handle_references(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: ReferenceParams,
 ) -> Option<Vec<Location>> {
     let start = Instant::now();
@@ -24,67 +23,11 @@ pub fn handle_references(
     let mut references = Vec::new();
 
     // Find all references to this symbol across all files
-    for entry in &snapshot.symbols.global {
-        let symbol = entry.1;
-        let file_uri = path_buf_to_uri(&symbol.info.location.path).ok()?;
-
-        if let symbol_table::SymbolKind::Union(u) = &symbol.kind {
-            for variant in &u.variants {
-                if variant.name == target_name {
-                    references.push(Location::new(
-                        file_uri.clone(),
-                        variant.parsed_type.type_name.range,
-                    ));
-                }
-            }
-        }
-
-        if let symbol_table::SymbolKind::RpcService(r) = &symbol.kind {
-            for method in &r.methods {
-                if method.request_type.name == target_name {
-                    references.push(Location::new(
-                        file_uri.clone(),
-                        method.request_type.parsed.type_name.range,
-                    ));
-                }
-                if method.response_type.name == target_name {
-                    references.push(Location::new(
-                        file_uri.clone(),
-                        method.response_type.parsed.type_name.range,
-                    ));
-                }
-            }
-        }
-
-        let fields = match &symbol.kind {
-            symbol_table::SymbolKind::Table(t) => &t.fields,
-            symbol_table::SymbolKind::Struct(s) => &s.fields,
-            _ => continue,
-        };
-
-        for field in fields {
-            if let symbol_table::SymbolKind::Field(f) = &field.kind {
-                if f.type_name == target_name {
-                    references.push(Location::new(
-                        file_uri.clone(),
-                        f.parsed_type.type_name.range,
-                    ));
-                }
-            }
-        }
-    }
-
-    // Check for root_type declarations
-    for (path, root_type_info) in &snapshot.root_types.root_types {
-        let Ok(uri) = path_buf_to_uri(path) else {
+    for (path, occurrence) in snapshot.occurrences.references(&target_name) {
+        let Ok(file_uri) = path_buf_to_uri(path) else {
             continue;
         };
-        if root_type_info.type_name == target_name {
-            references.push(Location {
-                uri,
-                range: root_type_info.parsed_type.type_name.range,
-            });
-        }
+        references.push(Location::new(file_uri, occurrence.range));
     }
 
     // Include the definition itself if requested
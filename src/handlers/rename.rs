@@ -9,7 +9,7 @@ use tower_lsp_server::lsp_types::{
 };
 
 pub fn prepare_rename(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: &TextDocumentPositionParams,
 ) -> Option<PrepareRenameResponse> {
     let uri = &params.text_document.uri;
@@ -24,7 +24,7 @@ pub fn prepare_rename(
     Some(PrepareRenameResponse::Range(resolved.range))
 }
 
-pub fn rename(snapshot: &WorkspaceSnapshot<'_>, params: RenameParams) -> Option<WorkspaceEdit> {
+pub fn rename(snapshot: &WorkspaceSnapshot, params: RenameParams) -> Option<WorkspaceEdit> {
     let start = Instant::now();
     let uri = &params.text_document_position.text_document.uri;
     let position = params.text_document_position.position;
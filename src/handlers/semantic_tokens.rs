@@ -0,0 +1,245 @@
+use crate::analysis::WorkspaceSnapshot;
+use crate::ext::duration::DurationFormat;
+use crate::utils::as_pos_idx;
+use crate::utils::paths::uri_to_path_buf;
+use dashmap::DashMap;
+use log::debug;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Instant;
+use tower_lsp_server::lsp_types::{
+    SemanticToken, SemanticTokenModifier, SemanticTokenType, SemanticTokens, SemanticTokensDelta,
+    SemanticTokensDeltaParams, SemanticTokensEdit, SemanticTokensFullDeltaResult,
+    SemanticTokensLegend, SemanticTokensParams, SemanticTokensResult,
+};
+
+/// The number of values each token takes up in the wire layout.
+const TOKEN_LEN: usize = 5;
+
+/// Indexed by the `SEMANTIC_TOKEN_` kinds of the parser.
+const TOKEN_TYPES: [SemanticTokenType; 14] = [
+    SemanticTokenType::KEYWORD,
+    SemanticTokenType::NAMESPACE,
+    SemanticTokenType::TYPE,
+    SemanticTokenType::STRUCT,
+    // Tables are what other languages call classes.
+    SemanticTokenType::CLASS,
+    SemanticTokenType::ENUM,
+    // There is no standard type for unions, so clients fall back to their
+    // default unless they know this one.
+    SemanticTokenType::new("union"),
+    SemanticTokenType::ENUM_MEMBER,
+    SemanticTokenType::PROPERTY,
+    SemanticTokenType::DECORATOR,
+    SemanticTokenType::INTERFACE,
+    SemanticTokenType::METHOD,
+    SemanticTokenType::STRING,
+    SemanticTokenType::NUMBER,
+];
+
+/// In the order of the bits of the `SEMANTIC_TOKEN_MODIFIER_` flags of the
+/// parser.
+const TOKEN_MODIFIERS: [SemanticTokenModifier; 3] = [
+    SemanticTokenModifier::DECLARATION,
+    SemanticTokenModifier::DEPRECATED,
+    SemanticTokenModifier::DEFAULT_LIBRARY,
+];
+
+/// The legend of the tokens the parser emits.
+#[must_use]
+pub fn legend() -> SemanticTokensLegend {
+    SemanticTokensLegend {
+        token_types: TOKEN_TYPES.to_vec(),
+        token_modifiers: TOKEN_MODIFIERS.to_vec(),
+    }
+}
+
+/// The tokens last sent for each document, so that the next request for it
+/// can be answered with only what changed since.
+#[derive(Debug, Default)]
+pub struct SentTokens {
+    documents: DashMap<PathBuf, Sent>,
+    next_result_id: AtomicU64,
+}
+
+#[derive(Debug)]
+struct Sent {
+    result_id: String,
+    /// Shared with the index that sent it.
+    data: Arc<[u32]>,
+}
+
+impl SentTokens {
+    /// Remembers `data` as sent for `path`, and returns its result id.
+    fn record(&self, path: PathBuf, data: Arc<[u32]>) -> String {
+        let result_id = self
+            .next_result_id
+            .fetch_add(1, Ordering::Relaxed)
+            .to_string();
+        self.documents.insert(
+            path,
+            Sent {
+                result_id: result_id.clone(),
+                data,
+            },
+        );
+        result_id
+    }
+
+    /// Forgets what was sent for `path`, once the client has closed it.
+    pub fn forget(&self, path: &Path) {
+        self.documents.remove(path);
+    }
+}
+
+pub fn handle_semantic_tokens_full(
+    snapshot: &WorkspaceSnapshot,
+    sent: &SentTokens,
+    params: &SemanticTokensParams,
+) -> Option<SemanticTokensResult> {
+    let start = Instant::now();
+    let path = uri_to_path_buf(&params.text_document.uri).ok()?;
+    let data = snapshot.semantic_tokens.get(&path)?.clone();
+    let tokens = to_tokens(&data);
+    let result_id = sent.record(path, data);
+
+    debug!(
+        "semantic tokens in {}: {} -> {} tokens",
+        start.elapsed().log_str(),
+        params.text_document.uri.path(),
+        tokens.len()
+    );
+    Some(SemanticTokensResult::Tokens(SemanticTokens {
+        result_id: Some(result_id),
+        data: tokens,
+    }))
+}
+
+/// Answers with the edits from the tokens last sent to the current ones, or
+/// with all of them if the client asked about tokens other than those.
+pub fn handle_semantic_tokens_full_delta(
+    snapshot: &WorkspaceSnapshot,
+    sent: &SentTokens,
+    params: &SemanticTokensDeltaParams,
+) -> Option<SemanticTokensFullDeltaResult> {
+    let start = Instant::now();
+    let path = uri_to_path_buf(&params.text_document.uri).ok()?;
+    let data = snapshot.semantic_tokens.get(&path)?.clone();
+    let edits = sent
+        .documents
+        .get(&path)
+        .filter(|previous| previous.result_id == params.previous_result_id)
+        .map(|previous| diff(&previous.data, &data));
+    let result_id = Some(sent.record(path, data.clone()));
+
+    debug!(
+        "semantic tokens delta in {}: {} -> {}",
+        start.elapsed().log_str(),
+        params.text_document.uri.path(),
+        edits.as_ref().map_or_else(
+            || format!("{} tokens", data.len() / TOKEN_LEN),
+            |edits| format!("{} edits", edits.len())
+        )
+    );
+    Some(match edits {
+        Some(edits) => {
+            SemanticTokensFullDeltaResult::TokensDelta(SemanticTokensDelta { result_id, edits })
+        }
+        None => SemanticTokensFullDeltaResult::Tokens(SemanticTokens {
+            result_id,
+            data: to_tokens(&data),
+        }),
+    })
+}
+
+/// The edit that replaces the tokens between those `old` and `new` start and
+/// end with, or none if they are the same. Since each token is relative to
+/// the one before it, an edit of the document only changes the tokens it
+/// touched and the one after them.
+fn diff(old: &[u32], new: &[u32]) -> Vec<SemanticTokensEdit> {
+    let prefix = old
+        .chunks_exact(TOKEN_LEN)
+        .zip(new.chunks_exact(TOKEN_LEN))
+        .take_while(|(a, b)| a == b)
+        .count()
+        * TOKEN_LEN;
+    let (old_rest, new_rest) = (&old[prefix..], &new[prefix..]);
+    let suffix = old_rest
+        .chunks_exact(TOKEN_LEN)
+        .rev()
+        .zip(new_rest.chunks_exact(TOKEN_LEN).rev())
+        .take_while(|(a, b)| a == b)
+        .count()
+        * TOKEN_LEN;
+    if old_rest.len() == suffix && new_rest.len() == suffix {
+        return vec![];
+    }
+    vec![SemanticTokensEdit {
+        start: as_pos_idx(prefix),
+        delete_count: as_pos_idx(old_rest.len() - suffix),
+        data: Some(to_tokens(&new_rest[..new_rest.len() - suffix])),
+    }]
+}
+
+fn to_tokens(data: &[u32]) -> Vec<SemanticToken> {
+    data.chunks_exact(TOKEN_LEN)
+        .map(|token| SemanticToken {
+            delta_line: token[0],
+            delta_start: token[1],
+            length: token[2],
+            token_type: token[3],
+            token_modifiers_bitset: token[4],
+        })
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi;
+
+    #[test]
+    fn test_legend_matches_parser() {
+        let types = [
+            (ffi::SEMANTIC_TOKEN_KEYWORD, SemanticTokenType::KEYWORD),
+            (ffi::SEMANTIC_TOKEN_TABLE, SemanticTokenType::CLASS),
+            (ffi::SEMANTIC_TOKEN_UNION, SemanticTokenType::new("union")),
+            (ffi::SEMANTIC_TOKEN_NUMBER, SemanticTokenType::NUMBER),
+        ];
+        for (kind, token_type) in types {
+            assert_eq!(TOKEN_TYPES[kind as usize], token_type);
+        }
+        assert_eq!(TOKEN_TYPES.len(), ffi::SEMANTIC_TOKEN_NUMBER as usize + 1);
+        assert_eq!(
+            TOKEN_MODIFIERS[ffi::SEMANTIC_TOKEN_MODIFIER_DEPRECATED.trailing_zeros() as usize],
+            SemanticTokenModifier::DEPRECATED
+        );
+    }
+
+    #[test]
+    fn test_diff() {
+        let a = [0, 0, 5, 0, 0];
+        let b = [1, 2, 3, 4, 0];
+        let c = [0, 6, 4, 2, 0];
+        let old = [a, b, c].concat();
+
+        assert!(diff(&old, &old).is_empty());
+
+        let changed = diff(&old, &[a, c, c].concat());
+        assert_eq!(changed.len(), 1);
+        assert_eq!(changed[0].start, 5);
+        assert_eq!(changed[0].delete_count, 5);
+        assert_eq!(changed[0].data, Some(to_tokens(&c)));
+
+        let inserted = diff(&old, &[a, b, b, c].concat());
+        assert_eq!(inserted[0].start, 10);
+        assert_eq!(inserted[0].delete_count, 0);
+        assert_eq!(inserted[0].data, Some(to_tokens(&b)));
+
+        let removed = diff(&old, &[a, c].concat());
+        assert_eq!(removed[0].start, 5);
+        assert_eq!(removed[0].delete_count, 5);
+        assert_eq!(removed[0].data, Some(vec![]));
+    }
+}
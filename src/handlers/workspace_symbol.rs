@@ -1,12 +1,15 @@
 use crate::analysis::WorkspaceSnapshot;
 use crate::ext::duration::DurationFormat;
+use crate::symbol_table::Symbol;
 use log::debug;
 use nucleo_matcher::pattern::{CaseMatching, Normalization, Pattern};
 use nucleo_matcher::{Config, Matcher};
+use std::cmp::Reverse;
+use std::sync::Arc;
 use std::time::Instant;
 use tower_lsp_server::lsp_types::{OneOf, WorkspaceSymbol, WorkspaceSymbolParams};
 
-fn to_workspace_symbol(symbol: &crate::symbol_table::Symbol) -> WorkspaceSymbol {
+fn to_workspace_symbol(symbol: &Symbol) -> WorkspaceSymbol {
     WorkspaceSymbol {
         name: symbol.info.name.clone(),
         kind: (&symbol.kind).into(),
@@ -21,60 +24,63 @@ fn to_workspace_symbol(symbol: &crate::symbol_table::Symbol) -> WorkspaceSymbol
     }
 }
 
+/// The most symbols a query is answered with. Clients narrow the results down
+/// further as the query is typed, so only the best matches are needed.
+const MAX_SYMBOLS: usize = 256;
+
 pub fn handle_workspace_symbol(
-    snapshot: &WorkspaceSnapshot<'_>,
+    snapshot: &WorkspaceSnapshot,
     params: &WorkspaceSymbolParams,
 ) -> Vec<WorkspaceSymbol> {
     struct SymbolWrapper<'a> {
-        symbol: &'a WorkspaceSymbol,
+        symbol: &'a Symbol,
     }
 
     impl AsRef<str> for SymbolWrapper<'_> {
         fn as_ref(&self) -> &str {
-            &self.symbol.name
+            &self.symbol.info.name
         }
     }
 
     let start = Instant::now();
+    let symbols = &snapshot.symbols;
 
     let result = if params.query.is_empty() {
         // TODO: Should this include RPC methods? Omitting for now for simplicity.
-        let mut symbols: Vec<WorkspaceSymbol> = snapshot
-            .symbols
-            .global
-            .values()
+        symbols
+            .search
+            .by_name()
+            .filter_map(|key| symbols.global.get(key).map(Arc::as_ref))
             .filter(|symbol| !symbol.info.builtin)
+            .take(MAX_SYMBOLS)
             .map(to_workspace_symbol)
-            .collect();
-        symbols.sort_by(|a, b| a.name.cmp(&b.name));
-        symbols
+            .collect()
     } else {
-        let symbols: Vec<WorkspaceSymbol> = snapshot
-            .symbols
-            .global
-            .values()
+        // Only the symbols whose name has every letter of the query can match it.
+        let candidates = symbols
+            .search
+            .with_bytes(&required_bytes(&params.query))
+            .into_iter()
+            .filter_map(|key| symbols.global.get(key).map(Arc::as_ref))
             .filter(|symbol| !symbol.info.builtin)
-            .map(to_workspace_symbol)
-            .collect();
-
-        let wrapped_symbols: Vec<SymbolWrapper> = symbols
-            .iter()
-            .map(|s| SymbolWrapper { symbol: s })
-            .collect();
+            .map(|symbol| SymbolWrapper { symbol });
 
         let mut matcher = Matcher::new(Config::DEFAULT);
         let pattern = Pattern::parse(&params.query, CaseMatching::Ignore, Normalization::Smart);
 
-        let mut symbol_matches = pattern.match_list(wrapped_symbols, &mut matcher);
-        symbol_matches
-            .sort_by_key(|(s, score)| (std::cmp::Reverse(*score), s.symbol.name.as_str()));
+        let mut symbol_matches = pattern.match_list(candidates, &mut matcher);
+        if symbol_matches.len() > MAX_SYMBOLS {
+            symbol_matches.select_nth_unstable_by_key(MAX_SYMBOLS, |(s, score)| {
+                (Reverse(*score), s.symbol.info.name.as_str())
+            });
+            symbol_matches.truncate(MAX_SYMBOLS);
+        }
+        symbol_matches.sort_by_key(|(s, score)| (Reverse(*score), s.symbol.info.name.as_str()));
 
-        let result: Vec<WorkspaceSymbol> = symbol_matches
+        symbol_matches
             .into_iter()
-            .map(|(wrapper, _)| wrapper.symbol.clone())
-            .collect();
-
-        result
+            .map(|(wrapper, _)| to_workspace_symbol(wrapper.symbol))
+            .collect()
     };
 
     let elapsed = start.elapsed();
@@ -86,3 +92,30 @@ pub fn handle_workspace_symbol(
 
     result
 }
+
+/// The bytes that a name has to have, ignoring case, to match `query`: the
+/// letters, digits and underscores of each of its words, but the negated ones.
+fn required_bytes(query: &str) -> Vec<u8> {
+    let mut bytes: Vec<u8> = query
+        .split_whitespace()
+        .filter(|word| !word.starts_with('!'))
+        .flat_map(str::bytes)
+        .filter(|byte| byte.is_ascii_alphanumeric() || *byte == b'_')
+        .map(|byte| byte.to_ascii_lowercase())
+        .collect();
+    bytes.sort_unstable();
+    bytes.dedup();
+    bytes
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_required_bytes() {
+        assert_eq!(required_bytes("MyT"), b"myt");
+        assert_eq!(required_bytes("^Mon ster$ !Old"), b"emnorst");
+        assert!(required_bytes("!Old").is_empty());
+    }
+}
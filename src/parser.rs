@@ -1,22 +1,28 @@
 use crate::diagnostics;
+use crate::diagnostics::{ParserMessage, ParserMessageKind};
 use crate::ffi;
 use crate::symbol_table::RpcMethod;
 use crate::symbol_table::RpcMethodType;
 use crate::symbol_table::RpcService;
 use crate::symbol_table::{
-    Enum, EnumVariant, Field, RootTypeInfo, Struct, Symbol, SymbolInfo, SymbolKind, SymbolTable,
-    Table, Union, UnionVariant,
+    Documentation, Enum, EnumVariant, Field, Occurrence, RootTypeInfo, Struct, Symbol, SymbolInfo,
+    SymbolKind, SymbolTable, Table, Union, UnionVariant,
 };
 use crate::utils::as_pos_idx;
 use crate::utils::parsed_type::parse_type;
 use log::{debug, error};
 use std::collections::HashMap;
-use std::ffi::c_char;
+use std::ffi::{c_char, c_void};
 use std::ffi::{CStr, CString};
 use std::fs;
+use std::marker::PhantomData;
+use std::panic::{self, AssertUnwindSafe};
 use std::path::{Path, PathBuf};
 use std::string::ToString;
-use tower_lsp_server::lsp_types::{Diagnostic, Position, Range};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex, PoisonError};
+use std::time::Duration;
+use tower_lsp_server::lsp_types::{Diagnostic, DiagnosticSeverity, Position, Range};
 
 #[derive(Default)]
 pub struct ParseResult {
@@ -25,6 +31,14 @@ pub struct ParseResult {
     pub includes: Vec<PathBuf>,
     pub root_type_info: Option<RootTypeInfo>,
     pub user_defined_attributes: HashMap<String, String>,
+    /// The references to types in the parsed file itself.
+    pub occurrences: Vec<Occurrence>,
+    /// The semantic tokens of the parsed file itself, in the LSP wire layout
+    /// with the legend of [`crate::handlers::semantic_tokens::legend`].
+    pub semantic_tokens: Vec<u32>,
+    /// The names of the includes, of the file or the files it includes, that
+    /// couldn't be found. A new file or search path can change the parse.
+    pub unresolved_includes: Vec<String>,
 }
 
 /// A trait for parsing `FlatBuffers` schema files.
@@ -32,101 +46,640 @@ pub trait Parser {
     fn parse(&self, path: &Path, content: &str, search_paths: &[PathBuf]) -> ParseResult;
 }
 
-#[derive(Debug, Clone, Copy)]
-pub struct FlatcFFIParser;
+/// The definitions of included files, kept between parses so that a change to
+/// one schema doesn't re-parse every file it includes. Entries are keyed by
+/// path and content hash, so edits to an included file are always picked up.
+#[derive(Debug)]
+pub struct IncludeCache {
+    ptr: *mut ffi::FlatbuffersIncludeCache,
+}
+
+// The C++ side guards the cache with a mutex.
+unsafe impl Send for IncludeCache {}
+unsafe impl Sync for IncludeCache {}
+
+impl IncludeCache {
+    #[must_use]
+    pub fn new() -> Self {
+        Self {
+            ptr: unsafe { ffi::create_include_cache() },
+        }
+    }
+
+    /// Forget which file each include resolved to, since a file that was
+    /// added may now be found first, and one that was removed can't be.
+    pub fn forget_include_resolutions(&self) {
+        unsafe { ffi::forget_include_resolutions(self.ptr) };
+    }
+}
+
+impl Default for IncludeCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Drop for IncludeCache {
+    fn drop(&mut self) {
+        unsafe { ffi::delete_include_cache(self.ptr) };
+    }
+}
+
+/// How many schemas [`FlatcFFIParser::incremental`] keeps the parser of.
+const MAX_RETAINED_PARSERS: usize = 8;
+
+/// How many bytes of old copies of its schema a retained parser may keep alive
+/// before the schema is parsed in full again, which lets them go.
+const MAX_RETAINED_SOURCE_BYTES: usize = 32 * 1024 * 1024;
+
+/// The parsers kept by [`FlatcFFIParser::incremental`], by the path of the
+/// schema they last parsed.
+#[derive(Debug, Default)]
+struct RetainedParsers {
+    parsers: Mutex<HashMap<PathBuf, RetainedParser>>,
+}
+
+impl RetainedParsers {
+    fn take(&self, path: &Path) -> Option<RetainedParser> {
+        self.parsers
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+            .remove(path)
+    }
+
+    fn put(&self, path: PathBuf, parser: RetainedParser) {
+        let mut parsers = self.parsers.lock().unwrap_or_else(PoisonError::into_inner);
+        if parsers.len() >= MAX_RETAINED_PARSERS && !parsers.contains_key(&path) {
+            // Any will do, it only costs that schema a full parse.
+            if let Some(evicted) = parsers.keys().next().cloned() {
+                parsers.remove(&evicted);
+            }
+        }
+        parsers.insert(path, parser);
+    }
+}
+
+/// A parser from the pool, holding on to everything it parsed.
+#[derive(Debug)]
+struct RetainedParser {
+    ptr: *mut ffi::FlatbuffersParser,
+    search_paths: Vec<PathBuf>,
+    /// The size of the copies of the schema its reparses keep alive.
+    source_bytes: usize,
+}
+
+// It is only ever used by whoever took it out of its `RetainedParsers`.
+unsafe impl Send for RetainedParser {}
+
+impl Drop for RetainedParser {
+    fn drop(&mut self) {
+        unsafe { ffi::release_parser(self.ptr) };
+    }
+}
+
+#[derive(Debug, Clone, Default)]
+pub struct FlatcFFIParser {
+    include_cache: Option<Arc<IncludeCache>>,
+    retained: Option<Arc<RetainedParsers>>,
+}
+
+impl FlatcFFIParser {
+    /// Create a parser that reuses included files from `include_cache`.
+    #[must_use]
+    pub fn with_include_cache(include_cache: Arc<IncludeCache>) -> Self {
+        Self {
+            include_cache: Some(include_cache),
+            retained: None,
+        }
+    }
+
+    /// Keep what [`Self::parse_with_overlay`] parsed from each schema, so that
+    /// parsing it again after an edit inside the braces of one table only
+    /// parses the fields of that table again.
+    #[must_use]
+    pub fn incremental(mut self) -> Self {
+        self.retained = Some(Arc::default());
+        self
+    }
+
+    /// See [`IncludeCache::forget_include_resolutions`].
+    pub fn forget_include_resolutions(&self) {
+        if let Some(include_cache) = &self.include_cache {
+            include_cache.forget_include_resolutions();
+        }
+    }
+}
 
 impl Parser for FlatcFFIParser {
     fn parse(&self, path: &Path, content: &str, search_paths: &[PathBuf]) -> ParseResult {
-        let Ok(c_content) = CString::new(content) else {
-            return ParseResult::default();
-        };
+        self.parse_with_overlay(path, content, search_paths, &[], &AtomicBool::new(false))
+            .unwrap_or_default()
+    }
+}
+
+impl FlatcFFIParser {
+    /// Parse like [`Parser::parse`], but read any included file found in
+    /// `overlay` from there instead of from disk. This lets includers see the
+    /// unsaved contents of open documents.
+    ///
+    /// Returns `None` if `cancel` was set before the parse finished, which
+    /// makes flatc give up at its next declaration or include.
+    pub fn parse_with_overlay(
+        &self,
+        path: &Path,
+        content: &str,
+        search_paths: &[PathBuf],
+        overlay: &[(PathBuf, String)],
+        cancel: &AtomicBool,
+    ) -> Option<ParseResult> {
+        // flatc would read a NUL as the end of the schema.
+        if content.contains('\0') {
+            return Some(ParseResult::default());
+        }
         let Ok(c_filename) = CString::new(path.to_str().unwrap_or_default()) else {
-            return ParseResult::default();
+            return Some(ParseResult::default());
+        };
+        let mut options = FfiParseOptions::new(search_paths, overlay);
+
+        unsafe {
+            if let Some(result) = self.reparse(path, content, search_paths, &options) {
+                return Some(result);
+            }
+            // Pooled parsers keep the memory of their last parse, so most of this
+            // one doesn't have to be allocated again.
+            let parser_ptr = ffi::acquire_parser();
+            if parser_ptr.is_null() {
+                return Some(ParseResult::default());
+            }
+            // The content is passed by length, so flatc makes its copy
+            // straight from it.
+            ffi::parse_schema_buffer(
+                parser_ptr,
+                content.as_ptr().cast(),
+                content.len(),
+                c_filename.as_ptr(),
+                options.search_path_ptrs.as_mut_ptr(),
+                options.virtual_files.as_ptr(),
+                options.virtual_files.len(),
+                self.include_cache_ptr(),
+                cancel.as_ptr(),
+            );
+            let result = (!ffi::is_parser_cancelled(parser_ptr))
+                .then(|| collect_parse_result(parser_ptr, path, content, search_paths));
+            match &self.retained {
+                Some(retained) if result.is_some() => retained.put(
+                    path.to_path_buf(),
+                    RetainedParser {
+                        ptr: parser_ptr,
+                        search_paths: search_paths.to_vec(),
+                        source_bytes: 0,
+                    },
+                ),
+                _ => ffi::release_parser(parser_ptr),
+            }
+            result
+        }
+    }
+
+    /// Parses `path` with the parser retained from its last parse, if that
+    /// only has to parse one table again. See [`Self::incremental`].
+    unsafe fn reparse(
+        &self,
+        path: &Path,
+        content: &str,
+        search_paths: &[PathBuf],
+        options: &FfiParseOptions,
+    ) -> Option<ParseResult> {
+        let retained = self.retained.as_ref()?;
+        let mut parser = retained.take(path)?;
+        if parser.search_paths != search_paths
+            || parser.source_bytes + content.len() > MAX_RETAINED_SOURCE_BYTES
+            || !ffi::reparse_schema(
+                parser.ptr,
+                content.as_ptr().cast(),
+                content.len(),
+                options.virtual_files.as_ptr(),
+                options.virtual_files.len(),
+            )
+        {
+            return None;
+        }
+        parser.source_bytes += content.len();
+        debug!("reparsed one table of {}", path.display());
+        let result = collect_parse_result(parser.ptr, path, content, search_paths);
+        retained.put(path.to_path_buf(), parser);
+        Some(result)
+    }
+
+    /// Parse every schema of `schemas` like [`Self::parse_with_overlay`], spread
+    /// over flatc's worker threads. Results are in the order of `schemas`, and
+    /// are `None` for a schema whose results couldn't be collected because
+    /// collecting them panicked.
+    ///
+    /// Returns `None` if `cancel` is set by the time the batch is done, since
+    /// some of the schemas may have been given up on.
+    pub fn parse_batch(
+        &self,
+        schemas: &[BatchSchema],
+        search_paths: &[PathBuf],
+        overlay: &[(PathBuf, String)],
+        cancel: &AtomicBool,
+    ) -> Option<Vec<Option<ParseResult>>> {
+        // Not worth handing over to other threads.
+        if let [schema] = schemas {
+            if !schema.has_includers {
+                return self
+                    .parse_with_overlay(
+                        &schema.path,
+                        &schema.content,
+                        search_paths,
+                        overlay,
+                        cancel,
+                    )
+                    .map(|result| vec![Some(result)]);
+            }
+        }
+
+        let mut indices = Vec::with_capacity(schemas.len());
+        let mut c_filenames = Vec::with_capacity(schemas.len());
+        for (i, schema) in schemas.iter().enumerate() {
+            if schema.content.contains('\0') {
+                continue;
+            }
+            let Ok(c_filename) = CString::new(schema.path.to_str().unwrap_or_default()) else {
+                continue;
+            };
+            indices.push(i);
+            c_filenames.push(c_filename);
+        }
+        let sources: Vec<ffi::SchemaSource> = indices
+            .iter()
+            .zip(&c_filenames)
+            .map(|(&i, c_filename)| ffi::SchemaSource {
+                content: schemas[i].content.as_ptr().cast(),
+                length: schemas[i].content.len(),
+                filename: c_filename.as_ptr(),
+                cache_definitions: schemas[i].has_includers,
+            })
+            .collect();
+        let mut options = FfiParseOptions::new(search_paths, overlay);
+
+        let context = BatchContext {
+            schemas,
+            search_paths,
+            indices: &indices,
+            // Schemas flatc can't be given keep an empty result, as they do
+            // when parsed alone.
+            results: Mutex::new(
+                (0..schemas.len())
+                    .map(|i| {
+                        indices
+                            .binary_search(&i)
+                            .is_err()
+                            .then(ParseResult::default)
+                    })
+                    .collect(),
+            ),
         };
+        unsafe {
+            ffi::parse_schemas_batch(
+                sources.as_ptr(),
+                sources.len(),
+                options.search_path_ptrs.as_mut_ptr(),
+                options.virtual_files.as_ptr(),
+                options.virtual_files.len(),
+                self.include_cache_ptr(),
+                cancel.as_ptr(),
+                Some(on_batch_parsed),
+                std::ptr::from_ref(&context).cast_mut().cast(),
+            );
+        }
+        if cancel.load(Ordering::Relaxed) {
+            return None;
+        }
+        Some(
+            context
+                .results
+                .into_inner()
+                .unwrap_or_else(PoisonError::into_inner),
+        )
+    }
+
+    fn include_cache_ptr(&self) -> *mut ffi::FlatbuffersIncludeCache {
+        self.include_cache
+            .as_ref()
+            .map_or(std::ptr::null_mut(), |cache| cache.ptr)
+    }
+}
+
+/// A schema for [`FlatcFFIParser::parse_batch`].
+#[derive(Debug, Clone)]
+pub struct BatchSchema {
+    pub path: PathBuf,
+    pub content: String,
+    /// Whether other files include this one. If they do, its definitions are
+    /// added to the include cache so that their parses can import them.
+    pub has_includers: bool,
+}
+
+/// The search paths and overlay of a parse, as the C API takes them.
+struct FfiParseOptions<'a> {
+    _search_paths: Vec<CString>,
+    search_path_ptrs: Vec<*const c_char>,
+    _overlay_paths: Vec<CString>,
+    virtual_files: Vec<ffi::VirtualFile>,
+    _overlay: PhantomData<&'a [(PathBuf, String)]>,
+}
 
+impl<'a> FfiParseOptions<'a> {
+    fn new(search_paths: &[PathBuf], overlay: &'a [(PathBuf, String)]) -> Self {
         let c_search_paths: Vec<CString> = search_paths
             .iter()
             .filter_map(|path| CString::new(path.to_str().unwrap_or_default()).ok())
             .collect();
 
-        let mut c_path_ptrs: Vec<*const c_char> =
+        let mut search_path_ptrs: Vec<*const c_char> =
             c_search_paths.iter().map(|s| s.as_ptr()).collect();
-        c_path_ptrs.push(std::ptr::null());
+        search_path_ptrs.push(std::ptr::null());
 
-        unsafe {
-            let parser_ptr = ffi::parse_schema(
-                c_content.as_ptr(),
-                c_filename.as_ptr(),
-                c_path_ptrs.as_mut_ptr(),
-            );
-            if parser_ptr.is_null() {
-                return ParseResult::default();
-            }
+        let (overlay_paths, texts): (Vec<CString>, Vec<&String>) = overlay
+            .iter()
+            .filter_map(|(path, text)| {
+                CString::new(path.to_str().unwrap_or_default())
+                    .ok()
+                    .map(|c_path| (c_path, text))
+            })
+            .unzip();
+        let virtual_files = overlay_paths
+            .iter()
+            .zip(texts)
+            .map(|(c_path, text)| ffi::VirtualFile {
+                path: c_path.as_ptr(),
+                contents: text.as_ptr().cast::<c_char>(),
+                length: text.len(),
+            })
+            .collect();
 
-            let mut diagnostics = parse_error_messages(parser_ptr, path, content);
-
-            let mut st = SymbolTable::new(path.to_path_buf());
-            extract_structs_and_tables(parser_ptr, &mut st);
-            extract_enums_and_unions(parser_ptr, &mut st);
-            extract_rpc_services(parser_ptr, &mut st);
-
-            let included_files = extract_all_included_files(parser_ptr); // recursive. includes transient includes.
-            let root_type_info = extract_root_type(parser_ptr);
-            let user_defined_attributes = extract_user_defined_attributes(parser_ptr);
-
-            let include_graph = build_include_graph(parser_ptr); // direct includes only.
-            diagnostics::semantic::analyze_unused_includes(
-                &st,
-                &mut diagnostics,
-                content,
-                &include_graph,
-                search_paths,
-                &root_type_info,
-            );
-            diagnostics::semantic::analyze_deprecated_fields(&st, &mut diagnostics);
-
-            let result = ParseResult {
-                diagnostics,
-                symbol_table: Some(st),
-                includes: included_files,
-                root_type_info,
-                user_defined_attributes,
-            };
+        Self {
+            _search_paths: c_search_paths,
+            search_path_ptrs,
+            _overlay_paths: overlay_paths,
+            virtual_files,
+            _overlay: PhantomData,
+        }
+    }
+}
 
-            ffi::delete_parser(parser_ptr);
+/// What [`on_batch_parsed`] needs to collect the results of a batch.
+struct BatchContext<'a> {
+    schemas: &'a [BatchSchema],
+    search_paths: &'a [PathBuf],
+    // Index into `schemas` of each source passed to flatc.
+    indices: &'a [usize],
+    results: Mutex<Vec<Option<ParseResult>>>,
+}
 
-            result
-        }
+/// Collects one schema of [`FlatcFFIParser::parse_batch`]. Called from flatc's
+/// worker threads, several at a time.
+///
+/// A panic can't unwind into flatc, so one collecting a schema is caught here
+/// and leaves its result `None`.
+unsafe extern "C" fn on_batch_parsed(
+    context: *mut c_void,
+    index: usize,
+    parser_ptr: *mut ffi::FlatbuffersParser,
+) {
+    let context = &*context.cast::<BatchContext>();
+    let Some(&schema_index) = context.indices.get(index) else {
+        return;
+    };
+    if ffi::is_parser_cancelled(parser_ptr) {
+        return;
     }
+    let schema = &context.schemas[schema_index];
+    let result = panic::catch_unwind(AssertUnwindSafe(|| {
+        collect_parse_result(
+            parser_ptr,
+            &schema.path,
+            &schema.content,
+            context.search_paths,
+        )
+    }));
+    let result = match result {
+        Ok(result) => result,
+        Err(_) => {
+            error!("collecting the parse of {} panicked", schema.path.display());
+            return;
+        }
+    };
+    context
+        .results
+        .lock()
+        .unwrap_or_else(PoisonError::into_inner)[schema_index] = Some(result);
 }
 
-/// Parse flatc's error messages (in the error case) or warnings (in the success case).
-unsafe fn parse_error_messages(
+/// Converts what flatc parsed from `path` into a [`ParseResult`].
+unsafe fn collect_parse_result(
     parser_ptr: *mut ffi::FlatbuffersParser,
     path: &Path,
     content: &str,
+    search_paths: &[PathBuf],
+) -> ParseResult {
+    let messages = extract_messages(parser_ptr);
+    let unresolved_includes = messages
+        .iter()
+        .filter(|message| message.kind == ParserMessageKind::UnresolvedInclude)
+        .filter_map(|message| message.args.first().cloned())
+        .collect();
+    let mut diagnostics = error_diagnostics(&messages, path, content);
+
+    let mut st = SymbolTable::new(path.to_path_buf());
+    let mut occurrences = Vec::new();
+    if let Some(export) = SchemaExport::new(parser_ptr) {
+        extract_structs_and_tables(&export, &mut st);
+        extract_enums_and_unions(&export, &mut st);
+        extract_rpc_services(&export, &mut st);
+        occurrences = extract_occurrences(&export, path);
+    }
+
+    let Includes {
+        all: included_files,   // recursive. includes transient includes.
+        direct: include_graph, // direct includes only.
+    } = extract_includes(parser_ptr);
+    let root_type_info = extract_root_type(parser_ptr);
+    let user_defined_attributes = extract_user_defined_attributes(parser_ptr);
+    let tokens = ffi::get_semantic_tokens(parser_ptr);
+    let semantic_tokens = ffi_slice(tokens.data, tokens.length).to_vec();
+
+    diagnostics::semantic::analyze_unused_includes(
+        &st,
+        &mut diagnostics,
+        content,
+        &include_graph,
+        search_paths,
+        &occurrences,
+    );
+    diagnostics::semantic::analyze_deprecated_fields(&st, &mut diagnostics);
+
+    log_parse_stats(parser_ptr, path);
+    debug!(
+        "flatc made {} string allocations exporting {}",
+        ffi::get_string_allocation_count(parser_ptr),
+        path.display()
+    );
+
+    ParseResult {
+        diagnostics,
+        symbol_table: Some(st),
+        includes: included_files,
+        root_type_info,
+        user_defined_attributes,
+        occurrences,
+        semantic_tokens,
+        unresolved_includes,
+    }
+}
+
+/// Logs where flatc spent its time and memory parsing and exporting a schema.
+unsafe fn log_parse_stats(parser_ptr: *mut ffi::FlatbuffersParser, path: &Path) {
+    let stats = ffi::get_parse_stats(parser_ptr);
+    let time = Duration::from_nanos;
+    debug!(
+        "flatc parsed {} in {:?} (file setup {:?}, include resolution {:?}, declarations {:?} \
+         with clash checks {:?}, final checks {:?}) and exported it in {:?}; \
+         {} tokens, {} bytes, {} includes parsed, {} include cache hits, {} misses",
+        path.display(),
+        time(stats.parse_ns),
+        time(stats.start_parse_file_ns),
+        time(stats.include_resolve_ns),
+        time(stats.declarations_ns),
+        time(stats.check_clash_ns),
+        time(stats.checks_ns),
+        time(stats.export_ns),
+        stats.tokens,
+        stats.bytes_scanned,
+        stats.includes_parsed,
+        stats.include_cache_hits,
+        stats.include_cache_misses
+    );
+    if cfg!(feature = "parse-memory-stats") {
+        debug!(
+            "flatc parsing {} peaked at {} bytes of memory, {} bytes retained",
+            path.display(),
+            stats.peak_bytes,
+            stats.retained_bytes
+        );
+    }
+}
+
+/// Turn flatc's errors (in the error case) or warnings (in the success case) into diagnostics.
+fn error_diagnostics(
+    messages: &[ParserMessage],
+    path: &Path,
+    content: &str,
 ) -> HashMap<PathBuf, Vec<Diagnostic>> {
-    let error_str_ptr = ffi::get_parser_error(parser_ptr);
-    if let Some(error_str) = c_str_to_optional_string(error_str_ptr).take_if(|s| !s.is_empty()) {
-        debug!("flatc error parsing {}: {}", path.display(), error_str);
-        diagnostics::generate_diagnostics_from_error_string(&error_str, path, content)
-    } else {
-        HashMap::new()
+    if messages.is_empty() {
+        return HashMap::new();
     }
+    debug!(
+        "flatc reported {} messages parsing {}",
+        messages.len(),
+        path.display()
+    );
+    diagnostics::generate_diagnostics_from_messages(messages, path, content)
 }
 
-/// Extracts all included file paths from the parser.
-unsafe fn extract_all_included_files(parser_ptr: *mut ffi::FlatbuffersParser) -> Vec<PathBuf> {
-    let mut included_files = Vec::new();
-    let num_included = ffi::get_num_all_included_files(parser_ptr);
-    for i in 0..num_included {
-        if let Some(path) = c_str_to_optional_string(ffi::get_all_included_file_path(parser_ptr, i))
-            .and_then(|p| fs::canonicalize(&p).ok())
-        {
-            included_files.push(path);
-        }
+/// The canonical path of a file flatc reports. flatc canonicalizes the files
+/// it includes from disk, and is given canonical paths for everything else, so
+/// only relative paths and Windows paths, which flatc leaves alone, need work.
+fn flatc_file_path(file: &str) -> Option<PathBuf> {
+    let path = Path::new(file);
+    if cfg!(windows) || !path.is_absolute() {
+        return fs::canonicalize(path).ok();
+    }
+    Some(path.to_path_buf())
+}
+
+/// Extracts flatc's warnings and errors, skipping any whose file can't be canonicalized.
+unsafe fn extract_messages(parser_ptr: *mut ffi::FlatbuffersParser) -> Vec<ParserMessage> {
+    let list = ffi::get_diagnostics(parser_ptr);
+
+    // Canonicalize each file once, however many messages it has.
+    let files: Vec<Option<PathBuf>> = ffi_slice(list.files, list.num_files)
+        .iter()
+        .map(|&file| c_str_to_optional_string(file).and_then(|p| flatc_file_path(&p)))
+        .collect();
+
+    ffi_slice(list.records, list.num_records)
+        .iter()
+        .filter_map(|record| {
+            let path = files.get(record.file as usize)?.clone()?;
+            let severity = if record.severity == ffi::DIAGNOSTIC_WARNING {
+                DiagnosticSeverity::WARNING
+            } else {
+                DiagnosticSeverity::ERROR
+            };
+            let kind = match record.kind {
+                ffi::DIAGNOSTIC_DUPLICATE_DEFINITION => ParserMessageKind::DuplicateDefinition,
+                ffi::DIAGNOSTIC_EXPECTING_TOKEN => ParserMessageKind::ExpectingToken,
+                ffi::DIAGNOSTIC_UNDEFINED_TYPE => ParserMessageKind::UndefinedType,
+                ffi::DIAGNOSTIC_NON_SNAKE_CASE => ParserMessageKind::NonSnakeCase,
+                ffi::DIAGNOSTIC_UNRESOLVED_INCLUDE => ParserMessageKind::UnresolvedInclude,
+                _ => ParserMessageKind::Generic,
+            };
+            Some(ParserMessage {
+                path,
+                severity,
+                kind,
+                line: record.line,
+                col: record.col,
+                range: record.has_range.then(|| record.range.into()),
+                message: c_str_to_optional_string(record.message).unwrap_or_default(),
+                args: ffi_slice(record.args, record.num_args)
+                    .iter()
+                    .map(|&arg| c_str_to_optional_string(arg).unwrap_or_default())
+                    .collect(),
+            })
+        })
+        .collect()
+}
+
+/// The includes of a parse, with every path canonicalized.
+struct Includes {
+    /// Every file included by the schema or its includes, once each.
+    all: Vec<PathBuf>,
+    /// The files each file includes directly.
+    direct: HashMap<String, Vec<String>>,
+}
+
+/// Extracts the include graph from the parser.
+unsafe fn extract_includes(parser_ptr: *mut ffi::FlatbuffersParser) -> Includes {
+    let graph = ffi::get_include_graph(parser_ptr);
+
+    // Canonicalize each file once, however many times it is included.
+    let files: Vec<Option<PathBuf>> = ffi_slice(graph.files, graph.num_files)
+        .iter()
+        .map(|&file| c_str_to_optional_string(file).and_then(|p| flatc_file_path(&p)))
+        .collect();
+    let file_at = |index: u32| files.get(index as usize).and_then(Option::as_ref);
+
+    let all = ffi_slice(graph.all_included, graph.num_all_included)
+        .iter()
+        .filter_map(|&index| file_at(index).cloned())
+        .collect();
+
+    let mut direct: HashMap<String, Vec<String>> = HashMap::new();
+    for edge in ffi_slice(graph.edges, graph.num_edges) {
+        let (Some(from), Some(to)) = (file_at(edge.from), file_at(edge.to)) else {
+            continue;
+        };
+        direct
+            .entry(from.to_string_lossy().into_owned())
+            .or_default()
+            .push(to.to_string_lossy().into_owned());
     }
-    included_files
+
+    Includes { all, direct }
 }
 
 /// Extracts all user-defined attributes from the parser.
@@ -157,24 +710,19 @@ unsafe fn extract_user_defined_attributes(
 }
 
 /// Extracts all struct and table definitions from the parser.
-unsafe fn extract_structs_and_tables(
-    parser_ptr: *mut ffi::FlatbuffersParser,
-    st: &mut SymbolTable,
-) {
-    let num_structs = ffi::get_num_structs(parser_ptr);
-    for i in 0..num_structs {
-        let def_info = ffi::get_struct_info(parser_ptr, i);
-
+fn extract_structs_and_tables(export: &SchemaExport, st: &mut SymbolTable) {
+    for def_info in export.structs() {
         if def_info.is_predeclared {
             // This happens sometimes when there are parsing errors.
             continue;
         }
 
-        let Some(name) = c_str_to_optional_string(def_info.name) else {
+        let Some(name) = export.optional_string(def_info.name) else {
             continue;
         };
 
-        let namespace: Vec<String> = c_str_to_optional_string(def_info.namespace_)
+        let namespace: Vec<String> = export
+            .optional_string(def_info.namespace_)
             .map(|s| s.split('.').map(ToString::to_string).collect())
             .unwrap_or_default();
 
@@ -184,8 +732,8 @@ unsafe fn extract_structs_and_tables(
             format!("{}.{}", namespace.join("."), name)
         };
 
-        let file = c_str_to_string(def_info.file);
-        let Ok(file_path) = fs::canonicalize(&file) else {
+        let file = export.string(def_info.file);
+        let Some(file_path) = flatc_file_path(&file) else {
             error!("failed to canonicalize file: {file} for struct/table named: {qualified_name}");
             continue;
         };
@@ -197,17 +745,15 @@ unsafe fn extract_structs_and_tables(
         }
 
         let mut fields = Vec::new();
-        let num_fields = ffi::get_num_fields(parser_ptr, i);
-        for j in 0..num_fields {
-            let field_info = ffi::get_field_info(parser_ptr, i, j);
-            let Some(field_name) = c_str_to_optional_string(field_info.name) else {
+        for field_info in export.fields_of(def_info) {
+            let Some(field_name) = export.optional_string(field_info.name) else {
                 continue;
             };
 
-            let type_name = c_str_to_string(field_info.base_type_name);
-            let type_display_name = c_str_to_string(field_info.type_name);
+            let type_name = export.string(field_info.base_type_name);
+            let type_display_name = export.string(field_info.type_name);
 
-            let type_source = c_str_to_string(field_info.type_source);
+            let type_source = export.string(field_info.type_source);
 
             let type_range = field_info.type_range.into();
             let Some(parsed_type) = parse_type(&type_source, type_range) else {
@@ -216,7 +762,7 @@ unsafe fn extract_structs_and_tables(
                 continue;
             };
 
-            let documentation = c_str_to_optional_string(field_info.documentation);
+            let documentation = doc_comment(field_info.documentation);
 
             let field_symbol = create_symbol(
                 &file_path,
@@ -247,7 +793,7 @@ unsafe fn extract_structs_and_tables(
             })
         };
 
-        let documentation = c_str_to_optional_string(def_info.documentation);
+        let documentation = doc_comment(def_info.documentation);
 
         let symbol = create_symbol(
             &file_path,
@@ -263,15 +809,14 @@ unsafe fn extract_structs_and_tables(
 }
 
 /// Extracts all enum and union definitions from the parser.
-unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut SymbolTable) {
-    let num_enums = ffi::get_num_enums(parser_ptr);
-    for i in 0..num_enums {
-        let def_info = ffi::get_enum_info(parser_ptr, i);
-        let Some(name) = c_str_to_optional_string(def_info.name) else {
+fn extract_enums_and_unions(export: &SchemaExport, st: &mut SymbolTable) {
+    for def_info in export.enums() {
+        let Some(name) = export.optional_string(def_info.name) else {
             continue;
         };
 
-        let namespace: Vec<String> = c_str_to_optional_string(def_info.namespace_)
+        let namespace: Vec<String> = export
+            .optional_string(def_info.namespace_)
             .map(|s| s.split('.').map(ToString::to_string).collect())
             .unwrap_or_default();
 
@@ -281,8 +826,8 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
             format!("{}.{}", namespace.join("."), name)
         };
 
-        let file = c_str_to_string(def_info.file);
-        let Ok(file_path) = fs::canonicalize(&file) else {
+        let file = export.string(def_info.file);
+        let Some(file_path) = flatc_file_path(&file) else {
             error!("failed to canonicalize file: {file} for enum/union named: {qualified_name}");
             continue;
         };
@@ -294,10 +839,8 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
         }
 
         let mut variants = Vec::new();
-        let num_vals = ffi::get_num_enum_vals(parser_ptr, i);
-        for j in 0..num_vals {
-            let val_info = ffi::get_enum_val_info(parser_ptr, i, j);
-            let Some(val_name) = c_str_to_optional_string(val_info.name) else {
+        for val_info in export.vals_of(def_info) {
+            let Some(val_name) = export.optional_string(val_info.name) else {
                 continue;
             };
 
@@ -307,14 +850,14 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
             variants.push((val_name, val_info));
         }
 
-        let underlying_type = c_str_to_string(def_info.underlying_type);
+        let underlying_type = export.string(def_info.underlying_type);
 
         let symbol_kind = if def_info.is_union {
             SymbolKind::Union(Union {
                 variants: variants
                     .into_iter()
                     .filter_map(|(name, val_info)| {
-                        let type_source = c_str_to_string(val_info.type_source);
+                        let type_source = export.string(val_info.type_source);
                         let type_range = val_info.type_range.into();
                         let Some(parsed_type) = parse_type(&type_source, type_range) else {
                             error!("Failed to parse union variant type at {}:{}:{}. Please open a GitHub Issue: https://github.com/smpanaro/flatbuffers-language-server/issues",
@@ -338,7 +881,7 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
                 variants: variants
                     .into_iter()
                     .map(|(name, val_info)| {
-                        let documentation = c_str_to_optional_string(val_info.documentation);
+                        let documentation = doc_comment(val_info.documentation);
                         EnumVariant {
                             name,
                             value: val_info.value,
@@ -350,7 +893,7 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
             })
         };
 
-        let documentation = c_str_to_optional_string(def_info.documentation);
+        let documentation = doc_comment(def_info.documentation);
 
         let symbol = create_symbol(
             &file_path,
@@ -365,15 +908,14 @@ unsafe fn extract_enums_and_unions(parser_ptr: *mut ffi::FlatbuffersParser, st:
     }
 }
 
-unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut SymbolTable) {
-    let num_services = ffi::get_num_rpc_services(parser_ptr);
-    for i in 0..num_services {
-        let def_info = ffi::get_rpc_service_info(parser_ptr, i);
-        let Some(name) = c_str_to_optional_string(def_info.name) else {
+fn extract_rpc_services(export: &SchemaExport, st: &mut SymbolTable) {
+    for def_info in export.rpc_services() {
+        let Some(name) = export.optional_string(def_info.name) else {
             continue;
         };
 
-        let namespace: Vec<String> = c_str_to_optional_string(def_info.namespace_)
+        let namespace: Vec<String> = export
+            .optional_string(def_info.namespace_)
             .map(|s| s.split('.').map(ToString::to_string).collect())
             .unwrap_or_default();
 
@@ -383,8 +925,8 @@ unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut
             format!("{}.{}", namespace.join("."), name)
         };
 
-        let file = c_str_to_string(def_info.file);
-        let Ok(file_path) = fs::canonicalize(&file) else {
+        let file = export.string(def_info.file);
+        let Some(file_path) = flatc_file_path(&file) else {
             error!("failed to canonicalize file: {file} for rpc_service named: {qualified_name}");
             continue;
         };
@@ -396,12 +938,9 @@ unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut
         }
 
         let mut methods = Vec::new();
-        let num_methods = ffi::get_num_rpc_methods(parser_ptr, i);
-        for j in 0..num_methods {
-            let method_info = ffi::get_rpc_method_info(parser_ptr, i, j);
-
+        for method_info in export.methods_of(def_info) {
             // Method
-            let Some(method_name) = c_str_to_optional_string(method_info.name) else {
+            let Some(method_name) = export.optional_string(method_info.name) else {
                 continue;
             };
             let range = Range::new(
@@ -411,15 +950,16 @@ unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut
                 ),
                 Position::new(method_info.line, method_info.col),
             );
-            let documentation = c_str_to_optional_string(method_info.documentation);
+            let documentation = doc_comment(method_info.documentation);
 
             // Request
-            let Some(request_type_name) = c_str_to_optional_string(method_info.request_type_name)
+            let Some(request_type_name) = export.optional_string(method_info.request_type_name)
             else {
                 continue;
             };
             let request_range = method_info.request_range.into();
-            let Some(request_type) = c_str_to_optional_string(method_info.request_source)
+            let Some(request_type) = export
+                .optional_string(method_info.request_source)
                 .and_then(|source| parse_type(&source, request_range))
                 .map(|parsed| RpcMethodType {
                     name: request_type_name,
@@ -433,12 +973,13 @@ unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut
             };
 
             // Response
-            let Some(response_type_name) = c_str_to_optional_string(method_info.response_type_name)
+            let Some(response_type_name) = export.optional_string(method_info.response_type_name)
             else {
                 continue;
             };
             let response_range = method_info.response_range.into();
-            let Some(response_type) = c_str_to_optional_string(method_info.response_source)
+            let Some(response_type) = export
+                .optional_string(method_info.response_source)
                 .and_then(|source| parse_type(&source, response_range))
                 .map(|parsed| RpcMethodType {
                     name: response_type_name,
@@ -461,7 +1002,7 @@ unsafe fn extract_rpc_services(parser_ptr: *mut ffi::FlatbuffersParser, st: &mut
         }
 
         let symbol_kind = SymbolKind::RpcService(RpcService { methods });
-        let documentation = c_str_to_optional_string(def_info.documentation);
+        let documentation = doc_comment(def_info.documentation);
 
         let symbol = create_symbol(
             &file_path,
@@ -485,7 +1026,7 @@ unsafe fn extract_root_type(parser_ptr: *mut ffi::FlatbuffersParser) -> Option<R
     let qualified_name = c_str_to_string(root_def.name);
     let file = c_str_to_string(root_def.file);
 
-    let Ok(file_path) = fs::canonicalize(&file) else {
+    let Some(file_path) = flatc_file_path(&file) else {
         error!("failed to canonicalize file: {file} for root_type named: {qualified_name}");
         return None;
     };
@@ -509,43 +1050,154 @@ unsafe fn extract_root_type(parser_ptr: *mut ffi::FlatbuffersParser) -> Option<R
     })
 }
 
-unsafe fn build_include_graph(
-    parser_ptr: *mut ffi::FlatbuffersParser,
-) -> HashMap<String, Vec<String>> {
-    let mut include_graph = HashMap::new();
-    let num_files = ffi::get_num_files_with_includes(parser_ptr);
-    for i in 0..num_files {
-        let Some((original_file_path, canonical_file_path)) = c_str_to_optional_string(
-            ffi::get_file_with_includes_path(parser_ptr, i),
-        )
-        .and_then(|original| {
-            fs::canonicalize(&original)
-                .ok()
-                .map(|canon| (original, canon.to_string_lossy().into_owned()))
-        }) else {
-            continue;
-        };
+/// A view of the buffer written by `ffi::export_schema`. It borrows memory
+/// owned by the parser, so it must not outlive the parser.
+struct SchemaExport<'a> {
+    header: &'a ffi::SchemaExportHeader,
+    data: &'a [u8],
+}
 
-        let Ok(c_file_path) = CString::new(original_file_path.clone()) else {
-            continue;
-        };
-        let num_includes = ffi::get_num_includes_for_file(parser_ptr, c_file_path.as_ptr());
-        let mut includes = Vec::new();
-        for j in 0..num_includes {
-            if let Some(include_path) = c_str_to_optional_string(ffi::get_included_file_path(
-                parser_ptr,
-                c_file_path.as_ptr(),
-                j,
-            ))
-            .and_then(|p| fs::canonicalize(p).ok())
-            .map(|p| p.to_string_lossy().into_owned())
-            {
-                includes.push(include_path.clone());
-            }
+impl<'a> SchemaExport<'a> {
+    unsafe fn new(parser_ptr: *mut ffi::FlatbuffersParser) -> Option<Self> {
+        let mut data_ptr: *const u8 = std::ptr::null();
+        let size = ffi::export_schema(parser_ptr, std::ptr::addr_of_mut!(data_ptr));
+        if data_ptr.is_null() || size < std::mem::size_of::<ffi::SchemaExportHeader>() {
+            return None;
         }
-        include_graph.insert(canonical_file_path, includes);
+        let data = std::slice::from_raw_parts(data_ptr, size);
+        #[allow(clippy::cast_ptr_alignment)] // The buffer is allocated with malloc alignment.
+        let header = &*data_ptr.cast::<ffi::SchemaExportHeader>();
+        if header.version != ffi::SCHEMA_EXPORT_VERSION || header.size as usize != size {
+            error!(
+                "unexpected schema export version {} (size {}, expected version {})",
+                header.version,
+                header.size,
+                ffi::SCHEMA_EXPORT_VERSION
+            );
+            return None;
+        }
+        Some(Self { header, data })
+    }
+
+    fn section<T>(&self, section: ffi::ExportedSection) -> &'a [T] {
+        let start = section.offset as usize;
+        let len = section.count as usize;
+        let in_bounds = len
+            .checked_mul(std::mem::size_of::<T>())
+            .and_then(|bytes| start.checked_add(bytes))
+            .is_some_and(|end| end <= self.data.len());
+        if len == 0 || !in_bounds {
+            return &[];
+        }
+        // SAFETY: The range is in bounds and the C++ side aligns each section
+        // for its record type.
+        #[allow(clippy::cast_ptr_alignment)]
+        unsafe {
+            std::slice::from_raw_parts(self.data.as_ptr().add(start).cast::<T>(), len)
+        }
+    }
+
+    fn structs(&self) -> &'a [ffi::ExportedStruct] {
+        self.section(self.header.structs)
+    }
+
+    fn enums(&self) -> &'a [ffi::ExportedEnum] {
+        self.section(self.header.enums)
+    }
+
+    fn rpc_services(&self) -> &'a [ffi::ExportedRpcService] {
+        self.section(self.header.rpc_services)
+    }
+
+    fn fields_of(&self, def: &ffi::ExportedStruct) -> &'a [ffi::ExportedField] {
+        let fields: &[ffi::ExportedField] = self.section(self.header.fields);
+        let start = def.first_field as usize;
+        fields
+            .get(start..start + def.num_fields as usize)
+            .unwrap_or_default()
+    }
+
+    fn vals_of(&self, def: &ffi::ExportedEnum) -> &'a [ffi::ExportedEnumVal] {
+        let vals: &[ffi::ExportedEnumVal] = self.section(self.header.enum_vals);
+        let start = def.first_val as usize;
+        vals.get(start..start + def.num_vals as usize)
+            .unwrap_or_default()
+    }
+
+    fn methods_of(&self, def: &ffi::ExportedRpcService) -> &'a [ffi::ExportedRpcMethod] {
+        let methods: &[ffi::ExportedRpcMethod] = self.section(self.header.rpc_methods);
+        let start = def.first_method as usize;
+        methods
+            .get(start..start + def.num_methods as usize)
+            .unwrap_or_default()
+    }
+
+    fn occurrences(&self) -> &'a [ffi::ExportedOccurrence] {
+        self.section(self.header.occurrences)
+    }
+
+    fn qualified_name(&self, name: ffi::ExportedString, namespace: ffi::ExportedString) -> String {
+        let name = self.string(name);
+        match self.optional_string(namespace) {
+            Some(namespace) => format!("{namespace}.{name}"),
+            None => name,
+        }
+    }
+
+    fn string(&self, s: ffi::ExportedString) -> String {
+        let start = self.header.strings.offset as usize + s.offset as usize;
+        self.data
+            .get(start..start + s.length as usize)
+            .map(|bytes| String::from_utf8_lossy(bytes).into_owned())
+            .unwrap_or_default()
+    }
+
+    fn optional_string(&self, s: ffi::ExportedString) -> Option<String> {
+        Some(self.string(s)).filter(|s| !s.is_empty())
+    }
+}
+
+/// Extracts the references to types in `path`, leaving out those to types that
+/// were never defined. Included files are left to their own parses.
+fn extract_occurrences(export: &SchemaExport, path: &Path) -> Vec<Occurrence> {
+    let structs = export.structs();
+    let enums = export.enums();
+    // Whether each file is `path`, by the offset of its name. Every occurrence
+    // of a file shares one string.
+    let mut in_path: HashMap<u32, bool> = HashMap::new();
+    export
+        .occurrences()
+        .iter()
+        .filter(|occurrence| {
+            *in_path.entry(occurrence.file.offset).or_insert_with(|| {
+                flatc_file_path(&export.string(occurrence.file)).is_some_and(|file| file == path)
+            })
+        })
+        .filter_map(|occurrence| {
+            let target = if occurrence.target_is_enum {
+                let def = enums.get(occurrence.target as usize)?;
+                export.qualified_name(def.name, def.namespace_)
+            } else {
+                let def = structs
+                    .get(occurrence.target as usize)
+                    .filter(|def| !def.is_predeclared)?;
+                export.qualified_name(def.name, def.namespace_)
+            };
+            Some(Occurrence {
+                range: occurrence.range.into(),
+                target,
+            })
+        })
+        .collect()
+}
+
+/// Helper to view an array owned by the C++ side, which may be null when empty.
+unsafe fn ffi_slice<'a, T>(ptr: *const T, len: usize) -> &'a [T] {
+    if ptr.is_null() || len == 0 {
+        &[]
+    } else {
+        std::slice::from_raw_parts(ptr, len)
     }
-    include_graph
 }
 
 /// Helper to convert a C string to a Rust String.
@@ -564,6 +1216,12 @@ unsafe fn c_str_to_optional_string(ptr: *const std::os::raw::c_char) -> Option<S
         .filter(|s| !s.is_empty())
 }
 
+/// Helper to find a definition's doc comment, if it has one.
+fn doc_comment(doc: ffi::ExportedDoc) -> Option<Documentation> {
+    let range: Range = doc.range.into();
+    (range != Range::default()).then_some(Documentation::Comment(range))
+}
+
 /// Helper to create a symbol and its location.
 fn create_symbol(
     file_path: &Path,
@@ -572,7 +1230,7 @@ fn create_symbol(
     line: u32,
     col: u32,
     kind: SymbolKind,
-    documentation: Option<String>,
+    documentation: Option<Documentation>,
 ) -> Symbol {
     let location = crate::symbol_table::Location {
         path: file_path.to_path_buf(),
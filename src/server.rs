@@ -4,7 +4,7 @@ use crate::document_store::DocumentStore;
 use crate::ext::all_diagnostics::AllDiagnostics;
 use crate::handlers::{
     code_action, completion, goto_definition, hover, lifecycle, references, rename,
-    workspace_symbol,
+    semantic_tokens, workspace_symbol,
 };
 use crate::utils::paths::path_buf_to_uri;
 use log::{error, info, warn};
@@ -25,12 +25,14 @@ use tower_lsp_server::lsp_types::{
     FileSystemWatcher, GlobPattern, GotoDefinitionParams, GotoDefinitionResponse, Hover,
     HoverParams, HoverProviderCapability, InitializeParams, InitializeResult, InitializedParams,
     Location, NumberOrString, OneOf, PrepareRenameResponse, ProgressParams, ProgressParamsValue,
-    ReferenceParams, Registration, RenameOptions, RenameParams, ServerCapabilities, ServerInfo,
-    SymbolInformation, TextDocumentPositionParams, TextDocumentSyncCapability,
-    TextDocumentSyncKind, TextDocumentSyncOptions, WorkDoneProgress, WorkDoneProgressBegin,
-    WorkDoneProgressCreateParams, WorkDoneProgressEnd, WorkDoneProgressOptions, WorkspaceEdit,
-    WorkspaceFoldersServerCapabilities, WorkspaceServerCapabilities, WorkspaceSymbol,
-    WorkspaceSymbolParams,
+    ReferenceParams, Registration, RenameOptions, RenameParams, SemanticTokensDeltaParams,
+    SemanticTokensFullDeltaResult, SemanticTokensFullOptions, SemanticTokensOptions,
+    SemanticTokensParams, SemanticTokensResult, SemanticTokensServerCapabilities,
+    ServerCapabilities, ServerInfo, SymbolInformation, TextDocumentPositionParams,
+    TextDocumentSyncCapability, TextDocumentSyncKind, TextDocumentSyncOptions, WorkDoneProgress,
+    WorkDoneProgressBegin, WorkDoneProgressCreateParams, WorkDoneProgressEnd,
+    WorkDoneProgressOptions, WorkspaceEdit, WorkspaceFoldersServerCapabilities,
+    WorkspaceServerCapabilities, WorkspaceSymbol, WorkspaceSymbolParams,
 };
 use tower_lsp_server::{Client, LanguageServer};
 
@@ -39,6 +41,7 @@ pub struct Backend {
     pub client: Client,
     pub documents: Arc<DocumentStore>,
     pub analyzer: Arc<Analyzer>,
+    pub semantic_tokens: semantic_tokens::SentTokens,
     // Initialize scan.
     ready: AtomicBool,
     notify_ready: Notify,
@@ -53,6 +56,7 @@ impl Backend {
             client,
             documents,
             analyzer: analysis,
+            semantic_tokens: semantic_tokens::SentTokens::default(),
             ready: AtomicBool::new(false),
             notify_ready: Notify::new(),
         }
@@ -118,6 +122,16 @@ impl LanguageServer for Backend {
                     work_done_progress_options: WorkDoneProgressOptions::default(),
                 })),
                 workspace_symbol_provider: Some(OneOf::Left(true)),
+                semantic_tokens_provider: Some(
+                    SemanticTokensServerCapabilities::SemanticTokensOptions(
+                        SemanticTokensOptions {
+                            work_done_progress_options: WorkDoneProgressOptions::default(),
+                            legend: semantic_tokens::legend(),
+                            range: None,
+                            full: Some(SemanticTokensFullOptions::Delta { delta: Some(true) }),
+                        },
+                    ),
+                ),
                 ..ServerCapabilities::default()
             },
         })
@@ -151,8 +165,8 @@ impl LanguageServer for Backend {
             })
             .await;
 
-        let diagnostics = lifecycle::handle_initialized(self).await;
-        self.publish_diagnostics(diagnostics).await;
+        let scan = lifecycle::handle_initialized(self).await;
+        self.publish_diagnostics(scan.diagnostics).await;
         self.mark_ready();
 
         self.client
@@ -187,10 +201,16 @@ impl LanguageServer for Backend {
         }
 
         info!("Server initialized!");
+
+        // Files restored from the index cache may have changed while the server
+        // wasn't running.
+        let diagnostics = lifecycle::handle_index_revalidation(self, scan.restored).await;
+        self.publish_diagnostics(diagnostics).await;
     }
 
     async fn shutdown(&self) -> Result<()> {
         info!("Shutting down server...");
+        lifecycle::handle_shutdown(self).await;
         Ok(())
     }
 
@@ -286,6 +306,32 @@ impl LanguageServer for Backend {
         let result = workspace_symbol::handle_workspace_symbol(&snapshot, &params);
         Ok(Some(OneOf::Right(result)))
     }
+
+    async fn semantic_tokens_full(
+        &self,
+        params: SemanticTokensParams,
+    ) -> Result<Option<SemanticTokensResult>> {
+        self.wait_until_ready().await;
+        let snapshot = self.analyzer.snapshot().await;
+        Ok(semantic_tokens::handle_semantic_tokens_full(
+            &snapshot,
+            &self.semantic_tokens,
+            &params,
+        ))
+    }
+
+    async fn semantic_tokens_full_delta(
+        &self,
+        params: SemanticTokensDeltaParams,
+    ) -> Result<Option<SemanticTokensFullDeltaResult>> {
+        self.wait_until_ready().await;
+        let snapshot = self.analyzer.snapshot().await;
+        Ok(semantic_tokens::handle_semantic_tokens_full_delta(
+            &snapshot,
+            &self.semantic_tokens,
+            &params,
+        ))
+    }
 }
 
 // Convenience.
@@ -1,10 +1,10 @@
 use crate::utils::{parsed_type::ParsedType, paths::path_buf_to_uri};
+use ropey::Rope;
+use serde::{Deserialize, Serialize};
 use std::{collections::HashMap, path::PathBuf};
-use tower_lsp_server::lsp_types::{self, CompletionItemKind, Position, Range};
+use tower_lsp_server::lsp_types::{self, CompletionItemKind, Range};
 
-use crate::ext::range::RangeExt;
-
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct Location {
     pub path: PathBuf,
     pub range: Range,
@@ -19,13 +19,35 @@ impl From<Location> for lsp_types::Location {
     }
 }
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct RootTypeInfo {
     pub location: Location,
     pub type_name: String,
     pub parsed_type: ParsedType,
 }
 
+/// What the cursor is on within a symbol, see [`Symbol::cursor_spans`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SpanPart {
+    /// The symbol's own name.
+    Declaration,
+    /// The type of the field at this index of a table or struct.
+    FieldType(usize),
+    /// A type that a union variant or rpc method refers to.
+    TypeReference,
+}
+
+/// A reference by name to a struct, table, enum or union: the type of a field,
+/// a union variant, an rpc request or response, a `nested_flatbuffer` or a
+/// `root_type`.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct Occurrence {
+    /// The range of the last component of the name.
+    pub range: Range,
+    /// The fully-qualified name of the type referred to.
+    pub target: String,
+}
+
 // A map from a fully qualified name to its symbol definition
 #[derive(Debug)]
 pub struct SymbolTable {
@@ -34,14 +56,14 @@ pub struct SymbolTable {
 }
 
 // Represents a single symbol in the source code
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Symbol {
     pub info: SymbolInfo,
     pub kind: SymbolKind,
 }
 
 // The kind of a symbol
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub enum SymbolKind {
     Table(Table),
     Struct(Struct),
@@ -53,53 +75,61 @@ pub enum SymbolKind {
 }
 
 // Common information for all symbols
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct SymbolInfo {
     pub name: String,
     pub namespace: Vec<String>,
     pub location: Location,
-    pub documentation: Option<String>,
+    pub documentation: Option<Documentation>,
     pub builtin: bool,
 }
 
-#[derive(Debug, Clone, PartialEq, Default)]
+// The documentation of a symbol. Doc comments are kept as where they are in the
+// file that defines the symbol, and only read from it when they are shown.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub enum Documentation {
+    Text(String),   // Documentation that isn't in a schema, e.g. of built-in types
+    Comment(Range), // From the first comment's `//` to the end of the last one
+}
+
+#[derive(Debug, Clone, PartialEq, Default, Serialize, Deserialize)]
 pub struct Table {
     pub fields: Vec<Symbol>,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Struct {
     pub fields: Vec<Symbol>,
     pub size: u64,
     pub alignment: u64,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct EnumVariant {
     pub name: String,
     pub value: i64,
-    pub documentation: Option<String>,
+    pub documentation: Option<Documentation>,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Enum {
     pub variants: Vec<EnumVariant>,
     pub underlying_type: String,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct UnionVariant {
     pub name: String,
     pub location: Location,
     pub parsed_type: ParsedType,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Union {
     pub variants: Vec<UnionVariant>,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Field {
     pub type_name: String, // The name of the field's underlying type, e.g., "string" or "Vec3" (excludes vector/array tokens)
     pub type_display_name: String, // The fully-qualified name of the type, including vector and array tokens
@@ -109,22 +139,22 @@ pub struct Field {
     pub id: Option<i32>,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct RpcService {
     pub methods: Vec<RpcMethod>,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct RpcMethod {
     pub name: String,
     pub range: Range,
-    pub documentation: Option<String>,
+    pub documentation: Option<Documentation>,
 
     pub request_type: RpcMethodType,
     pub response_type: RpcMethodType,
 }
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct RpcMethodType {
     pub name: String, // fully-qualified name
     pub parsed: ParsedType,
@@ -145,60 +175,39 @@ impl Symbol {
         }
     }
 
+    /// The ranges where a cursor is on this symbol, in the file that defines
+    /// it: its name, and the types its fields, variants and methods refer to.
     #[must_use]
-    pub fn find_symbol<'a>(&'a self, path: &PathBuf, pos: Position) -> Option<&'a Symbol> {
-        if self.info.location.path != *path {
-            return None;
-        }
-
-        if self.info.location.range.contains(pos) {
-            return Some(self);
-        }
-
+    pub fn cursor_spans(&self) -> Vec<(Range, SpanPart)> {
+        let mut spans = vec![(self.info.location.range, SpanPart::Declaration)];
         match &self.kind {
-            SymbolKind::Table(t) => {
-                for field in &t.fields {
-                    if let SymbolKind::Field(f) = &field.kind {
-                        if f.type_range.contains(pos) {
-                            return Some(field);
-                        }
-                    }
-                }
-            }
-            SymbolKind::Struct(s) => {
-                for field in &s.fields {
+            SymbolKind::Table(Table { fields }) | SymbolKind::Struct(Struct { fields, .. }) => {
+                for (i, field) in fields.iter().enumerate() {
                     if let SymbolKind::Field(f) = &field.kind {
-                        if f.type_range.contains(pos) {
-                            return Some(field);
-                        }
+                        spans.push((f.type_range, SpanPart::FieldType(i)));
                     }
                 }
             }
             SymbolKind::Union(u) => {
                 for variant in &u.variants {
-                    if variant.location.range.contains(pos) {
-                        return Some(self);
-                    }
+                    spans.push((variant.location.range, SpanPart::TypeReference));
                 }
             }
             SymbolKind::RpcService(r) => {
                 for method in &r.methods {
-                    if method.request_type.range.contains(pos) {
-                        return Some(self);
-                    }
-                    if method.response_type.range.contains(pos) {
-                        return Some(self);
-                    }
+                    spans.push((method.request_type.range, SpanPart::TypeReference));
+                    spans.push((method.response_type.range, SpanPart::TypeReference));
                 }
             }
             _ => {}
         }
-
-        None
+        spans
     }
 
+    /// The hover text of the symbol. `source` is the contents of the file that
+    /// defines it, to read doc comments from.
     #[must_use]
-    pub fn hover_markdown(&self) -> String {
+    pub fn hover_markdown(&self, source: Option<&Rope>) -> String {
         let mut code_content = if self.info.namespace.is_empty() {
             String::new()
         } else {
@@ -214,7 +223,7 @@ impl Symbol {
                 "enum {} : {} {{{}}}",
                 self.info.name,
                 e.underlying_type,
-                e.variants_markdown()
+                e.variants_markdown(source)
             ),
             SymbolKind::Union(u) => {
                 format!("union {} {{{}}}", self.info.name, u.variants_markdown())
@@ -235,11 +244,14 @@ impl Symbol {
 
         let mut markdown = format!("```flatbuffers\n{code_content}\n```");
 
-        if let Some(doc) = &self.info.documentation {
-            if !doc.is_empty() {
-                markdown.push_str("\n\n---\n\n");
-                markdown.push_str(doc);
-            }
+        if let Some(doc) = self
+            .info
+            .documentation
+            .as_ref()
+            .and_then(|doc| doc.text(source))
+        {
+            markdown.push_str("\n\n---\n\n");
+            markdown.push_str(&doc);
         }
 
         if let SymbolKind::Struct(s) = &self.kind {
@@ -328,9 +340,53 @@ impl Struct {
     }
 }
 
+impl Documentation {
+    /// The text of the documentation, reading doc comments out of `source`, the
+    /// contents of the file that defines the symbol. `None` if it is empty, or
+    /// if `source` no longer has a comment where the parser found it.
+    #[must_use]
+    pub fn text(&self, source: Option<&Rope>) -> Option<String> {
+        match self {
+            Documentation::Text(text) => Some(text.clone()).filter(|text| !text.is_empty()),
+            Documentation::Comment(range) => source.and_then(|source| comment_text(source, *range)),
+        }
+    }
+}
+
+/// The lines of the comments in `range` of `source` joined by newlines, each
+/// without its leading `//` or `///`, as the parser collects them.
+fn comment_text(source: &Rope, range: Range) -> Option<String> {
+    // Columns from the parser are byte offsets.
+    let start =
+        source.try_line_to_byte(range.start.line as usize).ok()? + range.start.character as usize;
+    let end = source.try_line_to_byte(range.end.line as usize).ok()? + range.end.character as usize;
+    let text = source.get_byte_slice(start..end)?.to_string();
+
+    let mut lines = Vec::new();
+    let mut rest = text.as_str();
+    loop {
+        rest = rest.trim_start();
+        if let Some(comment) = rest.strip_prefix("//") {
+            let end = comment.find(['\n', '\r']).unwrap_or(comment.len());
+            let line = &comment[..end];
+            lines.push(line.strip_prefix('/').unwrap_or(line));
+            rest = &comment[end..];
+        } else if let Some(block) = rest.strip_prefix("/*") {
+            rest = block.find("*/").map_or("", |end| &block[end + 2..]);
+        } else {
+            break;
+        }
+    }
+    // Anything else means the file has changed since it was parsed.
+    if !rest.is_empty() {
+        return None;
+    }
+    Some(lines.join("\n")).filter(|text| !text.is_empty())
+}
+
 impl Enum {
     #[must_use]
-    pub fn variants_markdown(&self) -> String {
+    pub fn variants_markdown(&self, source: Option<&Rope>) -> String {
         if self.variants.is_empty() {
             return String::new();
         }
@@ -343,7 +399,7 @@ impl Enum {
                     let doc = v
                         .documentation
                         .as_ref()
-                        .filter(|d| !d.is_empty())
+                        .and_then(|d| d.text(source))
                         .map(|d| {
                             d.split('\n')
                                 .map(|l| format!("  /// {}", l.trim()))
@@ -454,3 +510,35 @@ impl SymbolInfo {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tower_lsp_server::lsp_types::Position;
+
+    fn comment(start: (u32, u32), end: (u32, u32)) -> Documentation {
+        Documentation::Comment(Range::new(
+            Position::new(start.0, start.1),
+            Position::new(end.0, end.1),
+        ))
+    }
+
+    #[test]
+    fn test_doc_comment_text() {
+        let source = Rope::from_str(
+            "  /// First line.\r\n  ///\n  /* not docs */\n  // Last line.\ntable T {}\n",
+        );
+        assert_eq!(
+            comment((0, 2), (3, 15)).text(Some(&source)).as_deref(),
+            Some(" First line.\n\n Last line.")
+        );
+        assert_eq!(comment((0, 2), (0, 17)).text(None), None);
+    }
+
+    #[test]
+    fn test_doc_comment_text_after_edit() {
+        let source = Rope::from_str("table T {}\n/// Moved.\n");
+        assert_eq!(comment((0, 0), (0, 10)).text(Some(&source)), None);
+        assert_eq!(comment((5, 0), (5, 10)).text(Some(&source)), None);
+    }
+}
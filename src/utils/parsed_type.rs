@@ -1,12 +1,13 @@
+use serde::{Deserialize, Serialize};
 use tower_lsp_server::lsp_types::{Position, Range};
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct TypePart {
     pub text: String,
     pub range: Range,
 }
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct ParsedType {
     pub is_vector: bool,
     pub namespace: Vec<TypePart>,
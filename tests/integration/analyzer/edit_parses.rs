@@ -0,0 +1,55 @@
+use std::fmt::Write;
+use std::fs;
+use std::sync::Arc;
+use std::time::Duration;
+
+use flatbuffers_language_server::analysis::Analyzer;
+use flatbuffers_language_server::document_store::DocumentStore;
+use ropey::Rope;
+use tempfile::tempdir;
+
+#[tokio::test]
+async fn test_superseded_edit_parse_does_not_merge() {
+    let dir = tempdir().unwrap();
+    let path = fs::canonicalize(dir.path()).unwrap().join("schema.fbs");
+
+    // Long enough that the newer edit lands at different points of its parse.
+    let mut old_text = String::new();
+    for i in 0..200 {
+        writeln!(old_text, "table Old{i} {{ a: int; b: Missing{i}; }}").unwrap();
+    }
+    let new_text = "table New { a: int; }\n";
+    fs::write(&path, &old_text).unwrap();
+
+    for delay_ms in [0, 1, 2, 5, 10, 20] {
+        let documents = Arc::new(DocumentStore::new());
+        let analyzer = Analyzer::new(documents.clone());
+        documents
+            .document_map
+            .insert(path.clone(), Rope::from_str(&old_text));
+
+        let (_, newer) = tokio::join!(analyzer.parse_edit(path.clone()), async {
+            tokio::time::sleep(Duration::from_millis(delay_ms)).await;
+            documents
+                .document_map
+                .insert(path.clone(), Rope::from_str(new_text));
+            analyzer.parse_edit(path.clone()).await
+        });
+
+        let index = analyzer.snapshot().await.index;
+        assert_eq!(
+            index.symbols.per_file.get(&path).map(|keys| keys.to_vec()),
+            Some(vec!["New".to_string()]),
+            "after {delay_ms}ms"
+        );
+        assert!(index
+            .symbols
+            .global
+            .keys()
+            .all(|key| !key.starts_with("Old")));
+        assert!(index.diagnostics.all().get(&path).is_none_or(Vec::is_empty));
+        assert!(newer
+            .iter()
+            .all(|(published, diagnostics)| published != &path || diagnostics.is_empty()));
+    }
+}
@@ -0,0 +1,83 @@
+use std::collections::HashMap;
+use std::fs;
+use std::path::PathBuf;
+use std::sync::atomic::AtomicBool;
+
+use flatbuffers_language_server::parser::{FlatcFFIParser, ParseResult, Parser};
+use flatbuffers_language_server::symbol_table::{Occurrence, Symbol};
+use tempfile::tempdir;
+use tower_lsp_server::lsp_types::Diagnostic;
+
+const SCHEMA: &str = r"namespace Game;
+
+enum Color : byte { Red, Green }
+
+/// A monster.
+table Monster {
+  name: string;
+  hp: short = 100;
+  color: Color = Red;
+  weapons: [Weapon];
+}
+
+table Weapon {
+  WEAPON_FIELDS
+}
+
+root_type Monster;
+";
+
+type Summary = (
+    HashMap<String, Symbol>,
+    HashMap<PathBuf, Vec<Diagnostic>>,
+    Vec<Occurrence>,
+    Vec<u32>,
+);
+
+fn summary(result: ParseResult) -> Summary {
+    (
+        result.symbol_table.unwrap().into_inner(),
+        result.diagnostics,
+        result.occurrences,
+        result.semantic_tokens,
+    )
+}
+
+#[test]
+fn test_incremental_parse_matches_full_parse() {
+    let dir = tempdir().unwrap();
+    let path = fs::canonicalize(dir.path()).unwrap().join("monster.fbs");
+    let parser = FlatcFFIParser::default().incremental();
+
+    let weapon_fields = [
+        "damage: int;",
+        "damage: long;",
+        "damage: long; range: float;",
+        // An undefined type, then a syntax error, then fixed again.
+        "damage: lon; range: float;",
+        "damage: ; range: float;",
+        "damage: long; range: float;",
+        "damage: long; owner: Monster;",
+        "damage: long; owner: Color = Green;",
+        "damage: long (deprecated); owner: Monster;",
+        // A new line, and a closing brace that ends the table early.
+        "damage: long;\n  owner: Monster;",
+        "damage: long; } table Extra { x: int;",
+        "damage: long;\n  owner: Monster;",
+    ];
+    let mut contents: Vec<String> = weapon_fields
+        .iter()
+        .map(|fields| SCHEMA.replace("WEAPON_FIELDS", fields))
+        .collect();
+    // An edit of a table that refers to one declared after it.
+    contents.push(contents[contents.len() - 1].replace("hp: short = 100", "hp: short = 150"));
+
+    fs::write(&path, &contents[0]).unwrap();
+    for content in &contents {
+        let incremental = parser
+            .parse_with_overlay(&path, content, &[], &[], &AtomicBool::new(false))
+            .unwrap();
+        let full = FlatcFFIParser::default().parse(&path, content, &[]);
+        assert_eq!(summary(incremental), summary(full), "{content}");
+    }
+}
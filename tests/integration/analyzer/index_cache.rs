@@ -0,0 +1,80 @@
+use std::fs;
+use std::sync::Arc;
+use std::time::{Duration, SystemTime};
+
+use flatbuffers_language_server::analysis::Analyzer;
+use flatbuffers_language_server::document_store::DocumentStore;
+use flatbuffers_language_server::workspace_layout::WorkspaceLayout;
+use tempfile::tempdir;
+
+#[tokio::test]
+async fn test_analyzer_index_cache() {
+    // 1. Setup the files on disk.
+    let dir = tempdir().unwrap();
+    let cache_dir = tempdir().unwrap();
+    let cache_path = cache_dir.path().join("index.json");
+
+    let included_fbs_path = dir.path().join("included.fbs");
+    fs::write(&included_fbs_path, "attribute my_attr;\ntable Included {}").unwrap();
+
+    let main_fbs_path = dir.path().join("main.fbs");
+    fs::write(
+        &main_fbs_path,
+        "include \"included.fbs\";\ntable Main { i: Included; u: Undefined; }\nroot_type Main;",
+    )
+    .unwrap();
+
+    let mut layout = WorkspaceLayout::new();
+    layout.add_root(fs::canonicalize(dir.path()).unwrap());
+    let files = layout.discover_files();
+    let canonical_included_path = fs::canonicalize(&included_fbs_path).unwrap();
+    let canonical_main_path = fs::canonicalize(&main_fbs_path).unwrap();
+
+    // 2. Parse and cache the workspace.
+    let parsed = Analyzer::new(Arc::new(DocumentStore::new()));
+    parsed.parse(files.clone()).await;
+    parsed.save_index(&cache_path).await;
+
+    // 3. Restore it into a new Analyzer, without parsing.
+    let restored = Analyzer::new(Arc::new(DocumentStore::new()));
+    let restore = restored.restore_index(&cache_path, &files).await;
+    assert_eq!(restore.restored.len(), 2);
+    assert!(restore.missing.is_empty());
+    {
+        let parsed = parsed.snapshot().await;
+        let restored = restored.snapshot().await;
+        assert_eq!(restored.index.symbols.global, parsed.index.symbols.global);
+        assert_eq!(
+            restored.index.symbols.user_defined_attributes,
+            parsed.index.symbols.user_defined_attributes
+        );
+        assert_eq!(restored.index.root_types, parsed.index.root_types);
+        assert_eq!(restored.index.occurrences, parsed.index.occurrences);
+        assert_eq!(restored.index.dependencies, parsed.index.dependencies);
+        assert_eq!(restored.index.semantic_tokens, parsed.index.semantic_tokens);
+        assert_eq!(
+            restored.index.diagnostics.all(),
+            parsed.index.diagnostics.all()
+        );
+        assert!(!restored.index.diagnostics.all()[&canonical_main_path].is_empty());
+    }
+
+    // 4. Revalidating unchanged files doesn't parse them again, and only
+    // publishes the diagnostics that were restored.
+    let diagnostics = restored.parse(restore.restored).await;
+    assert_eq!(diagnostics.len(), 2);
+    assert!(restored.parse(files.clone()).await.is_empty());
+
+    // 5. A file modified since it was cached isn't restored.
+    fs::write(&included_fbs_path, "table Included { f: int; }").unwrap();
+    fs::File::options()
+        .write(true)
+        .open(&included_fbs_path)
+        .unwrap()
+        .set_modified(SystemTime::now() + Duration::from_secs(60))
+        .unwrap();
+    let stale = Analyzer::new(Arc::new(DocumentStore::new()));
+    let restore = stale.restore_index(&cache_path, &files).await;
+    assert_eq!(restore.restored, vec![canonical_main_path]);
+    assert_eq!(restore.missing, vec![canonical_included_path]);
+}
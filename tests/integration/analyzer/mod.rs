@@ -1,4 +1,7 @@
 pub mod diagnostic_store;
+pub mod edit_parses;
+pub mod incremental_parse;
+pub mod index_cache;
 pub mod root_type_store;
 pub mod symbol_index;
 pub mod workspace_manipulations;
@@ -101,3 +101,67 @@ async fn assert_matches_fresh_analyzer(root_dir: Option<PathBuf>, mutated_analyz
     assert_eq!(mutated_index.symbols.global, fresh_index.symbols.global);
     assert_eq!(mutated_index.symbols.per_file, fresh_index.symbols.per_file);
 }
+
+#[tokio::test]
+async fn test_outside_change_to_closed_include_is_reparsed() {
+    let dir = tempdir().unwrap();
+    let root = fs::canonicalize(dir.path()).unwrap();
+    let included_path = root.join("included.fbs");
+    let includer_path = root.join("includer.fbs");
+    fs::write(&included_path, "table Old {}").unwrap();
+    fs::write(
+        &includer_path,
+        "include \"included.fbs\";\ntable User { field: Old; }",
+    )
+    .unwrap();
+
+    let analyzer = Analyzer::new(Arc::new(DocumentStore::new()));
+    analyzer
+        .handle_workspace_folder_changes(vec![path_buf_to_uri(&root).unwrap()], vec![])
+        .await;
+    let index = analyzer.snapshot().await.index;
+    assert!(index.diagnostics.all()[&includer_path].is_empty());
+
+    // As a git checkout would, without the client having the file open.
+    fs::write(&included_path, "table New {}").unwrap();
+    analyzer
+        .handle_file_changes(vec![FileEvent {
+            uri: path_buf_to_uri(&included_path).unwrap(),
+            typ: FileChangeType::CHANGED,
+        }])
+        .await;
+
+    let index = analyzer.snapshot().await.index;
+    assert!(index.symbols.global.contains_key("New"));
+    assert!(!index.symbols.global.contains_key("Old"));
+    assert!(index.diagnostics.all()[&includer_path]
+        .iter()
+        .any(|diagnostic| diagnostic.message.contains("Old")));
+}
+
+#[tokio::test]
+async fn test_include_resolved_by_new_root_is_reparsed() {
+    let dir = tempdir().unwrap();
+    let root = fs::canonicalize(dir.path()).unwrap();
+    let a_root = root.join("a-root");
+    let b_root = root.join("b-root");
+    fs::create_dir_all(&a_root).unwrap();
+    fs::create_dir_all(&b_root).unwrap();
+    let includer_path = a_root.join("a.fbs");
+    fs::write(&includer_path, "include \"b.fbs\";\ntable A { field: B; }").unwrap();
+    fs::write(b_root.join("b.fbs"), "table B {}").unwrap();
+
+    let analyzer = Analyzer::new(Arc::new(DocumentStore::new()));
+    analyzer
+        .handle_workspace_folder_changes(vec![path_buf_to_uri(&a_root).unwrap()], vec![])
+        .await;
+    let index = analyzer.snapshot().await.index;
+    assert!(!index.diagnostics.all()[&includer_path].is_empty());
+
+    analyzer
+        .handle_workspace_folder_changes(vec![path_buf_to_uri(&b_root).unwrap()], vec![])
+        .await;
+    let index = analyzer.snapshot().await.index;
+    assert!(index.diagnostics.all()[&includer_path].is_empty());
+    assert!(index.symbols.global.contains_key("A"));
+}
@@ -118,7 +118,6 @@ table Player {
 }
 
 #[tokio::test]
-#[ignore = "Error-tolerant parsing is not implemented."]
 async fn hover_on_predeclared_table() {
     let fixture = r"
 // Should be able to hover on this pre-declared table
@@ -142,3 +141,52 @@ table Monster {
         "Expected hover information for pre-declared table"
     );
 }
+
+#[tokio::test]
+async fn every_broken_declaration_is_reported() {
+    let fixture = r"
+table First { a: int }
+table AfterFirst { x: int; }
+table Second { b: : int; }
+table AfterSecond { y: int; }
+enum Third : byte { A = , B }
+table La$0st { z: int; }
+";
+    let (content, position) = parse_fixture(fixture);
+    let mut harness = TestHarness::new();
+    harness
+        .initialize_and_open(&[("schema.fbs", content.as_str())])
+        .await;
+
+    let params = harness
+        .notification::<notification::PublishDiagnostics>()
+        .await;
+    let schema_uri = harness.file_uri("schema.fbs");
+    assert_eq!(params.uri, schema_uri);
+    let mut lines: Vec<u32> = params
+        .diagnostics
+        .iter()
+        .map(|d| d.range.start.line)
+        .collect();
+    lines.sort_unstable();
+    assert_eq!(
+        lines,
+        vec![1, 3, 5],
+        "Expected one diagnostic per broken declaration: {:?}",
+        params.diagnostics
+    );
+
+    let response = harness
+        .call::<request::HoverRequest>(HoverParams {
+            text_document_position_params: TextDocumentPositionParams {
+                text_document: TextDocumentIdentifier { uri: schema_uri },
+                position,
+            },
+            work_done_progress_params: WorkDoneProgressParams::default(),
+        })
+        .await;
+    assert!(
+        serde_json::to_string(&response).unwrap().contains("Last"),
+        "Expected hover information for the table after the broken ones"
+    );
+}
@@ -1,6 +1,9 @@
 use crate::harness::TestHarness;
 use flatbuffers_language_server::ext::all_diagnostics::AllDiagnostics;
-use tower_lsp_server::lsp_types::notification;
+use tower_lsp_server::lsp_types::{
+    notification::{self, DidChangeWatchedFiles},
+    DidChangeWatchedFilesParams, FileChangeType, FileEvent, VersionedTextDocumentIdentifier,
+};
 
 #[tokio::test]
 async fn include_paths_are_discovered_correctly() {
@@ -50,3 +53,64 @@ root_type ApiRequest;
     }
     assert_eq!(harness.call::<AllDiagnostics>(()).await.len(), 2);
 }
+
+#[tokio::test]
+async fn created_file_takes_over_include() {
+    let mut harness = TestHarness::new();
+
+    let api_content = r#"
+include "schemas/common.fbs";
+table ApiRequest { data: CommonData; }
+"#;
+    harness
+        .initialize_and_open(&[
+            ("schemas/common.fbs", "struct CommonData { id: ulong; }"),
+            ("services/api.fbs", api_content),
+        ])
+        .await;
+    for _ in 0..2 {
+        harness
+            .notification::<notification::PublishDiagnostics>()
+            .await;
+    }
+
+    // Includes are looked for next to the includer before the include paths,
+    // so the include no longer resolves to the file it did.
+    let shadow_uri = harness.file_uri("services/schemas/common.fbs");
+    let shadow_path = harness.root_path.join("services/schemas/common.fbs");
+    std::fs::create_dir_all(shadow_path.parent().unwrap()).unwrap();
+    std::fs::write(&shadow_path, "struct OtherData { id: ulong; }").unwrap();
+    harness
+        .send_notification::<DidChangeWatchedFiles>(DidChangeWatchedFilesParams {
+            changes: vec![FileEvent {
+                uri: shadow_uri.clone(),
+                typ: FileChangeType::CREATED,
+            }],
+        })
+        .await;
+    loop {
+        let params = harness
+            .notification::<notification::PublishDiagnostics>()
+            .await;
+        if params.uri == shadow_uri {
+            break;
+        }
+    }
+
+    let api_uri = harness.file_uri("services/api.fbs");
+    harness
+        .change_file_sync(
+            VersionedTextDocumentIdentifier {
+                uri: api_uri.clone(),
+                version: 2,
+            },
+            api_content,
+        )
+        .await;
+    let diagnostic = harness.get_first_diagnostic_for_file(&api_uri).await;
+    assert!(
+        diagnostic.message.contains("CommonData"),
+        "{}",
+        diagnostic.message
+    );
+}
@@ -11,9 +11,11 @@ mod harness;
 mod helpers;
 mod hover;
 mod include_paths;
+mod parse_stats;
 mod references;
 mod rename;
 mod scenarios;
+mod semantic_tokens;
 mod test_logger;
 mod workspace;
 mod workspace_layout;
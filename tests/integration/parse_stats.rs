@@ -0,0 +1,33 @@
+use std::ffi::CString;
+use std::fmt::Write;
+
+use flatbuffers_language_server::ffi;
+
+#[test]
+fn parse_reports_peak_and_retained_memory() {
+    let mut schema = String::from("namespace Stats;\n");
+    for i in 0..50 {
+        writeln!(
+            schema,
+            "/// Table {i}.\ntable T{i} {{ a: int; b: string; c: [T{i}]; }}"
+        )
+        .unwrap();
+    }
+    let content = CString::new(schema).unwrap();
+    let filename = CString::new("stats.fbs").unwrap();
+    let mut include_paths = [std::ptr::null()];
+
+    let stats = unsafe {
+        let parser = ffi::parse_schema(
+            content.as_ptr(),
+            filename.as_ptr(),
+            include_paths.as_mut_ptr(),
+        );
+        let stats = ffi::get_parse_stats(parser);
+        ffi::delete_parser(parser);
+        stats
+    };
+
+    assert!(stats.retained_bytes > 0);
+    assert!(stats.peak_bytes >= stats.retained_bytes);
+}
@@ -222,6 +222,76 @@ table I {} // Change so that I is now defined.
     assert_eq!(diagnostics.len(), 0);
 }
 
+#[tokio::test]
+async fn saving_shared_include_updates_every_includer() {
+    let first = r#"
+include "common.fbs";
+
+table First { s: Shared; }
+"#;
+
+    let second = r#"
+include "common.fbs";
+
+table Second { s: Shared; a: Added; } // Added is not defined yet.
+"#;
+
+    let common_before = r"
+table Shared {}
+";
+
+    let common_after = r"
+table Shared {}
+table Added {}
+";
+
+    let mut harness = TestHarness::new();
+    harness
+        .initialize_and_open_some(
+            &[
+                ("first.fbs", first),
+                ("second.fbs", second),
+                ("common.fbs", common_before),
+            ],
+            &[],
+        )
+        .await;
+
+    // Whichever includer is parsed second reuses the cached common.fbs.
+    let second_uri = harness.file_uri("second.fbs");
+    let diagnostics = loop {
+        let params = harness
+            .notification::<notification::PublishDiagnostics>()
+            .await;
+        if params.uri == second_uri {
+            break params.diagnostics;
+        }
+        assert_eq!(params.diagnostics.len(), 0);
+    };
+    assert_eq!(diagnostics.len(), 1);
+    assert_eq!(
+        diagnostics[0].code,
+        Some(DiagnosticCode::UndefinedType.into())
+    );
+
+    let common_uri = harness.file_uri("common.fbs");
+    harness
+        .save_file(TextDocumentIdentifier::new(common_uri), common_after)
+        .await;
+
+    // The cached copy of common.fbs must not be used once it has changed.
+    let diagnostics = loop {
+        let params = harness
+            .notification::<notification::PublishDiagnostics>()
+            .await;
+        if params.uri == second_uri {
+            break params.diagnostics;
+        }
+        assert_eq!(params.diagnostics.len(), 0);
+    };
+    assert_eq!(diagnostics.len(), 0);
+}
+
 #[tokio::test]
 async fn saving_included_file_with_error() {
     let including = r#"
@@ -276,7 +346,7 @@ table WithError {
     }
 
     {
-        // Change to introduce an error.
+        // Change to introduce an error, which also rechecks the includer.
         harness
             .change_file_sync(
                 VersionedTextDocumentIdentifier::new(included_uri.clone(), 1),
@@ -284,48 +354,50 @@ table WithError {
             )
             .await;
 
-        let diagnostics = loop {
+        let mut included_diagnostics = None;
+        let mut including_diagnostics = None;
+        while included_diagnostics.is_none() || including_diagnostics.is_none() {
             let params = harness
                 .notification::<notification::PublishDiagnostics>()
                 .await;
             if params.uri == included_uri {
-                break params.diagnostics;
+                included_diagnostics = Some(params.diagnostics);
+            } else if params.uri == including_uri {
+                including_diagnostics = Some(params.diagnostics);
+            } else {
+                assert_eq!(params.diagnostics.len(), 0);
             }
-            assert_eq!(params.diagnostics.len(), 0);
-        };
+        }
+
+        let diagnostics = included_diagnostics.unwrap();
         assert_eq!(diagnostics.len(), 1);
         assert_eq!(diagnostics[0].range.start, Position::new(12, 10));
         assert_eq!(
             diagnostics[0].code,
             Some(DiagnosticCode::ExpectingToken.into())
         );
+
+        // Parsing error in WithError makes the include appear unused.
+        // TODO: This could be improved with a syntax-tolerant parser.
+        let diagnostics = including_diagnostics.unwrap();
+        assert_eq!(diagnostics.len(), 1);
+        assert_eq!(
+            diagnostics[0].code,
+            Some(DiagnosticCode::UnusedInclude.into())
+        );
     }
 
     {
-        // Save with the error (and trigger reparsing of includer).
+        // Saving the same contents changes nothing, so nothing is reparsed
+        // or published.
         harness
             .save_file_sync(
                 TextDocumentIdentifier::new(included_uri.clone()),
                 &included_error,
             )
             .await;
-
-        let diagnostics = loop {
-            let params = harness
-                .notification::<notification::PublishDiagnostics>()
-                .await;
-            if params.uri == including_uri {
-                break params.diagnostics;
-            }
-            assert_eq!(params.diagnostics.len(), 0);
-        };
-        // Parsing error in WithError makes the include appear unused.
-        // TODO: This could be improved with a syntax-tolerant parser.
-        assert_eq!(diagnostics.len(), 1);
-        assert_eq!(
-            diagnostics[0].code,
-            Some(DiagnosticCode::UnusedInclude.into())
-        );
+        let notifs = harness.pending_notifications::<notification::PublishDiagnostics>();
+        assert!(notifs.is_empty());
     }
 }
 
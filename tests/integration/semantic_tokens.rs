@@ -0,0 +1,81 @@
+use crate::harness::TestHarness;
+use tower_lsp_server::lsp_types::{
+    notification, request, PartialResultParams, SemanticToken, SemanticTokensDeltaParams,
+    SemanticTokensFullDeltaResult, SemanticTokensParams, SemanticTokensResult,
+    TextDocumentIdentifier, VersionedTextDocumentIdentifier, WorkDoneProgressParams,
+};
+
+fn token(
+    delta_line: u32,
+    delta_start: u32,
+    length: u32,
+    token_type: u32,
+    modifiers: u32,
+) -> SemanticToken {
+    SemanticToken {
+        delta_line,
+        delta_start,
+        length,
+        token_type,
+        token_modifiers_bitset: modifiers,
+    }
+}
+
+#[tokio::test]
+async fn semantic_tokens_full_then_delta() {
+    let mut harness = TestHarness::new();
+    harness
+        .initialize_and_open(&[("schema.fbs", "table Monster {\n  hp: short;\n}\n")])
+        .await;
+    harness
+        .notification::<notification::PublishDiagnostics>()
+        .await;
+    let uri = harness.file_uri("schema.fbs");
+
+    let Some(SemanticTokensResult::Tokens(full)) = harness
+        .call::<request::SemanticTokensFullRequest>(SemanticTokensParams {
+            work_done_progress_params: WorkDoneProgressParams::default(),
+            partial_result_params: PartialResultParams::default(),
+            text_document: TextDocumentIdentifier { uri: uri.clone() },
+        })
+        .await
+    else {
+        panic!("expected semantic tokens");
+    };
+    // keyword, table declaration, field declaration, builtin type.
+    assert_eq!(
+        full.data,
+        vec![
+            token(0, 0, 5, 0, 0),
+            token(0, 6, 7, 4, 1),
+            token(1, 2, 2, 8, 1),
+            token(0, 4, 5, 2, 4),
+        ]
+    );
+
+    harness
+        .change_file_sync(
+            VersionedTextDocumentIdentifier {
+                uri: uri.clone(),
+                version: 2,
+            },
+            "table Monster {\n  hp: int;\n}\n",
+        )
+        .await;
+
+    let Some(SemanticTokensFullDeltaResult::TokensDelta(delta)) = harness
+        .call::<request::SemanticTokensFullDeltaRequest>(SemanticTokensDeltaParams {
+            work_done_progress_params: WorkDoneProgressParams::default(),
+            partial_result_params: PartialResultParams::default(),
+            text_document: TextDocumentIdentifier { uri },
+            previous_result_id: full.result_id.unwrap(),
+        })
+        .await
+    else {
+        panic!("expected a semantic tokens delta");
+    };
+    assert_eq!(delta.edits.len(), 1);
+    assert_eq!(delta.edits[0].start, 15);
+    assert_eq!(delta.edits[0].delete_count, 5);
+    assert_eq!(delta.edits[0].data, Some(vec![token(0, 4, 3, 2, 4)]));
+}